@@ -0,0 +1,28 @@
+#ifndef LB_SIM_HOST_H
+#define LB_SIM_HOST_H
+
+/* Host shims for building load_balancer.c into the offline simulator
+ * (examples/lb_simulator.c). The simulation is single threaded, so the
+ * RTOS primitives reduce to plain memory operations and a virtual clock.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+typedef volatile bool atomic_bool;
+
+#define atomic_load_explicit_bool(obj, order) (*(obj))
+#define atomic_store_explicit_bool(obj, value, order) ((void)(*(obj) = (value)))
+#define atomic_compare_exchange_strong_explicit_bool(obj, expected, desired, succ, fail) \
+    (*(obj) == *(expected) ? (*(obj) = (desired), true) : (*(expected) = *(obj), false))
+
+/* Virtual time, advanced by the simulator */
+uint64_t get_system_time_ms(void);
+
+void* mutex_create(void);
+void mutex_lock(void* mutex);
+void mutex_unlock(void* mutex);
+void mutex_destroy(void* mutex);
+
+#endif /* LB_SIM_HOST_H */
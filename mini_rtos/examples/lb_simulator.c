@@ -0,0 +1,555 @@
+/* Trace-driven load balancer simulator
+ *
+ * Replays a task trace against the real load_balancer.c on N simulated
+ * cores with a 1 ms clock, once per lb_policy_t, and reports makespan,
+ * migrations, response-time percentiles and load imbalance over time.
+ * Thresholds are compiled into load_balancer.c, so tune them by
+ * rebuilding with different -D values and re-running the same trace.
+ *
+ * Build (host):
+ *   gcc -O2 -std=gnu11 -Iinclude -include examples/lb_sim_host.h \
+ *       [-DTHERMAL_THRESHOLD=80] [-DMEMORY_PRESSURE_THRESHOLD=85] \
+ *       examples/lb_simulator.c src/load_balancer.c -o lb_sim
+ *
+ * Usage:
+ *   lb_sim [-c cores] [-g smt,cores_per_llc,llcs_per_pkg] [-t trace]
+ *          [-n tasks] [-s seed] [-i interval_ms] [-p policy] [-v]
+ *
+ * Trace format, one event per line, times in ms, sorted by time:
+ *   A <time> <runtime> <cpu%> <priority> [affinity-hex]   task arrival
+ *   T <time> <core> <temperature>                         thermal reading
+ *   M <time> <core> <pressure>                            memory pressure
+ * Lines starting with '#' are ignored. Without -t a bursty synthetic
+ * trace is generated from the seed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "load_balancer.h"
+#include "async_ops.h"
+
+#define SIM_MAX_CORES LB_MAX_CORES
+#define SIM_MAX_EVENTS 65536
+#define SIM_WINDOW_MS 100           /* Imbalance time-series resolution */
+#define SIM_MAX_WINDOWS 4096
+#define SIM_AMBIENT_TEMP 45
+#define SIM_NO_TASK (-1)
+
+/* Mirrors load_balancer.c defaults so the banner shows what was built */
+#ifndef THERMAL_THRESHOLD
+#define THERMAL_THRESHOLD 85
+#endif
+#ifndef MEMORY_PRESSURE_THRESHOLD
+#define MEMORY_PRESSURE_THRESHOLD 90
+#endif
+#ifndef LOAD_IMBALANCE_THRESHOLD
+#define LOAD_IMBALANCE_THRESHOLD 20
+#endif
+
+/* Trace event */
+typedef struct {
+    char kind;                      /* 'A', 'T' or 'M' */
+    uint64_t time;
+    uint32_t arg[4];                /* A: runtime cpu prio affinity; T/M: core value */
+} sim_event_t;
+
+/* Simulated task */
+typedef struct {
+    uint64_t arrival;
+    uint32_t remaining;
+    uint32_t cpu;
+    int32_t next;
+} sim_task_t;
+
+/* Simulated core: FIFO run queue, head is running */
+typedef struct {
+    int32_t head;
+    int32_t tail;
+    uint32_t count;
+    uint32_t cpu_sum;
+    uint32_t temperature;
+    uint32_t pressure;
+} sim_core_t;
+
+/* Per-policy results */
+typedef struct {
+    uint64_t makespan;
+    uint64_t migrations;
+    uint64_t lb_migrations;
+    uint64_t unbalanced_checks;
+    uint64_t checks;
+    uint32_t p50, p99, max_latency;
+    double mean_imbalance;
+    uint32_t max_imbalance;
+    uint32_t windows;
+    float window_imbalance[SIM_MAX_WINDOWS];
+} sim_result_t;
+
+static const char* policy_names[] = {
+    "round_robin", "least_loaded", "priority", "mem_affinity", "thermal", "hybrid"
+};
+#define SIM_NUM_POLICIES (sizeof(policy_names) / sizeof(policy_names[0]))
+
+static sim_event_t events[SIM_MAX_EVENTS];
+static uint32_t num_events;
+static sim_task_t tasks[SIM_MAX_EVENTS];
+static uint32_t num_tasks;
+static sim_core_t cores[SIM_MAX_CORES];
+static uint32_t num_cores = 8;
+static uint32_t latencies[SIM_MAX_EVENTS];
+static uint32_t num_latencies;
+static uint64_t sim_now;
+
+/* Host Shims
+ *
+ * Everything is single threaded, so atomics are plain memory accesses
+ * and the lock is a no-op.
+ */
+uint64_t get_system_time_ms(void) { return sim_now; }
+void* mutex_create(void) { return (void*)1; }
+void mutex_lock(void* mutex) { (void)mutex; }
+void mutex_unlock(void* mutex) { (void)mutex; }
+void mutex_destroy(void* mutex) { (void)mutex; }
+
+void memory_fence_acquire(void) {}
+void memory_fence_release(void) {}
+uint32_t atomic_load_explicit_u32(const atomic_uint32_t *obj, memory_order_t order) { return obj->value; }
+void atomic_store_explicit_u32(atomic_uint32_t *obj, uint32_t value, memory_order_t order) { obj->value = value; }
+uint32_t atomic_fetch_add_explicit_u32(atomic_uint32_t *obj, uint32_t value, memory_order_t order) {
+    uint32_t old = obj->value;
+    obj->value = old + value;
+    return old;
+}
+uint32_t atomic_fetch_sub_explicit_u32(atomic_uint32_t *obj, uint32_t value, memory_order_t order) {
+    uint32_t old = obj->value;
+    obj->value = old - value;
+    return old;
+}
+bool atomic_compare_exchange_strong_explicit_u32(atomic_uint32_t *obj, uint32_t *expected, uint32_t desired,
+                                                 memory_order_t success, memory_order_t failure) {
+    if (obj->value == *expected) {
+        obj->value = desired;
+        return true;
+    }
+    *expected = obj->value;
+    return false;
+}
+uint64_t atomic_load_explicit_u64(const atomic_uint64_t *obj, memory_order_t order) { return obj->value; }
+uint64_t atomic_fetch_add_explicit_u64(atomic_uint64_t *obj, uint64_t value, memory_order_t order) {
+    uint64_t old = obj->value;
+    obj->value = old + value;
+    return old;
+}
+void* atomic_load_explicit_ptr(const atomic_ptr_t *obj, memory_order_t order) { return (void*)obj->value; }
+void atomic_store_explicit_ptr(atomic_ptr_t *obj, void* value, memory_order_t order) { obj->value = value; }
+
+/* The simulator drives the synchronous paths only */
+bool async_register_handler(async_op_type_t type, const char* name, async_handler_t handler) { return true; }
+async_future_t async_submit(async_op_type_t type, void* params, uint32_t param_size,
+                            async_callback_t callback, void* context,
+                            uint64_t deadline, uint32_t priority) {
+    async_future_t none = { NULL, 0 };
+    return none;
+}
+uint32_t async_submit_batch(const async_request_t* reqs, uint32_t count, async_future_t* futures) { return 0; }
+void async_future_release(async_future_t future) { }
+
+/* Trace Loading */
+static uint32_t sim_rand(uint32_t *state) {
+    *state = *state * 1103515245u + 12345u;
+    return *state >> 8;
+}
+
+static bool load_trace(const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[256];
+    
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    
+    while (fgets(line, sizeof(line), f) && num_events < SIM_MAX_EVENTS) {
+        sim_event_t *ev = &events[num_events];
+        unsigned long long time;
+        unsigned a0, a1, a2, a3 = 0xffffffffu;
+        
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        
+        ev->kind = line[0];
+        if (ev->kind == 'A' && sscanf(line + 1, "%llu %u %u %u %x", &time, &a0, &a1, &a2, &a3) >= 4) {
+            ev->arg[0] = a0;
+            ev->arg[1] = a1;
+            ev->arg[2] = a2;
+            ev->arg[3] = a3;
+        } else if ((ev->kind == 'T' || ev->kind == 'M') &&
+                   sscanf(line + 1, "%llu %u %u", &time, &a0, &a1) == 3) {
+            ev->arg[0] = a0;
+            ev->arg[1] = a1;
+        } else {
+            fprintf(stderr, "bad trace line: %s", line);
+            continue;
+        }
+        ev->time = time;
+        num_events++;
+    }
+    
+    fclose(f);
+    return true;
+}
+
+/* Bursts every 200 ms on top of a steady trickle, with occasional hot
+ * cores and memory pressure spikes
+ */
+static void generate_trace(uint32_t count, uint32_t seed) {
+    uint32_t rng = seed;
+    uint64_t time = 0;
+    
+    while (num_events < count && num_events < SIM_MAX_EVENTS) {
+        sim_event_t *ev = &events[num_events++];
+        uint32_t r = sim_rand(&rng) % 100;
+        
+        if (time % 200 == 0 && r < 50) {
+            // Burst: several arrivals at the same instant
+        } else {
+            time += 1 + sim_rand(&rng) % 8;
+        }
+        
+        ev->time = time;
+        if (r < 3) {
+            ev->kind = 'T';
+            ev->arg[0] = sim_rand(&rng) % num_cores;
+            ev->arg[1] = 70 + sim_rand(&rng) % 30;
+        } else if (r < 5) {
+            ev->kind = 'M';
+            ev->arg[0] = sim_rand(&rng) % num_cores;
+            ev->arg[1] = 60 + sim_rand(&rng) % 40;
+        } else {
+            // Runtime skewed short with a long tail
+            uint32_t runtime = 1 + sim_rand(&rng) % 20;
+            if (sim_rand(&rng) % 10 == 0) {
+                runtime += sim_rand(&rng) % 200;
+            }
+            ev->kind = 'A';
+            ev->arg[0] = runtime;
+            ev->arg[1] = 10 + sim_rand(&rng) % 91;
+            ev->arg[2] = sim_rand(&rng) % 10;
+            ev->arg[3] = 0xffffffffu;
+        }
+    }
+}
+
+/* Run Queues */
+static void core_push(uint32_t c, int32_t t) {
+    sim_core_t *core = &cores[c];
+    
+    tasks[t].next = SIM_NO_TASK;
+    if (core->tail == SIM_NO_TASK) {
+        core->head = t;
+    } else {
+        tasks[core->tail].next = t;
+    }
+    core->tail = t;
+    core->count++;
+    core->cpu_sum += tasks[t].cpu;
+}
+
+/* Detach the last waiting (not running) task */
+static int32_t core_steal_tail(uint32_t c) {
+    sim_core_t *core = &cores[c];
+    int32_t prev = core->head;
+    
+    if (core->count < 2) {
+        return SIM_NO_TASK;
+    }
+    while (tasks[prev].next != core->tail) {
+        prev = tasks[prev].next;
+    }
+    
+    int32_t t = core->tail;
+    tasks[prev].next = SIM_NO_TASK;
+    core->tail = prev;
+    core->count--;
+    core->cpu_sum -= tasks[t].cpu;
+    return t;
+}
+
+static void push_metrics(uint32_t c) {
+    core_metrics_t metrics;
+    
+    memset(&metrics, 0, sizeof(metrics));
+    metrics.cpu_usage.value = cores[c].cpu_sum > 100 ? 100 : cores[c].cpu_sum;
+    metrics.task_count.value = cores[c].count;
+    metrics.memory_pressure.value = cores[c].pressure;
+    metrics.temperature.value = cores[c].temperature;
+    lb_update_metrics(c, &metrics);
+}
+
+/* The balancer moves task counts; mirror its decisions by moving
+ * waiting tasks from cores it drained to cores it filled
+ */
+static uint32_t reconcile(void) {
+    int32_t delta[SIM_MAX_CORES];
+    uint32_t moved = 0;
+    
+    for (uint32_t c = 0; c < num_cores; c++) {
+        lb_core_snapshot_t snap;
+        lb_read_core_metrics(c, &snap);
+        delta[c] = (int32_t)snap.task_count - (int32_t)cores[c].count;
+    }
+    
+    for (uint32_t src = 0; src < num_cores; src++) {
+        for (uint32_t dst = 0; dst < num_cores && delta[src] < 0; dst++) {
+            while (delta[dst] > 0 && delta[src] < 0) {
+                int32_t t = core_steal_tail(src);
+                if (t == SIM_NO_TASK) {
+                    delta[src] = 0;
+                    break;
+                }
+                core_push(dst, t);
+                delta[src]++;
+                delta[dst]--;
+                moved++;
+            }
+        }
+    }
+    
+    // Re-sync whatever couldn't be mirrored (e.g. running tasks)
+    for (uint32_t c = 0; c < num_cores; c++) {
+        if (delta[c] != 0) {
+            push_metrics(c);
+        }
+    }
+    return moved;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Simulation */
+static void simulate(lb_policy_t policy, const uint32_t *geometry, uint32_t interval,
+                     sim_result_t *res) {
+    lb_config_t config = {
+        .policy = policy,
+        .update_interval = interval,
+        .migration_threshold = 20,
+        .max_migrations = 8,
+        .thermal_throttling = true,
+        .dynamic_policy = false
+    };
+    lb_topology_t topo = { .num_cores = num_cores };
+    uint32_t next_event = 0;
+    uint32_t done = 0;
+    uint64_t imbalance_sum = 0;
+    uint64_t window_sum = 0;
+    
+    memset(res, 0, sizeof(*res));
+    memset(cores, 0, sizeof(cores));
+    for (uint32_t c = 0; c < num_cores; c++) {
+        cores[c].head = cores[c].tail = SIM_NO_TASK;
+        cores[c].temperature = SIM_AMBIENT_TEMP;
+        
+        // Flat unless a geometry was given: one LLC, one package
+        uint32_t smt = geometry[0], per_llc = geometry[1], per_pkg = geometry[2];
+        topo.core_id[c] = c / smt;
+        topo.llc_id[c] = per_llc ? c / (smt * per_llc) : 0;
+        topo.package_id[c] = (per_llc && per_pkg) ? c / (smt * per_llc * per_pkg) : 0;
+    }
+    num_tasks = 0;
+    num_latencies = 0;
+    
+    sim_now = 1;
+    lb_shutdown();
+    lb_init(&config);
+    lb_set_topology(&topo);
+    
+    for (; done < num_tasks || next_event < num_events; sim_now++) {
+        // Deliver this millisecond's events
+        while (next_event < num_events && events[next_event].time <= sim_now) {
+            sim_event_t *ev = &events[next_event++];
+            
+            if (ev->kind == 'A') {
+                task_requirements_t req = {
+                    .priority = ev->arg[2],
+                    .cpu_requirement = ev->arg[1],
+                    .memory_requirement = 0,
+                    .deadline = 0,
+                    .realtime = false,
+                    .affinity_mask = ev->arg[3]
+                };
+                int32_t t = num_tasks++;
+                tasks[t].arrival = sim_now;
+                tasks[t].remaining = ev->arg[0] ? ev->arg[0] : 1;
+                tasks[t].cpu = ev->arg[1];
+                
+                uint32_t c = lb_balance_task(&req);
+                core_push(c < num_cores ? c : 0, t);
+            } else if (ev->arg[0] < num_cores) {
+                if (ev->kind == 'T') {
+                    cores[ev->arg[0]].temperature = ev->arg[1];
+                } else {
+                    cores[ev->arg[0]].pressure = ev->arg[1];
+                }
+            }
+        }
+        
+        // Balancer period: publish metrics, let handlers and the
+        // hierarchical pass act, and mirror their moves
+        if (sim_now % interval == 0) {
+            for (uint32_t c = 0; c < num_cores; c++) {
+                push_metrics(c);
+                res->migrations += reconcile();
+            }
+            lb_rebalance();
+            res->migrations += reconcile();
+            
+            res->checks++;
+            if (!lb_check_balance()) {
+                res->unbalanced_checks++;
+            }
+        }
+        
+        // Run one millisecond on every core
+        uint32_t max_len = 0, min_len = UINT32_MAX;
+        for (uint32_t c = 0; c < num_cores; c++) {
+            sim_core_t *core = &cores[c];
+            
+            if (core->head != SIM_NO_TASK && --tasks[core->head].remaining == 0) {
+                int32_t t = core->head;
+                latencies[num_latencies++] = (uint32_t)(sim_now + 1 - tasks[t].arrival);
+                core->head = tasks[t].next;
+                if (core->head == SIM_NO_TASK) {
+                    core->tail = SIM_NO_TASK;
+                }
+                core->count--;
+                core->cpu_sum -= tasks[t].cpu;
+                done++;
+                res->makespan = sim_now + 1;
+            }
+            
+            // Hot cores cool towards ambient
+            if (core->temperature > SIM_AMBIENT_TEMP && sim_now % 10 == 0) {
+                core->temperature--;
+            }
+            
+            max_len = core->count > max_len ? core->count : max_len;
+            min_len = core->count < min_len ? core->count : min_len;
+        }
+        
+        // Imbalance over time
+        imbalance_sum += max_len - min_len;
+        window_sum += max_len - min_len;
+        if (max_len - min_len > res->max_imbalance) {
+            res->max_imbalance = max_len - min_len;
+        }
+        if (sim_now % SIM_WINDOW_MS == 0) {
+            if (res->windows < SIM_MAX_WINDOWS) {
+                res->window_imbalance[res->windows++] = (float)window_sum / SIM_WINDOW_MS;
+            }
+            window_sum = 0;
+        }
+    }
+    
+    lb_stats_t stats;
+    lb_get_stats(&stats);
+    res->lb_migrations = stats.total_migrations.value;
+    res->mean_imbalance = sim_now ? (double)imbalance_sum / sim_now : 0;
+    
+    if (num_latencies) {
+        qsort(latencies, num_latencies, sizeof(uint32_t), cmp_u32);
+        res->p50 = latencies[num_latencies / 2];
+        res->p99 = latencies[(uint64_t)num_latencies * 99 / 100];
+        res->max_latency = latencies[num_latencies - 1];
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [-c cores] [-g smt,cores_per_llc,llcs_per_pkg] [-t trace]\n"
+        "          [-n tasks] [-s seed] [-i interval_ms] [-p policy] [-v]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    const char *trace = NULL;
+    uint32_t count = 5000;
+    uint32_t seed = 1;
+    uint32_t interval = 4;
+    uint32_t geometry[3] = { 1, 0, 0 };
+    int only_policy = -1;
+    bool verbose = false;
+    static sim_result_t res;
+    
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+            num_cores = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-g") && i + 1 < argc) {
+            sscanf(argv[++i], "%u,%u,%u", &geometry[0], &geometry[1], &geometry[2]);
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            trace = argv[++i];
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            interval = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+            only_policy = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-v")) {
+            verbose = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (num_cores == 0 || num_cores > SIM_MAX_CORES || interval == 0 || geometry[0] == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    if (trace) {
+        if (!load_trace(trace)) {
+            return 1;
+        }
+    } else {
+        generate_trace(count, seed);
+    }
+    
+    printf("cores=%u events=%u interval=%ums thermal=%u mem_pressure=%u imbalance=%u\n",
+           num_cores, num_events, interval,
+           THERMAL_THRESHOLD, MEMORY_PRESSURE_THRESHOLD, LOAD_IMBALANCE_THRESHOLD);
+    printf("%-13s %9s %8s %8s %6s %6s %7s %8s %7s %9s\n",
+           "policy", "makespan", "migr", "lb_migr", "p50", "p99", "max", "imb_avg", "imb_max", "unbal%");
+    
+    for (uint32_t p = 0; p < SIM_NUM_POLICIES; p++) {
+        if (only_policy >= 0 && (uint32_t)only_policy != p) {
+            continue;
+        }
+        
+        simulate((lb_policy_t)p, geometry, interval, &res);
+        printf("%-13s %9llu %8llu %8llu %6u %6u %7u %8.2f %7u %8.1f%%\n",
+               policy_names[p],
+               (unsigned long long)res.makespan,
+               (unsigned long long)res.migrations,
+               (unsigned long long)res.lb_migrations,
+               res.p50, res.p99, res.max_latency,
+               res.mean_imbalance, res.max_imbalance,
+               res.checks ? 100.0 * res.unbalanced_checks / res.checks : 0.0);
+        
+        if (verbose) {
+            printf("  imbalance per %ums:", SIM_WINDOW_MS);
+            for (uint32_t w = 0; w < res.windows; w++) {
+                printf(" %.1f", res.window_imbalance[w]);
+            }
+            printf("\n");
+        }
+    }
+    
+    lb_shutdown();
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef TC_BENCH_HOST_H
+#define TC_BENCH_HOST_H
+
+/* Host shims for building traffic_control.c into the share benchmark
+ * (examples/tc_fair_bench.c). The RTOS type and timer headers clash with
+ * scheduler.h on a host build and traffic_control.c only needs tcb_t from
+ * them, so their include guards are pre-claimed here.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define RTOS_TYPES_H
+#define TIMER_H
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#define MAX_CPU 1
+
+/* Virtual time, advanced by the benchmark */
+uint32_t get_system_time(void);
+uint8_t get_current_cpu(void);
+
+#endif /* TC_BENCH_HOST_H */
@@ -0,0 +1,229 @@
+/* Traffic-control CPU share benchmark
+ *
+ * Keeps every traffic class backlogged with tasks of random time slice,
+ * drains them through tc_dequeue_task() under strict priority and under
+ * TC_POLICY_FAIR_QUEUE, and compares the service each class received with
+ * its tc_set_cpu_share() percentage. Service is counted in time-slice
+ * units, the same cost the dequeue path charges.
+ *
+ * Build (host):
+ *   gcc -O2 -std=gnu11 -Iinclude -include examples/tc_bench_host.h \
+ *       examples/tc_fair_bench.c src/traffic_control.c -o tc_bench
+ *
+ * Usage:
+ *   tc_bench [-n dequeues] [-w s0,s1,s2,s3,s4] [-m max_slice]
+ *            [-W window] [-s seed]
+ *
+ * The error columns are in percentage points: "err" over the whole run,
+ * "win" the worst deviation seen in any window of -W service units.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "traffic_control.h"
+#include "memory_order.h"
+
+#define BENCH_TASKS_PER_CLASS 8
+#define BENCH_NUM_MODES 2
+
+static uint32_t bench_now;
+static uint32_t bench_seed;
+static tcb_t tasks[TC_MAX_CLASSES][BENCH_TASKS_PER_CLASS];
+
+static const char *mode_names[BENCH_NUM_MODES] = { "strict", "fair_queue" };
+static const tc_policy_t mode_policies[BENCH_NUM_MODES] = {
+    TC_POLICY_STRICT, TC_POLICY_FAIR_QUEUE
+};
+
+/* Per-run results */
+typedef struct {
+    uint64_t service[TC_MAX_CLASSES];
+    uint64_t total;
+    double worst_window[TC_MAX_CLASSES];
+    uint32_t drops;
+} bench_result_t;
+
+/* Host Shims
+ *
+ * Single threaded on one CPU, so atomics are plain memory accesses.
+ */
+uint32_t get_system_time(void) { return bench_now; }
+uint8_t get_current_cpu(void) { return 0; }
+
+uint32_t atomic_load_explicit_u32(const atomic_uint32_t *obj, memory_order_t order) { return obj->value; }
+void atomic_store_explicit_u32(atomic_uint32_t *obj, uint32_t value, memory_order_t order) { obj->value = value; }
+uint32_t atomic_fetch_add_explicit_u32(atomic_uint32_t *obj, uint32_t value, memory_order_t order) {
+    uint32_t old = obj->value;
+    obj->value = old + value;
+    return old;
+}
+bool atomic_compare_exchange_strong_explicit_u32(atomic_uint32_t *obj, uint32_t *expected, uint32_t desired,
+                                                 memory_order_t success, memory_order_t failure) {
+    if (obj->value == *expected) {
+        obj->value = desired;
+        return true;
+    }
+    *expected = obj->value;
+    return false;
+}
+uint64_t atomic_load_explicit_u64(const atomic_uint64_t *obj, memory_order_t order) { return obj->value; }
+void atomic_store_explicit_u64(atomic_uint64_t *obj, uint64_t value, memory_order_t order) { obj->value = value; }
+bool atomic_compare_exchange_strong_explicit_u64(atomic_uint64_t *obj, uint64_t *expected, uint64_t desired,
+                                                 memory_order_t success, memory_order_t failure) {
+    if (obj->value == *expected) {
+        obj->value = desired;
+        return true;
+    }
+    *expected = obj->value;
+    return false;
+}
+
+static uint32_t bench_rand(void) {
+    bench_seed = bench_seed * 1103515245u + 12345u;
+    return bench_seed >> 16;
+}
+
+static void requeue(tcb_t *task, uint32_t max_slice, bench_result_t *res) {
+    task->time_slice = 1 + bench_rand() % max_slice;
+    if (tc_enqueue_task(task) < 0) {
+        res->drops++;
+    }
+}
+
+static void run(tc_policy_t policy, const uint8_t *shares, uint32_t dequeues,
+                uint32_t max_slice, uint32_t window, uint32_t seed,
+                bench_result_t *res) {
+    uint64_t win_service[TC_MAX_CLASSES] = { 0 };
+    uint64_t win_total = 0;
+    uint32_t share_sum = 0;
+    
+    memset(res, 0, sizeof(*res));
+    bench_now = 0;
+    bench_seed = seed;
+    tc_init();
+    
+    for (int c = 0; c < TC_MAX_CLASSES; c++) {
+        tc_set_policy(c, policy);
+        tc_set_cpu_share(c, shares[c]);
+        share_sum += shares[c];
+    }
+    
+    for (int c = 0; c < TC_MAX_CLASSES; c++) {
+        for (int t = 0; t < BENCH_TASKS_PER_CLASS; t++) {
+            memset(&tasks[c][t], 0, sizeof(tcb_t));
+            tc_assign_task_class(&tasks[c][t], c);
+            requeue(&tasks[c][t], max_slice, res);
+        }
+    }
+    
+    for (uint32_t i = 0; i < dequeues; i++) {
+        tcb_t *task = tc_dequeue_task();
+        if (!task) break;
+        
+        traffic_class_t class = tc_get_task_class(task);
+        uint32_t cost = task->time_slice;
+        
+        res->service[class] += cost;
+        res->total += cost;
+        win_service[class] += cost;
+        win_total += cost;
+        bench_now += cost;
+        
+        // Close the window and record each class's deviation
+        if (win_total >= window) {
+            for (int c = 0; c < TC_MAX_CLASSES; c++) {
+                double want = share_sum ? 100.0 * shares[c] / share_sum : 0;
+                double got = 100.0 * win_service[c] / win_total;
+                double err = got > want ? got - want : want - got;
+                if (err > res->worst_window[c]) res->worst_window[c] = err;
+                win_service[c] = 0;
+            }
+            win_total = 0;
+        }
+        
+        requeue(task, max_slice, res);
+    }
+    
+    tc_shutdown();
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [-n dequeues] [-w s0,s1,s2,s3,s4] [-m max_slice]\n"
+        "          [-W window] [-s seed]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    uint32_t dequeues = 100000;
+    uint32_t max_slice = 10;
+    uint32_t window = 1000;
+    uint32_t seed = 1;
+    unsigned int parsed[TC_MAX_CLASSES] = { 40, 25, 20, 10, 5 };
+    uint8_t shares[TC_MAX_CLASSES];
+    uint32_t share_sum = 0;
+    static bench_result_t res;
+    
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            dequeues = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-w") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%u,%u,%u,%u,%u", &parsed[0], &parsed[1],
+                       &parsed[2], &parsed[3], &parsed[4]) != TC_MAX_CLASSES) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+            max_slice = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-W") && i + 1 < argc) {
+            window = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    for (int c = 0; c < TC_MAX_CLASSES; c++) {
+        if (parsed[c] > 100) {
+            usage(argv[0]);
+            return 1;
+        }
+        shares[c] = parsed[c];
+        share_sum += shares[c];
+    }
+    
+    if (max_slice == 0 || window == 0 || share_sum == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    printf("dequeues=%u max_slice=%u window=%u seed=%u\n",
+           dequeues, max_slice, window, seed);
+    
+    for (uint32_t m = 0; m < BENCH_NUM_MODES; m++) {
+        double err_sum = 0, err_max = 0, win_max = 0;
+        
+        run(mode_policies[m], shares, dequeues, max_slice, window, seed, &res);
+        printf("\n%s: service=%llu drops=%u\n", mode_names[m],
+               (unsigned long long)res.total, res.drops);
+        printf("  %-12s %6s %8s %7s %7s\n", "class", "share%", "served%", "err", "win");
+        
+        for (int c = 0; c < TC_MAX_CLASSES; c++) {
+            double want = 100.0 * shares[c] / share_sum;
+            double got = res.total ? 100.0 * res.service[c] / res.total : 0;
+            double err = got > want ? got - want : want - got;
+            
+            err_sum += err;
+            if (err > err_max) err_max = err;
+            if (res.worst_window[c] > win_max) win_max = res.worst_window[c];
+            printf("  %-12s %6.1f %8.2f %7.2f %7.2f\n",
+                   tc_class_to_string(c), want, got, err, res.worst_window[c]);
+        }
+        printf("  mean_err=%.3f max_err=%.3f worst_window=%.2f\n",
+               err_sum / TC_MAX_CLASSES, err_max, win_max);
+    }
+    
+    return 0;
+}
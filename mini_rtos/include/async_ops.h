@@ -14,49 +14,163 @@ typedef enum {
     ASYNC_STATUS_CANCELLED
 } async_status_t;
 
-/* Operation Types */
+/* Operation Types
+ *
+ * Fixed ids for the load balancer; further types are allocated at run
+ * time by async_register_type(). Every queued type needs a handler.
+ */
 typedef enum {
     ASYNC_OP_TASK_MIGRATION,
     ASYNC_OP_LOAD_UPDATE,
     ASYNC_OP_POLICY_CHANGE,
     ASYNC_OP_THERMAL_ADJUST,
-    ASYNC_OP_MEMORY_REBALANCE
+    ASYNC_OP_MEMORY_REBALANCE,
+    ASYNC_OP_PROMISE,           /* Completed by async_promise_complete(), never queued */
+    ASYNC_OP_DYNAMIC_BASE       /* First id handed out by async_register_type() */
 } async_op_type_t;
 
+#define ASYNC_MAX_OP_TYPES 32
+
+/* Operation Handler: runs on a worker with the op's parameter block */
+typedef bool (*async_handler_t)(void* params, void** result);
+
+/* Priority Lanes
+ *
+ * Workers drain lanes in strict order, high first, both locally and
+ * when stealing. Ops map to a lane by their submit priority.
+ */
+#define ASYNC_LANES 3
+#define ASYNC_LANE_HIGH 0
+#define ASYNC_LANE_NORMAL 1
+#define ASYNC_LANE_LOW 2
+
+#define ASYNC_PRIORITY_HIGH 8       /* priority >= this: high lane */
+#define ASYNC_PRIORITY_NORMAL 4     /* priority >= this: normal lane */
+
+/* Per-Type Statistics */
+typedef struct {
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t failed;
+    uint64_t cancelled;
+    uint64_t queue_ns_total;        /* Submit to start of run */
+    uint64_t queue_ns_max;
+    uint64_t run_ns_total;
+    uint64_t run_ns_max;
+} async_type_stats_t;
+
 /* Completion Callback */
 typedef void (*async_callback_t)(void* context, async_status_t status, void* result);
 
+/* Parameter storage: small blocks live inline in the op, larger ones
+ * (up to ASYNC_PARAM_BLOCK_SIZE) come from a fixed block pool
+ */
+#define ASYNC_INLINE_PARAMS 64
+#define ASYNC_PARAM_BLOCK_SIZE 512
+#define ASYNC_PARAM_BLOCKS 128
+#define ASYNC_NO_PARAM_BLOCK UINT32_MAX
+
+struct async_op;
+
+/* Continuation, run by whoever completes the op */
+typedef struct async_cont {
+    void (*run)(struct async_cont* cont, async_status_t status, void* result);
+    async_callback_t fn;
+    void* context;
+    struct async_op* target;        /* Promise completed by this continuation */
+    uint32_t target_id;             /* target->op_id when attached */
+    struct async_cont* next;
+} async_cont_t;
+
 /* Async Operation Structure */
 typedef struct async_op {
     uint32_t op_id;
     async_op_type_t type;
+    async_handler_t handler;
+    uint8_t lane;
+    uint64_t submit_ns;
     atomic_uint32_t status;
     void* params;
     uint32_t param_size;
+    uint32_t param_block;           /* Pool block index or ASYNC_NO_PARAM_BLOCK */
     async_callback_t callback;
     void* callback_context;
     atomic_ptr_t next;
     uint64_t deadline;
     uint32_t priority;
     atomic_bool cancellable;
+    void* result;
+    atomic_ptr_t conts;             /* async_cont_t list, closed on completion */
+    atomic_uint32_t refs;           /* Completion + futures + continuations */
+    atomic_uint32_t pending_inputs; /* when_all: inputs still outstanding */
+    atomic_uint32_t combined_status;
+    uint8_t inline_params[ASYNC_INLINE_PARAMS] ALIGNED(8);
 } async_op_t;
 
-/* Async Queue Structure */
+/* Completion Handle
+ *
+ * Returned by async_submit() and the combinators, each holding a
+ * reference on the pooled op: it is recycled only once it has completed
+ * and every future has been passed to async_future_release(). Copies
+ * share the one reference. op_id catches use after release.
+ */
+typedef struct {
+    async_op_t* op;
+    uint32_t op_id;
+} async_future_t;
+
+#define ASYNC_FUTURE_VALID(f) ((f).op != NULL)
+
+/* Work-Stealing Deque (Chase-Lev)
+ *
+ * The owning worker pushes and pops at 'bottom' without locks; other
+ * workers steal from 'top' with a CAS. Fixed capacity; indices are free
+ * running and wrap.
+ */
+#define ASYNC_DEQUE_SIZE 256
+#define ASYNC_DEQUE_MASK (ASYNC_DEQUE_SIZE - 1)
+
 typedef struct {
-    atomic_ptr_t head;
-    atomic_ptr_t tail;
-    atomic_uint32_t count;
-    void* lock;
-} async_queue_t;
+    atomic_uint32_t top;
+    atomic_uint32_t bottom;
+    async_op_t* volatile slots[ASYNC_DEQUE_SIZE];
+} async_deque_t;
 
 /* Initialize async operations system */
 bool async_init(uint32_t num_workers);
 
+/* Bind a handler to a fixed type id */
+bool async_register_handler(async_op_type_t type, const char* name, async_handler_t handler);
+
+/* Allocate a new type id bound to handler; -1 when the table is full */
+int32_t async_register_type(const char* name, async_handler_t handler);
+
+/* Snapshot per-type statistics */
+bool async_get_type_stats(async_op_type_t type, async_type_stats_t* stats);
+
 /* Submit an async operation */
-uint32_t async_submit(async_op_type_t type, void* params, uint32_t param_size,
+async_future_t async_submit(async_op_type_t type, void* params, uint32_t param_size,
                      async_callback_t callback, void* context,
                      uint64_t deadline, uint32_t priority);
 
+/* Batched Submission */
+typedef struct {
+    async_op_type_t type;
+    const void* params;
+    uint32_t param_size;
+    async_callback_t callback;
+    void* context;
+    uint64_t deadline;
+    uint32_t priority;
+} async_request_t;
+
+/* Submit count ops with a single enqueue and a single wakeup.
+ * Returns the number queued (a prefix of reqs); futures may be NULL,
+ * otherwise each queued op's future must be released.
+ */
+uint32_t async_submit_batch(const async_request_t* reqs, uint32_t count,
+                           async_future_t* futures);
+
 /* Cancel an async operation */
 bool async_cancel(uint32_t op_id);
 
@@ -66,6 +180,36 @@ bool async_wait(uint32_t op_id, uint32_t timeout_ms);
 /* Get operation status */
 async_status_t async_get_status(uint32_t op_id);
 
+/* Future status and result */
+async_status_t async_future_status(async_future_t future);
+void* async_future_result(async_future_t future);
+
+/* Drop a future's reference; the future must not be used afterwards */
+void async_future_release(async_future_t future);
+
+/* Block until the op completes; true if it did within timeout_ms.
+ * Must not be called from an async worker on an op queued to it.
+ */
+bool async_future_wait(async_future_t future, uint32_t timeout_ms);
+
+/* Run fn on the completing worker (inline if already complete).
+ * The returned future completes, with the same status, after fn ran.
+ * Invalid if no op or continuation node is free; fn then never runs.
+ */
+async_future_t async_then(async_future_t future, async_callback_t fn, void* context);
+
+/* Complete when all inputs have (FAILED/CANCELLED if any input was),
+ * or when the first input does, with that input's status and result.
+ * With no inputs when_all completes at once and when_any fails at once.
+ * Invalid if the nodes for every input can't be reserved up front.
+ */
+async_future_t async_when_all(const async_future_t* futures, uint32_t count);
+async_future_t async_when_any(const async_future_t* futures, uint32_t count);
+
+/* Promises: futures completed explicitly rather than by a worker */
+async_future_t async_promise_create(void);
+bool async_promise_complete(async_future_t promise, async_status_t status, void* result);
+
 /* Process pending operations (called by worker threads) */
 void async_process_ops(void);
 
@@ -0,0 +1,36 @@
+#ifndef MINI_RTOS_CRC32C_H
+#define MINI_RTOS_CRC32C_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* CRC-32C (Castagnoli, reflected polynomial 0x82F63B78)
+ *
+ * crc32c_update() works on the raw register so a checksum can be carried
+ * across buffers: start from CRC32C_INIT and complement the final value.
+ * crc32c_init() picks the fastest implementation the CPU supports:
+ * SSE4.2 crc32 on x86, the ARMv8 CRC extension on ARM, otherwise
+ * slicing-by-8 tables. All implementations give identical results.
+ */
+#define CRC32C_INIT 0xFFFFFFFFu
+
+typedef enum {
+    CRC32C_IMPL_BYTE = 0,      /* One table lookup per byte */
+    CRC32C_IMPL_SLICE8,        /* Eight tables, eight bytes per step */
+    CRC32C_IMPL_SSE42,         /* x86 crc32 instruction */
+    CRC32C_IMPL_ARMV8,         /* ARMv8 crc32c instructions */
+    CRC32C_IMPL_COUNT
+} crc32c_impl_t;
+
+void crc32c_init(void);
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t length);
+uint32_t crc32c(const void *data, size_t length);
+
+/* Implementation selection */
+bool crc32c_impl_available(crc32c_impl_t impl);
+bool crc32c_select(crc32c_impl_t impl);
+crc32c_impl_t crc32c_get_impl(void);
+const char *crc32c_impl_name(crc32c_impl_t impl);
+
+#endif /* MINI_RTOS_CRC32C_H */
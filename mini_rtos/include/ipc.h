@@ -2,14 +2,17 @@
 #define IPC_H
 
 #include "rtos_types.h"
+#include "memory_order.h"
 #include <stdint.h>
+#include <stdbool.h>
 
 /* Message Types */
 typedef enum {
     MSG_NORMAL = 0,
     MSG_HIGH_PRIORITY,
     MSG_URGENT,
-    MSG_SYSTEM
+    MSG_SYSTEM,
+    MSG_TYPE_COUNT
 } message_type_t;
 
 /* Message Structure */
@@ -22,23 +25,99 @@ typedef struct {
     void *data;
 } message_t;
 
-/* Message Queue */
+/* Message Queue
+ *
+ * Queued messages sit on three lists at once: arrival order, their
+ * type's list and their sender's list. msg_receive_match() takes the
+ * oldest message of a type or from a sender straight off the matching
+ * list; msg_receive_filtered() still scans in arrival order for
+ * arbitrary filters. Sender lists are found through an open-addressed
+ * table sized for every queued message to have a distinct sender.
+ */
+#define MSG_NIL             0xFFFFFFFFu
+
+enum {
+    MSG_LINK_FIFO = 0,
+    MSG_LINK_TYPE,
+    MSG_LINK_SENDER,
+    MSG_LINK_COUNT
+};
+
+typedef struct {
+    message_t msg;
+    uint32_t next[MSG_LINK_COUNT];
+    uint32_t prev[MSG_LINK_COUNT];
+} msg_node_t;
+
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t count;
+} msg_list_t;
+
+typedef struct {
+    uint32_t sender_id;
+    msg_list_t list;            /* count 0 marks a free slot */
+} msg_sender_slot_t;
+
 typedef struct msg_queue {
-    message_t *messages;
+    msg_node_t *nodes;
     uint32_t capacity;
     uint32_t count;
-    uint32_t head;
-    uint32_t tail;
-    tcb_t *waiting_send;
-    tcb_t *waiting_receive;
+    uint32_t free_head;         /* Unused nodes, chained through next[FIFO] */
+    msg_list_t fifo;
+    msg_list_t by_type[MSG_TYPE_COUNT];
+    msg_sender_slot_t *by_sender;
+    uint32_t sender_mask;
+    atomic_uint32_t rx_waiters; /* Receivers waiting for a message */
+    atomic_uint32_t rx_epoch;
+    atomic_uint32_t tx_waiters; /* Senders waiting for room */
+    atomic_uint32_t tx_epoch;
+    void *rx_sem;               /* Target port wait objects */
+    void *tx_sem;
     mutex_t *lock;
+    void *base;                 /* Allocation holding queue, nodes and table */
 } msg_queue_t;
 
-/* Event Flags */
+/* Typed filters for msg_receive_match() */
+#define MSG_MATCH_TYPE      0x01
+#define MSG_MATCH_SENDER    0x02
+
+typedef struct {
+    uint32_t flags;             /* MSG_MATCH_* */
+    message_type_t type;
+    uint32_t sender_id;
+} msg_match_t;
+
+/* Event Flags
+ *
+ * Each waiter takes one of EVENT_MAX_WAITERS slots, and bit_waiters[b]
+ * holds the slots of every waiter whose mask includes bit b. Setting
+ * bits only examines the waiters indexed under those bits, and all
+ * wakeups it causes are issued together once the group is updated.
+ * Waiters beyond EVENT_MAX_WAITERS go on an unindexed overflow list
+ * that every set scans. Set and clear run in a critical section and may
+ * be called from ISRs.
+ */
+#define EVENT_BITS          32
+#define EVENT_MAX_WAITERS   32
+
+typedef struct event_waiter {
+    atomic_uint32_t state;      /* Set to 1 when woken */
+    uint32_t bits;
+    uint8_t operation;
+    uint32_t result;            /* Flags that satisfied the wait */
+    void *sem;                  /* Waiting thread's semaphore, or futex word on hosts */
+    struct event_waiter *prev;  /* Overflow list links */
+    struct event_waiter *next;
+} event_waiter_t;
+
 typedef struct {
     uint32_t flags;
-    tcb_t *waiting_tasks;
-    mutex_t *lock;
+    uint32_t waiter_map;        /* Occupied waiter slots */
+    uint32_t bit_waiters[EVENT_BITS];
+    event_waiter_t *waiters[EVENT_MAX_WAITERS];
+    event_waiter_t *overflow;   /* Waiters without a slot */
 } event_group_t;
 
 /* Event Operations */
@@ -46,6 +125,17 @@ typedef struct {
 #define EVENT_WAIT_ANY      0x02
 #define EVENT_CLEAR_ON_EXIT 0x04
 
+/* Timeouts are in milliseconds; 0 polls once */
+#define MSG_WAIT_FOREVER    0xFFFFFFFFu
+
+/* IPC Error Codes */
+#define IPC_ERR_NONE        0x00
+#define IPC_ERR_TIMEOUT     0x01
+#define IPC_ERR_INVALID     0x02
+#define IPC_ERR_TOO_LARGE   0x03
+#define IPC_ERR_NO_MEMORY   0x04
+#define IPC_ERR_EMPTY       0x05
+
 /* IPC Functions */
 msg_queue_t *msg_queue_create(uint32_t capacity);
 void msg_queue_delete(msg_queue_t *queue);
@@ -61,12 +151,175 @@ uint32_t event_group_clear_bits(event_group_t *group, uint32_t bits);
 uint32_t event_group_wait_bits(event_group_t *group, uint32_t bits, 
                               uint8_t operation, uint32_t timeout);
 
-/* Broadcast messaging */
+/* Broadcast messaging: publishes on the bus set by msg_bus_set_default() */
 int msg_broadcast(message_t *msg, uint32_t timeout);
 
 /* Message Filtering */
 typedef bool (*msg_filter_t)(message_t *msg, void *arg);
 int msg_receive_filtered(msg_queue_t *queue, message_t *msg, 
                         msg_filter_t filter, void *arg, uint32_t timeout);
+int msg_receive_match(msg_queue_t *queue, message_t *msg,
+                      const msg_match_t *match, uint32_t timeout);
+
+/* Shared-Memory Channels
+ *
+ * A channel is a ring of fixed-size slots with the payload stored inline,
+ * for exactly one sending and one receiving task. Each slot carries a
+ * sequence number: the sender publishes a slot by advancing it with a
+ * release store and the receiver hands it back the same way, so neither
+ * side takes a lock or touches the other's cursor. A side only sleeps
+ * when it finds the ring empty (receiver) or full (sender), and the peer
+ * only calls into the scheduler when it sees that side parked.
+ *
+ * The shared state holds no pointers. On the host port,
+ * msg_channel_create_shared() backs it with a memfd that another process
+ * maps with msg_channel_attach(); waits then use a futex on the shared
+ * parked flags.
+ *
+ * msg_channel_reserve()/msg_channel_publish() and
+ * msg_channel_acquire()/msg_channel_release() let either side work on
+ * the slot in place; msg_channel_send()/msg_channel_receive() copy.
+ */
+#define MSG_CHANNEL_MAGIC   0x4D434831u    /* "MCH1" */
+
+typedef struct {
+    atomic_uint32_t seq;        /* Publication sequence, own cache line */
+    uint32_t type;
+    uint32_t sender_id;
+    uint32_t receiver_id;
+    uint32_t msg_id;
+    uint32_t length;
+    uint8_t data[];
+} msg_slot_t;
+
+/* Start of the shared region, followed by slot_count slots */
+typedef struct {
+    uint32_t magic;
+    uint32_t slot_count;        /* Power of two */
+    uint32_t slot_size;         /* Largest inline payload */
+    uint32_t stride;            /* Bytes per slot, cache line multiple */
+    atomic_uint32_t head;       /* Next sequence to receive */
+    atomic_uint32_t tail;       /* Next sequence to send */
+    atomic_uint32_t rx_parked;  /* Receiver sleeping on empty */
+    atomic_uint32_t tx_parked;  /* Sender sleeping on full */
+} msg_channel_shm_t;
+
+typedef struct msg_channel {
+    msg_channel_shm_t *shm;
+    uint8_t *slots;
+    uint32_t mask;
+    void *base;                 /* Allocation or mapping holding shm */
+    uint32_t map_size;          /* Mapping length, 0 if allocated */
+    int fd;                     /* Backing memfd, -1 if task-local */
+    void *rx_sem;               /* Target port wait objects */
+    void *tx_sem;
+} msg_channel_t;
+
+msg_channel_t *msg_channel_create(uint32_t slot_count, uint32_t slot_size);
+msg_channel_t *msg_channel_create_shared(uint32_t slot_count, uint32_t slot_size);
+msg_channel_t *msg_channel_attach(int fd);
+int msg_channel_fd(msg_channel_t *channel);
+void msg_channel_delete(msg_channel_t *channel);
+
+int msg_channel_send(msg_channel_t *channel, const message_t *msg, uint32_t timeout);
+int msg_channel_receive(msg_channel_t *channel, message_t *msg, uint32_t timeout);
+uint32_t msg_channel_count(msg_channel_t *channel);
+
+/* Zero-copy: fill the returned slot, then publish; msg->data is ignored */
+void *msg_channel_reserve(msg_channel_t *channel, uint32_t length, uint32_t timeout);
+int msg_channel_publish(msg_channel_t *channel, const message_t *msg);
+/* Zero-copy: msg->data points into the slot until release */
+int msg_channel_acquire(msg_channel_t *channel, message_t *msg, uint32_t timeout);
+void msg_channel_release(msg_channel_t *channel);
+
+/* Broadcast Bus
+ *
+ * Publish/subscribe fan-out through one ring of depth entries. Each
+ * subscriber keeps its own cursor into the ring, so a message is stored
+ * once however many subscribers read it. Payloads come from a per-bus
+ * pool and are shared by reference: msg_bus_receive() hands out a
+ * reference that the subscriber drops with msg_payload_put(), and the
+ * ring drops its own when the entry is reused.
+ *
+ * A subscriber that falls a full ring behind is handled by its policy:
+ *   MSG_SUB_BLOCK   publishers wait until it catches up
+ *   MSG_SUB_DROP    it loses the overwritten messages and resumes at
+ *                   the oldest one still in the ring
+ *   MSG_SUB_LATEST  it skips straight to the newest message whenever
+ *                   more than one is pending
+ * Only MSG_SUB_BLOCK subscribers can hold publishers back.
+ *
+ * Any number of tasks may publish. Each subscriber is read by one task.
+ */
+#define MSG_BUS_MAX_SUBS    16
+
+typedef enum {
+    MSG_SUB_BLOCK = 0,
+    MSG_SUB_DROP,
+    MSG_SUB_LATEST
+} msg_sub_policy_t;
+
+typedef struct msg_payload {
+    atomic_uint32_t refs;
+    struct msg_bus *bus;        /* Owning pool */
+    struct msg_payload *next_free;
+    uint8_t data[];
+} msg_payload_t;
+
+typedef struct {
+    atomic_uint32_t seq;        /* Sequence + 1 once published */
+    message_t msg;
+    msg_payload_t *payload;     /* Reference held by the ring */
+} msg_bus_entry_t;
+
+typedef struct {
+    atomic_uint32_t cursor;     /* Next sequence to receive */
+    struct msg_bus *bus;
+    msg_sub_policy_t policy;
+    bool active;
+    uint32_t received;
+    uint32_t dropped;           /* Messages skipped or overwritten */
+} msg_sub_t;
+
+typedef struct msg_bus {
+    atomic_uint32_t tail;       /* Next sequence to claim */
+    atomic_uint32_t gate;       /* Cached lowest blocking cursor */
+    atomic_uint32_t rx_waiters; /* Subscribers waiting for a message */
+    atomic_uint32_t rx_epoch;
+    atomic_uint32_t tx_waiters; /* Publishers waiting for room or a payload */
+    atomic_uint32_t tx_epoch;
+    void *rx_sem;               /* Target port wait objects */
+    void *tx_sem;
+    void *base;                 /* Allocation holding bus, entries and pool */
+    msg_bus_entry_t *entries;
+    uint32_t depth;             /* Power of two, at least 2 */
+    uint32_t mask;
+    uint32_t max_payload;
+    uint8_t *pool;
+    uint32_t pool_count;
+    uint32_t payload_stride;
+    msg_payload_t *free_list;
+    msg_sub_t subs[MSG_BUS_MAX_SUBS];
+} msg_bus_t;
+
+msg_bus_t *msg_bus_create(uint32_t depth, uint32_t max_payload, uint32_t pool_count);
+void msg_bus_delete(msg_bus_t *bus);
+void msg_bus_set_default(msg_bus_t *bus);
+
+msg_sub_t *msg_bus_subscribe(msg_bus_t *bus, msg_sub_policy_t policy);
+void msg_bus_unsubscribe(msg_sub_t *sub);
+
+/* Zero-copy publish: fill payload->data, then publish. Publishing
+ * consumes the caller's reference, also when it fails; msg->data is
+ * ignored. pool_count must exceed depth; 0 sizes the pool for a full
+ * ring plus two payloads in hand per subscriber. */
+msg_payload_t *msg_bus_alloc(msg_bus_t *bus, uint32_t timeout);
+int msg_bus_publish(msg_bus_t *bus, const message_t *msg, msg_payload_t *payload,
+                    uint32_t timeout);
+int msg_bus_receive(msg_sub_t *sub, message_t *msg, msg_payload_t **payload,
+                    uint32_t timeout);
+
+void msg_payload_get(msg_payload_t *payload);
+void msg_payload_put(msg_payload_t *payload);
 
 #endif /* IPC_H */
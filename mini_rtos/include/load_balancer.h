@@ -15,6 +15,31 @@ typedef enum {
     LB_POLICY_HYBRID           // Combination of multiple policies
 } lb_policy_t;
 
+#define LB_MAX_CORES 32
+
+/* Topology levels, innermost first */
+typedef enum {
+    LB_LEVEL_SMT,               // Hardware threads of one physical core
+    LB_LEVEL_LLC,               // Cores sharing a last-level cache/cluster
+    LB_LEVEL_PACKAGE,           // Cores in one package/NUMA node
+    LB_LEVEL_SYSTEM,            // All cores
+    LB_NUM_LEVELS
+} lb_level_t;
+
+/* Topology description: cores with equal ids share that level */
+typedef struct {
+    uint32_t num_cores;
+    uint8_t core_id[LB_MAX_CORES];      // Physical core, shared by SMT siblings
+    uint8_t llc_id[LB_MAX_CORES];
+    uint8_t package_id[LB_MAX_CORES];
+} lb_topology_t;
+
+/* Per-level balancing parameters */
+typedef struct {
+    uint32_t imbalance_threshold;   // Load score gap between groups
+    uint32_t interval_ms;           // Minimum time between balance passes
+} lb_level_config_t;
+
 /* Core load metrics */
 typedef struct {
     atomic_uint32_t cpu_usage;          // CPU utilization percentage
@@ -25,6 +50,18 @@ typedef struct {
     atomic_uint32_t power_consumption;  // Power usage metric
 } core_metrics_t;
 
+/* Consistent point-in-time copy of one core's metrics */
+typedef struct {
+    uint32_t cpu_usage;
+    uint32_t task_count;
+    uint32_t memory_pressure;
+    uint32_t cache_misses;
+    uint32_t temperature;
+    uint32_t power_consumption;
+    uint32_t load_avg;          // Decayed load score, projected to now
+    uint32_t load_sample;       // Instantaneous score at the last metrics update
+} lb_core_snapshot_t;
+
 /* Task requirements */
 typedef struct {
     uint32_t priority;           // Task priority level
@@ -43,6 +80,8 @@ typedef struct {
     atomic_uint64_t policy_switches;      // Number of policy switches
     atomic_uint64_t thermal_throttling;   // Thermal throttling events
     atomic_uint64_t deadline_misses;      // Missed deadlines
+    atomic_uint64_t memory_rebalances;    // Completed memory-pressure rebalances
+    atomic_uint64_t dropped_updates;      // Async metric updates not queued
 } lb_stats_t;
 
 /* Load balancer configuration */
@@ -58,9 +97,26 @@ typedef struct {
 /* Initialize the load balancer */
 bool lb_init(lb_config_t *config);
 
+/* Tear down so lb_init() can run again */
+void lb_shutdown(void);
+
 /* Update core metrics */
 void lb_update_metrics(uint32_t core_id, core_metrics_t *metrics);
 
+/* Read one core's metrics without locking */
+void lb_read_core_metrics(uint32_t core_id, lb_core_snapshot_t *snap);
+
+/* Feed a task's utilisation (0-100) into its decayed load */
+void lb_update_task_load(uint32_t task_id, uint32_t core_id, uint32_t util);
+
+/* Decayed load of a tracked task, 0 if unknown */
+uint32_t lb_get_task_load(uint32_t task_id);
+
+/* Stop tracking a task that has exited. The table is fixed-size and
+ * tasks beyond it go untracked, so call this on every task exit.
+ */
+void lb_untrack_task(uint32_t task_id);
+
 /* Balance a new task */
 uint32_t lb_balance_task(task_requirements_t *task);
 
@@ -76,6 +132,15 @@ void lb_adjust_policy(lb_policy_t new_policy);
 /* Check system balance */
 bool lb_check_balance(void);
 
+/* Describe the core topology; sets the active core count */
+bool lb_set_topology(const lb_topology_t *topo);
+
+/* Override balancing parameters for one level */
+void lb_set_level_config(lb_level_t level, const lb_level_config_t *cfg);
+
+/* Hierarchical balance pass, innermost domains first; returns tasks moved */
+uint32_t lb_rebalance(void);
+
 /* Thermal management */
 void lb_handle_thermal_event(uint32_t core_id, uint32_t temperature);
 
@@ -85,6 +150,7 @@ void lb_handle_memory_pressure(uint32_t core_id, uint32_t pressure);
 /* Asynchronous operations */
 bool lb_migrate_task_async(uint32_t task_id, uint32_t src_core, uint32_t dst_core);
 void lb_update_metrics_async(uint32_t core_id, core_metrics_t* metrics);
+uint32_t lb_update_metrics_batch_async(const uint32_t* core_ids, core_metrics_t* metrics, uint32_t count);
 void lb_adjust_policy_async(lb_policy_t new_policy, bool force_update);
 void lb_handle_thermal_event_async(uint32_t core_id, uint32_t temperature, bool emergency);
 void lb_handle_memory_pressure_async(uint32_t core_id, uint32_t pressure, bool force_rebalance);
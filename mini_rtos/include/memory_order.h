@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /* Memory Ordering Models */
 typedef enum {
@@ -83,6 +84,7 @@ bool atomic_compare_exchange_strong_explicit_ptr(atomic_ptr_t *obj, void **expec
 
 /* Atomic Arithmetic Operations */
 uint32_t atomic_fetch_add_explicit_u32(atomic_uint32_t *obj, uint32_t value, memory_order_t order);
+uint64_t atomic_fetch_add_explicit_u64(atomic_uint64_t *obj, uint64_t value, memory_order_t order);
 uint32_t atomic_fetch_sub_explicit_u32(atomic_uint32_t *obj, uint32_t value, memory_order_t order);
 uint32_t atomic_fetch_and_explicit_u32(atomic_uint32_t *obj, uint32_t value, memory_order_t order);
 uint32_t atomic_fetch_or_explicit_u32(atomic_uint32_t *obj, uint32_t value, memory_order_t order);
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "hashtable.h"
+#include "memory_order.h"
 
 /* Protocol Types */
 typedef enum {
@@ -16,6 +17,8 @@ typedef enum {
     PROTO_CUSTOM
 } protocol_type_t;
 
+#define PROTO_MAX_TYPES (PROTO_CUSTOM + 1)
+
 /* Protocol States */
 typedef enum {
     PROTO_STATE_IDLE = 0,
@@ -24,13 +27,55 @@ typedef enum {
     PROTO_STATE_TIMEOUT
 } protocol_state_t;
 
-/* Protocol Frame Structure */
+/* Shared Payload Buffer
+ *
+ * Refcounted storage that frame segments point into instead of copying.
+ * The last proto_buf_put() calls release to dispose of data (or frees it
+ * when release is NULL), then frees the proto_buf_t itself; release must
+ * not free buf.
+ */
+typedef struct proto_buf {
+    uint8_t *data;
+    uint32_t size;
+    atomic_uint32_t refcount;
+    void (*release)(struct proto_buf *buf);
+    void *context;
+} proto_buf_t;
+
+/* Frame Segment: a byte range of a shared buffer */
+typedef struct proto_seg {
+    proto_buf_t *buf;
+    uint32_t offset;
+    uint32_t length;
+    struct proto_seg *next;
+} proto_seg_t;
+
+/* Gather Element */
+typedef struct {
+    const uint8_t *base;
+    uint32_t length;
+} proto_iovec_t;
+
+#define PROTO_MAX_IOV 16    /* Gather elements proto_send() builds on the stack */
+
+/* Protocol Frame Structure
+ *
+ * The wire image is data[0..length) followed by the chained segments.
+ * data sits inside buffer with headroom in front of it, so lower layers
+ * can prepend headers with proto_frame_push() without moving the payload.
+ */
 typedef struct {
     uint8_t *data;
     uint32_t length;
-    uint32_t max_size;
+    uint32_t max_size;      /* Room from data to the end of buffer */
     uint32_t position;
     uint32_t checksum;
+    uint8_t *buffer;        /* Allocation holding data */
+    uint32_t headroom;      /* Reserved headroom, restored by reset */
+    proto_seg_t *segs;
+    proto_seg_t *segs_tail;
+    uint32_t seg_count;
+    uint32_t seg_length;    /* Bytes in segs */
 } proto_frame_t;
 
 /* Protocol Handler Structure */
@@ -45,8 +90,66 @@ typedef struct {
     bool (*receive)(proto_frame_t *frame);
     void (*error_handler)(uint32_t error_code);
     void *config;
+    /* Optional: send the wire image as a gather list without linearizing */
+    bool (*send_gather)(proto_frame_t *frame, const proto_iovec_t *iov, uint32_t iov_count);
+    /* Optional: send several frames, returning how many from the front
+     * were accepted. Sees chained frames only if send_gather is set. */
+    uint32_t (*send_batch)(proto_frame_t **frames, uint32_t count);
+    /* Optional: fill up to max frames, returning how many were filled */
+    uint32_t (*receive_burst)(proto_frame_t **frames, uint32_t max);
 } proto_handler_t;
 
+/* Transmit Queues
+ *
+ * proto_send_async() queues the frame on its protocol's TX queue and
+ * returns; the frame must stay valid until its callback runs. proto_send()
+ * turns the frame's linear part into a shared segment and queues a frame
+ * referencing it, so the caller may reset and reuse its frame at once.
+ * proto_send() reports only whether the frame was queued; a later
+ * transmit failure shows up only in frames_failed.
+ * Frames go to the handler up to PROTO_TX_BATCH at a time. When the
+ * handler rejects one, it is retried from a timer after
+ * PROTO_TX_BACKOFF_MIN_MS, doubling per attempt up to timeout_ms
+ * (PROTO_TX_BACKOFF_MAX_MS if 0). After max_retries the handler enters
+ * PROTO_STATE_ERROR and every queued frame completes unsuccessfully,
+ * as they also do when the protocol is unregistered.
+ */
+#define PROTO_TXQ_DEPTH          32     /* Power of two */
+#define PROTO_TX_BATCH           8
+#define PROTO_TX_BACKOFF_MIN_MS  1
+#define PROTO_TX_BACKOFF_MAX_MS  1000
+
+typedef void (*proto_tx_callback_t)(proto_frame_t *frame, bool success, void *context);
+
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t frames_failed;
+    uint32_t batches;       /* Handler calls that took more than one frame */
+    uint32_t retries;       /* Rejections that scheduled a retry or failed */
+    uint32_t queue_full;    /* Sends refused because the queue was full */
+} proto_tx_stats_t;
+
+/* Burst Receive
+ *
+ * proto_receive_burst() takes caller-provided empty frames, has the
+ * handler fill up to max of them in one call (or loops receive() for
+ * handlers without receive_burst), and validates them in one pass. Valid
+ * frames are moved to the front of the array, in arrival order, and
+ * handed to the protocol's RX handler as one vector; rejected frames end
+ * up behind them so the caller can reuse every frame it passed in.
+ */
+#define PROTO_RX_BURST_MAX 32
+
+typedef void (*proto_rx_handler_t)(protocol_type_t type, proto_frame_t **frames,
+                                   uint32_t count, void *context);
+
+typedef struct {
+    uint32_t frames_received;
+    uint32_t checksum_errors;
+    uint32_t bursts;        /* Calls that returned at least one frame */
+    uint32_t empty_polls;   /* Calls that found nothing */
+} proto_rx_stats_t;
+
 /* Protocol Manager Structure */
 typedef struct {
     hashtable_t *handlers;
@@ -71,7 +174,15 @@ bool proto_register(protocol_type_t type, proto_handler_t *handler);
 bool proto_unregister(protocol_type_t type);
 proto_handler_t *proto_get_handler(protocol_type_t type);
 bool proto_send(protocol_type_t type, proto_frame_t *frame);
+bool proto_send_async(protocol_type_t type, proto_frame_t *frame,
+                      proto_tx_callback_t callback, void *context);
+void proto_tx_kick(protocol_type_t type);
+uint32_t proto_tx_pending(protocol_type_t type);
+bool proto_tx_get_stats(protocol_type_t type, proto_tx_stats_t *stats);
 bool proto_receive(protocol_type_t type, proto_frame_t *frame);
+uint32_t proto_receive_burst(protocol_type_t type, proto_frame_t **frames, uint32_t max);
+bool proto_set_rx_handler(protocol_type_t type, proto_rx_handler_t handler, void *context);
+bool proto_rx_get_stats(protocol_type_t type, proto_rx_stats_t *stats);
 void proto_process_errors(protocol_type_t type, uint32_t error_code);
 
 /* Frame Management Functions */
@@ -82,4 +193,21 @@ bool proto_frame_append(proto_frame_t *frame, const uint8_t *data, uint32_t leng
 uint32_t proto_frame_calculate_checksum(const proto_frame_t *frame);
 bool proto_frame_validate(const proto_frame_t *frame);
 
+/* Scatter-Gather Frames */
+proto_frame_t *proto_frame_create_headroom(uint32_t max_size, uint32_t headroom);
+bool proto_frame_push(proto_frame_t *frame, const uint8_t *header, uint32_t length);
+bool proto_frame_append_buf(proto_frame_t *frame, proto_buf_t *buf,
+                            uint32_t offset, uint32_t length);
+proto_frame_t *proto_frame_clone(const proto_frame_t *frame);
+bool proto_frame_linearize(proto_frame_t *frame);
+uint32_t proto_frame_total_length(const proto_frame_t *frame);
+uint32_t proto_frame_to_iovec(const proto_frame_t *frame, proto_iovec_t *iov, uint32_t max_iov);
+
+/* Shared Buffers */
+proto_buf_t *proto_buf_alloc(uint32_t size);
+proto_buf_t *proto_buf_wrap(uint8_t *data, uint32_t size,
+                            void (*release)(proto_buf_t *buf), void *context);
+void proto_buf_get(proto_buf_t *buf);
+void proto_buf_put(proto_buf_t *buf);
+
 #endif /* MINI_RTOS_PROTOCOL_H */
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "rtos_types.h"
+#include "memory_order.h"
 
 /* Timer Types */
 typedef enum {
@@ -19,7 +20,8 @@ typedef enum {
     TIMER_ENQUEUED,
     TIMER_RUNNING,
     TIMER_EXPIRED,
-    TIMER_CANCELLED
+    TIMER_CANCELLED,        /* Cancelled while parked in a remote inbox */
+    TIMER_REMOTE_PENDING    /* Posted to another CPU's inbox, not yet queued */
 } timer_state_t;
 
 /* Timer Flags */
@@ -30,12 +32,54 @@ typedef enum {
 #define TIMER_FLAG_PINNED        (1 << 4)  /* Pinned to specific CPU */
 #define TIMER_FLAG_HIGH_RES      (1 << 5)  /* High resolution timer */
 
+/* Timer Slack
+ *
+ * A timer may fire anywhere in [expires, expires + slack]. The wheel files
+ * it at the most power-of-two aligned tick in that window, so timers whose
+ * windows overlap land in the same slot and expire as one event.
+ * TIMER_SLACK_DEFAULT allows 1/2^TIMER_DEFAULT_SLACK_SHIFT of the time
+ * remaining (~0.4%); hard-deadline and high resolution timers get none.
+ * High resolution timers are queued on their hard expiry and also run
+ * early whenever another timer's event fires inside their window.
+ */
+#define TIMER_SLACK_DEFAULT       UINT32_MAX
+#define TIMER_DEFAULT_SLACK_SHIFT 8
+
+/* Timers carrying any of these flags stay on their base when its CPU idles */
+#define TIMER_FLAG_NO_IDLE_MIGRATE (TIMER_FLAG_NO_MIGRATE | TIMER_FLAG_PINNED | \
+                                    TIMER_FLAG_DEFERRABLE)
+
 /* Timer Callback Function */
 typedef void (*timer_callback_t)(void *arg);
 
+/* Latency Histograms
+ *
+ * Log2-bucketed, in nanoseconds: bucket 0 counts zero, bucket b counts
+ * values in [2^(b-1), 2^b), and the last bucket absorbs everything above.
+ * Counters have a single writer (the CPU running the callbacks). Reset
+ * doesn't touch them; it records a mark that readers subtract, so no
+ * lock is needed on either side.
+ */
+#define TIMER_HIST_BUCKETS   32
+#define TIMER_TICK_NS        (1000000000UL / SYSTICK_HZ)
+
+typedef struct {
+    uint32_t duration[TIMER_HIST_BUCKETS];       /* Callback run time */
+    uint32_t lateness[TIMER_HIST_BUCKETS];       /* Fire time minus expiry */
+    uint32_t duration_mark[TIMER_HIST_BUCKETS];  /* Counts at last reset */
+    uint32_t lateness_mark[TIMER_HIST_BUCKETS];
+} timer_hist_t;
+
+typedef struct {
+    uint32_t duration[TIMER_HIST_BUCKETS];
+    uint32_t lateness[TIMER_HIST_BUCKETS];
+} timer_latency_hist_t;
+
 /* Timer Structure */
 typedef struct timer {
     uint32_t expires;           /* Expiration time in ticks */
+    uint32_t soft_expires;      /* Requested expiry before slack is applied */
+    uint32_t slack;             /* Allowed lateness in ticks */
     uint32_t period;            /* Period for periodic timers */
     timer_callback_t callback;  /* Callback function */
     void *callback_arg;         /* Argument to callback */
@@ -46,27 +90,77 @@ typedef struct timer {
     uint8_t priority;          /* Timer priority */
     struct timer *next;        /* Next timer in wheel */
     struct timer *prev;        /* Previous timer in wheel */
+    struct timer *inbox_next;  /* Next timer in a remote base's inbox */
+    struct timer *expired_next;/* Next timer in a base's expiry batch */
+    uint8_t level;             /* Wheel level while enqueued */
+    uint8_t slot;              /* Wheel slot while enqueued */
+    uint64_t expires_ns;       /* High-res hard expiry (soft + slack) */
+    uint64_t soft_expires_ns;  /* High-res requested expiry */
+    uint64_t slack_ns;         /* High-res allowed lateness */
+    uint32_t heap_index;       /* Position in the hrtimer heap */
+    timer_hist_t *hist;        /* Optional per-timer histograms */
 } timer_t;
 
-/* Timer Wheel Structure */
-#define TIMER_WHEEL_SIZE     8
+/* High Resolution Timer Queue
+ *
+ * Per-CPU 4-ary min-heap ordered on expires_ns. Arm and cancel are
+ * O(log n); the next expiry is always heap[0]. The heap array starts at
+ * HRTIMER_HEAP_INITIAL entries and doubles when full; the allocation is
+ * made with the base lock dropped, so hrtimer_start() only fails when
+ * memory runs out.
+ */
+#define HRTIMER_HEAP_INITIAL 32
+#define HRTIMER_HEAP_ARITY   4
+#define HRTIMER_NOT_QUEUED   UINT32_MAX
+
+typedef struct {
+    timer_t **heap;
+    uint32_t capacity;
+    uint32_t count;
+    uint64_t max_slack_ns;     /* Largest slack queued since the heap emptied */
+    uint64_t next_event_ns;    /* Expiry last handed to the platform */
+} hrtimer_queue_t;
+
+/* Called with the new earliest expiry whenever it changes, so the
+ * platform can reprogram its one-shot event timer */
+typedef void (*hrtimer_program_t)(uint8_t cpu, uint64_t expires_ns);
+
+/* Timer Wheel Structure
+ *
+ * Level 0 holds timers due within the next TIMER_WHEEL_SIZE ticks, one
+ * tick per slot. Each higher level covers TIMER_WHEEL_SIZE times the span
+ * of the one below and is cascaded down when the level below wraps.
+ */
+#define TIMER_WHEEL_BITS     5
+#define TIMER_WHEEL_SIZE     (1 << TIMER_WHEEL_BITS)
 #define TIMER_WHEEL_MASK     (TIMER_WHEEL_SIZE - 1)
 #define TIMER_WHEEL_LEVELS   4
+#define TIMER_WHEEL_MAX_DELTA ((1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
 
 typedef struct {
     timer_t *wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
-    uint32_t current_tick;
+    uint32_t pending[TIMER_WHEEL_LEVELS];  /* Occupied-slot bitmap per level */
+    uint32_t current_tick;    /* Next tick to be processed */
     uint32_t resolution;      /* Timer resolution in microseconds */
-    mutex_t *lock;
+    atomic_uint32_t lock;     /* Per-base spinlock, taken with local IRQs off */
 } timer_wheel_t;
 
-/* Timer Base Structure */
+/* Timer Base Structure
+ *
+ * One base per CPU. The owning CPU manipulates its wheel under wheel.lock;
+ * other CPUs arm timers on it by pushing onto the lock-free inbox, which
+ * the owner drains at the start of each tick.
+ */
 typedef struct {
     timer_wheel_t wheel;
+    atomic_ptr_t inbox;        /* Remotely armed timers (LIFO, drained on tick) */
+    hrtimer_queue_t hrq;       /* High resolution timers, under wheel.lock */
+    timer_hist_t hist;         /* Callback latency histograms for this CPU */
     uint32_t next_expiry;
     uint32_t resolution;
     uint8_t cpu;
     uint8_t active;
+    volatile uint8_t idle;     /* CPU is idle, don't post new timers here */
 } timer_base_t;
 
 /* Timer Statistics */
@@ -77,9 +171,11 @@ typedef struct {
     uint32_t overrun_timers;
     uint32_t high_res_timers;
     uint32_t deferrable_timers;
+    uint32_t slack_adjusted;   /* Arms moved later by slack to coalesce */
     uint64_t total_latency;    /* Total callback latency in microseconds */
     uint32_t max_latency;      /* Maximum callback latency */
     uint32_t min_latency;      /* Minimum callback latency */
+    timer_latency_hist_t hist; /* Summed over all timer bases */
 } timer_stats_t;
 
 /* Timer Subsystem Functions */
@@ -96,27 +192,44 @@ int timer_start(timer_t *timer, uint32_t expires, uint32_t period,
                 timer_callback_t callback, void *arg);
 int timer_stop(timer_t *timer);
 int timer_modify(timer_t *timer, uint32_t new_expires);
+int timer_set_slack(timer_t *timer, uint32_t slack_ticks);
 
 /* High Resolution Timer Functions */
 timer_t *hrtimer_create(uint32_t flags);
 int hrtimer_start(timer_t *timer, uint64_t expires_ns,
                   timer_callback_t callback, void *arg);
 int hrtimer_cancel(timer_t *timer);
+int hrtimer_set_slack(timer_t *timer, uint64_t slack_ns);
+uint64_t hrtimer_get_next_expiry(uint8_t cpu);
+void hrtimer_run_queues(timer_base_t *base, uint64_t now_ns);
+void hrtimer_interrupt(uint8_t cpu);
+void hrtimer_set_program_handler(hrtimer_program_t program);
 
-/* Timer Wheel Management */
+/* Timer Wheel Management (caller holds wheel->lock) */
 void timer_wheel_add(timer_wheel_t *wheel, timer_t *timer);
 void timer_wheel_remove(timer_wheel_t *wheel, timer_t *timer);
 void timer_wheel_advance(timer_wheel_t *wheel);
+uint32_t timer_wheel_next_expiry(timer_wheel_t *wheel);
 timer_t *timer_wheel_get_expired(timer_wheel_t *wheel);
 
 /* Timer Base Management */
 void timer_base_advance(timer_base_t *base);
 uint32_t timer_base_get_next_expiry(timer_base_t *base);
 void timer_base_process_events(timer_base_t *base);
+timer_base_t *timer_get_base(uint8_t cpu);
+
+/* Timer Migration */
+uint32_t timer_migrate(uint8_t from_cpu, uint8_t to_cpu);
+void timer_cpu_idle_enter(uint8_t cpu);
+void timer_cpu_idle_exit(uint8_t cpu);
 
 /* Timer Statistics and Debugging */
 void get_timer_stats(timer_stats_t *stats);
 void reset_timer_stats(void);
+int get_timer_base_stats(uint8_t cpu, timer_latency_hist_t *hist);
+int timer_enable_histogram(timer_t *timer, timer_hist_t *hist);
+void timer_get_histogram(const timer_hist_t *hist, timer_latency_hist_t *out);
+void timer_reset_histogram(timer_hist_t *hist);
 void dump_timer_info(timer_t *timer);
 void dump_timer_wheel(timer_wheel_t *wheel);
 
@@ -125,5 +238,6 @@ uint32_t timer_get_resolution(void);
 uint64_t timer_get_time_ns(void);
 void timer_delay_us(uint32_t microseconds);
 uint32_t timer_elapsed(uint32_t start_tick);
+uint32_t timer_round_ticks(uint32_t ticks, uint32_t granularity);
 
 #endif /* TIMER_H */
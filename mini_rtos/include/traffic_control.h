@@ -20,7 +20,7 @@ typedef enum {
     TC_POLICY_STRICT,       /* Strict priority scheduling */
     TC_POLICY_WRR,         /* Weighted Round Robin */
     TC_POLICY_DRR,         /* Deficit Round Robin */
-    TC_POLICY_FAIR_QUEUE   /* Fair Queuing */
+    TC_POLICY_FAIR_QUEUE   /* Fair Queuing (WF2Q+), weighted by CPU share */
 } tc_policy_t;
 
 /* Bandwidth control parameters */
@@ -49,7 +49,7 @@ typedef struct {
     uint32_t packets_received;
     uint32_t drops;
     uint32_t overruns;
-    uint32_t latency_sum;
+    uint64_t latency_sum;      /* Sojourn time, microseconds */
     uint32_t latency_samples;
 } tc_stats_t;
 
@@ -61,6 +61,67 @@ typedef struct {
     uint32_t last_update;      /* Last token update timestamp */
 } tc_shaper_t;
 
+/* Active queue management
+ *
+ * Tasks are timestamped on enqueue and CoDel runs on dequeue: once every
+ * task leaving a class has waited longer than bandwidth.latency for a full
+ * interval, the class drops (or marks) tasks at a rate that grows with the
+ * square root of the drop count until the sojourn time falls back under
+ * target. Sojourn times are kept in a log2 histogram in milliseconds:
+ * bucket 0 counts zero, bucket b counts [2^(b-1), 2^b).
+ */
+#define TC_AQM_HIST_BUCKETS 16
+#define TC_AQM_DEFAULT_INTERVAL 100     /* ms */
+#define TC_TASK_FLAG_CE 0x00800000      /* Marked by AQM: congestion experienced */
+
+typedef enum {
+    TC_AQM_NONE,           /* Timestamp and measure only */
+    TC_AQM_DROP,           /* Drop tasks, handing them to the drop handler */
+    TC_AQM_MARK            /* Set TC_TASK_FLAG_CE and still run the task */
+} tc_aqm_mode_t;
+
+typedef struct {
+    uint32_t drops;          /* Tasks dropped on dequeue */
+    uint32_t marks;          /* Tasks marked TC_TASK_FLAG_CE */
+    uint32_t episodes;       /* Entries into the dropping state */
+    uint32_t sojourn_p50;    /* Percentiles, ms, upper bound of the bucket */
+    uint32_t sojourn_p90;
+    uint32_t sojourn_p99;
+    uint32_t sojourn_max;    /* Exact, ms */
+    uint32_t hist[TC_AQM_HIST_BUCKETS];
+} tc_aqm_stats_t;
+
+typedef void (*tc_drop_handler_t)(tcb_t *task, traffic_class_t class);
+
+/* Hierarchical token bucket
+ *
+ * Every traffic class is a leaf in a tree of token buckets. A class is
+ * guaranteed bandwidth.min_rate, may borrow unused bandwidth from its
+ * ancestors up to bandwidth.max_rate, and classes that have to borrow
+ * are served in priority order. With the default configuration every
+ * class borrows from an unlimited root, which is plain strict priority.
+ * Rates are in dequeue cost units per second (see tc_dequeue_task()).
+ */
+#define TC_HTB_MAX_NODES 32        /* Root, one leaf per class, interior nodes */
+#define TC_HTB_MAX_LEVELS 8
+#define TC_HTB_PRIOS 8
+#define TC_HTB_ROOT 0
+#define TC_HTB_CLASS_NODE(class) ((int)(class) + 1)
+
+typedef enum {
+    TC_HTB_CAN_SEND,       /* Within its own rate */
+    TC_HTB_MAY_BORROW,     /* Over rate, under ceiling */
+    TC_HTB_CANT_SEND       /* Over ceiling */
+} tc_htb_mode_t;
+
+typedef struct {
+    tc_htb_mode_t mode;
+    int32_t tokens;        /* Rate tokens, negative when in debt */
+    int32_t ctokens;       /* Ceiling tokens */
+    uint32_t lends;        /* Dequeues served from this node's own rate */
+    uint32_t borrows;      /* Dequeues served from an ancestor's rate */
+} tc_htb_stats_t;
+
 /* Traffic control interface */
 void tc_init(void);
 void tc_shutdown(void);
@@ -78,7 +139,23 @@ traffic_class_t tc_get_task_class(tcb_t *task);
 int tc_set_bandwidth(traffic_class_t class, tc_bandwidth_t *bandwidth);
 int tc_get_bandwidth(traffic_class_t class, tc_bandwidth_t *bandwidth);
 
-/* Traffic shaping */
+/* Traffic shaping
+ *
+ * Class shapers are per-CPU: each CPU checks a local token cache and only
+ * touches the class's global bucket to pull another chunk of
+ * burst_size / (MAX_CPU * TC_SHAPER_CHUNK_DIV) tokens. Tokens move between
+ * the bucket and the caches but are never created, so:
+ *  - the long-run rate never exceeds max_rate;
+ *  - a burst can reach burst_size plus what the caches hold, at most
+ *    burst_size * (1 + 1 / TC_SHAPER_CHUNK_DIV);
+ *  - a check can fail while up to the same amount sits in other CPUs'
+ *    caches, and refills truncate to whole tokens, at most one lost per
+ *    refill.
+ * tc_update_tokens() refills a caller-owned tc_shaper_t and is not
+ * safe for concurrent use.
+ */
+#define TC_SHAPER_CHUNK_DIV 4
+
 bool tc_check_rate(traffic_class_t class, uint32_t size);
 void tc_update_tokens(tc_shaper_t *shaper);
 int tc_shape_traffic(traffic_class_t class, uint32_t size);
@@ -89,10 +166,26 @@ void tc_reset_stats(traffic_class_t class);
 float tc_get_average_latency(traffic_class_t class);
 uint32_t tc_get_drop_rate(traffic_class_t class);
 
-/* Policy management */
+/* Active queue management; interval_ms 0 selects TC_AQM_DEFAULT_INTERVAL */
+int tc_set_aqm(traffic_class_t class, tc_aqm_mode_t mode, uint32_t interval_ms);
+int tc_get_aqm_stats(traffic_class_t class, tc_aqm_stats_t *stats);
+void tc_set_drop_handler(tc_drop_handler_t handler);
+
+/* Policy management
+ *
+ * Classes set to TC_POLICY_FAIR_QUEUE leave the HTB tree and are served by
+ * WF2Q+ whenever no HTB class can send, splitting that time in proportion
+ * to tc_set_cpu_share(). Other policies are scheduled by the HTB tree.
+ */
 int tc_set_policy(traffic_class_t class, tc_policy_t policy);
 tc_policy_t tc_get_policy(traffic_class_t class);
 
+/* Class hierarchy */
+int tc_htb_create_node(int parent, tc_bandwidth_t *bandwidth);
+int tc_htb_delete_node(int node);
+int tc_htb_attach_class(traffic_class_t class, int parent);
+int tc_htb_get_stats(int node, tc_htb_stats_t *stats);
+
 /* Queue management */
 int tc_enqueue_task(tcb_t *task);
 tcb_t *tc_dequeue_task(void);
@@ -1,39 +1,258 @@
 #include "async_ops.h"
 #include "memory_order.h"
+#include "timer.h"
 #include <string.h>
 #include <stdlib.h>
 
 #define MAX_WORKERS 16
 #define MAX_PENDING_OPS 1024
+#define MAX_CONTINUATIONS 1024
+#define ASYNC_SPIN_ROUNDS 64        /* Failed steal rounds before parking */
+#define ASYNC_PARK_TIMEOUT_MS 10    /* Upper bound on a park, as a safety net */
 
 /* Worker Thread State */
 typedef struct {
     atomic_bool active;
     void* thread;
-    async_queue_t queue;
+    async_deque_t deques[ASYNC_LANES]; /* Owner-local work per lane, stealable */
+    atomic_ptr_t inbox;             /* Submissions from non-worker threads */
+    atomic_uint32_t inbox_count;
+    atomic_uint32_t parked;         /* Sleeping on park_sem */
+    void* park_sem;
+    uint32_t rng;                   /* Victim selection state */
 } worker_state_t;
 
+/* Worker running on this thread, NULL for external submitters */
+static __thread worker_state_t* current_worker;
+
+/* Per-thread semaphore for async_future_wait(), created on first use */
+static __thread void* wait_sem;
+
+/* Waiter node left attached by a timed-out async_future_wait(), reused
+ * if the thread waits on the same op again
+ */
+static __thread async_cont_t* wait_cont;
+static __thread async_future_t wait_future;
+
+/* Marks a completed op's continuation list */
+#define CONT_CLOSED ((void*)1)
+
+/* Per-Type Registry Entry */
+typedef struct {
+    async_handler_t handler;
+    const char* name;
+    atomic_uint64_t submitted;
+    atomic_uint64_t completed;
+    atomic_uint64_t failed;
+    atomic_uint64_t cancelled;
+    atomic_uint64_t queue_ns_total;
+    atomic_uint64_t queue_ns_max;
+    atomic_uint64_t run_ns_total;
+    atomic_uint64_t run_ns_max;
+} async_type_t;
+
 /* Global Async System State */
 static struct {
     atomic_bool initialized;
     atomic_uint32_t next_op_id;
     worker_state_t workers[MAX_WORKERS];
     uint32_t num_workers;
+    async_type_t types[ASYNC_MAX_OP_TYPES];
+    atomic_uint32_t next_type;
     async_op_t* op_pool;
-    atomic_uint32_t op_pool_index;
+    uint32_t* op_next;              /* Free list links */
+    atomic_uint64_t op_free;        /* Tag << 32 | head index */
+    async_cont_t* cont_pool;
+    uint32_t* cont_next;            /* Free list links */
+    atomic_uint64_t cont_free;      /* Tag << 32 | head index */
+    uint8_t* param_blocks;
+    uint32_t* param_next;           /* Free list links */
+    atomic_uint64_t param_free;     /* Tag << 32 | head index */
     void* global_lock;
 } async_state;
 
+/* Chase-Lev deque operations */
+static bool deque_push(async_deque_t* dq, async_op_t* op) {
+    uint32_t b = atomic_load_explicit_u32(&dq->bottom, MEMORY_ORDER_RELAXED);
+    uint32_t t = atomic_load_explicit_u32(&dq->top, MEMORY_ORDER_ACQUIRE);
+    
+    if (b - t >= ASYNC_DEQUE_SIZE) {
+        return false;
+    }
+    
+    dq->slots[b & ASYNC_DEQUE_MASK] = op;
+    memory_fence_release();
+    atomic_store_explicit_u32(&dq->bottom, b + 1, MEMORY_ORDER_RELAXED);
+    return true;
+}
+
+static async_op_t* deque_pop(async_deque_t* dq) {
+    uint32_t b = atomic_load_explicit_u32(&dq->bottom, MEMORY_ORDER_RELAXED) - 1;
+    atomic_store_explicit_u32(&dq->bottom, b, MEMORY_ORDER_RELAXED);
+    memory_fence_full();
+    uint32_t t = atomic_load_explicit_u32(&dq->top, MEMORY_ORDER_RELAXED);
+    
+    if ((int32_t)(b - t) < 0) {
+        // Empty
+        atomic_store_explicit_u32(&dq->bottom, b + 1, MEMORY_ORDER_RELAXED);
+        return NULL;
+    }
+    
+    async_op_t* op = dq->slots[b & ASYNC_DEQUE_MASK];
+    if (b != t) {
+        return op;
+    }
+    
+    // Last element: race thieves for it
+    if (!atomic_compare_exchange_strong_explicit_u32(&dq->top, &t, t + 1,
+            MEMORY_ORDER_SEQ_CST, MEMORY_ORDER_RELAXED)) {
+        op = NULL;
+    }
+    atomic_store_explicit_u32(&dq->bottom, b + 1, MEMORY_ORDER_RELAXED);
+    return op;
+}
+
+static async_op_t* deque_steal(async_deque_t* dq) {
+    uint32_t t = atomic_load_explicit_u32(&dq->top, MEMORY_ORDER_ACQUIRE);
+    memory_fence_full();
+    uint32_t b = atomic_load_explicit_u32(&dq->bottom, MEMORY_ORDER_ACQUIRE);
+    
+    if ((int32_t)(b - t) <= 0) {
+        return NULL;
+    }
+    
+    async_op_t* op = dq->slots[t & ASYNC_DEQUE_MASK];
+    if (!atomic_compare_exchange_strong_explicit_u32(&dq->top, &t, t + 1,
+            MEMORY_ORDER_SEQ_CST, MEMORY_ORDER_RELAXED)) {
+        // Lost to the owner or another thief
+        return NULL;
+    }
+    return op;
+}
+
+static uint32_t deque_size(async_deque_t* dq) {
+    uint32_t b = atomic_load_explicit_u32(&dq->bottom, MEMORY_ORDER_ACQUIRE);
+    uint32_t t = atomic_load_explicit_u32(&dq->top, MEMORY_ORDER_ACQUIRE);
+    return (int32_t)(b - t) > 0 ? b - t : 0;
+}
+
+/* Splice a pre-linked chain onto a worker's MPSC inbox; only the owner
+ * drains it. The chain runs newest (first) to oldest (last).
+ */
+static void inbox_push_chain(worker_state_t* worker, async_op_t* first,
+                             async_op_t* last, uint32_t count) {
+    void* head;
+    
+    do {
+        head = atomic_load_explicit_ptr(&worker->inbox, MEMORY_ORDER_ACQUIRE);
+        atomic_store_explicit_ptr(&last->next, head, MEMORY_ORDER_RELAXED);
+    } while (!atomic_compare_exchange_strong_explicit_ptr(
+                 &worker->inbox, &head, first,
+                 MEMORY_ORDER_RELEASE, MEMORY_ORDER_RELAXED));
+    
+    atomic_fetch_add_explicit_u32(&worker->inbox_count, count, MEMORY_ORDER_RELAXED);
+}
+
+static void inbox_push(worker_state_t* worker, async_op_t* op) {
+    inbox_push_chain(worker, op, op, 1);
+}
+
+/* Move inbox submissions into the owner's lane deques, oldest first */
+static void inbox_drain(worker_state_t* worker) {
+    async_op_t* list = atomic_exchange_explicit_ptr(&worker->inbox, NULL, MEMORY_ORDER_ACQUIRE);
+    async_op_t* fifo = NULL;
+    uint32_t count = 0;
+    
+    while (list) {
+        async_op_t* next = atomic_load_explicit_ptr(&list->next, MEMORY_ORDER_RELAXED);
+        atomic_store_explicit_ptr(&list->next, fifo, MEMORY_ORDER_RELAXED);
+        fifo = list;
+        list = next;
+        count++;
+    }
+    
+    while (fifo) {
+        async_op_t* next = atomic_load_explicit_ptr(&fifo->next, MEMORY_ORDER_RELAXED);
+        if (!deque_push(&worker->deques[fifo->lane], fifo)) {
+            // Lane full: park it back in the inbox for the next drain
+            inbox_push(worker, fifo);
+        }
+        fifo = next;
+    }
+    
+    atomic_fetch_sub_explicit_u32(&worker->inbox_count, count, MEMORY_ORDER_RELAXED);
+}
+
+/* Wake a worker if it is parked */
+static void wake_worker(worker_state_t* worker) {
+    if (atomic_exchange_explicit_u32(&worker->parked, 0, MEMORY_ORDER_ACQ_REL)) {
+        semaphore_post(worker->park_sem);
+    }
+}
+
+/* Wake one parked worker so it can steal newly pushed local work */
+static void wake_idle_worker(worker_state_t* self) {
+    for (uint32_t i = 0; i < async_state.num_workers; i++) {
+        worker_state_t* worker = &async_state.workers[i];
+        if (worker != self &&
+            atomic_load_explicit_u32(&worker->parked, MEMORY_ORDER_ACQUIRE)) {
+            wake_worker(worker);
+            return;
+        }
+    }
+}
+
+/* Try each other worker once per lane, high lane first, starting
+ * from a random victim
+ */
+static async_op_t* steal_work(worker_state_t* self) {
+    uint32_t n = async_state.num_workers;
+    
+    // xorshift32
+    self->rng ^= self->rng << 13;
+    self->rng ^= self->rng >> 17;
+    self->rng ^= self->rng << 5;
+    
+    for (uint32_t lane = 0; lane < ASYNC_LANES; lane++) {
+        for (uint32_t i = 0; i < n; i++) {
+            worker_state_t* victim = &async_state.workers[(self->rng + i) % n];
+            if (victim == self) {
+                continue;
+            }
+            
+            async_op_t* op = deque_steal(&victim->deques[lane]);
+            if (op) {
+                return op;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Worker thread entry */
+static void worker_main(void* arg) {
+    current_worker = (worker_state_t*)arg;
+    async_process_ops();
+}
+
 /* Initialize worker thread */
-static bool init_worker(worker_state_t* worker) {
+static bool init_worker(worker_state_t* worker, uint32_t index) {
     atomic_store_explicit_bool(&worker->active, true, MEMORY_ORDER_RELEASE);
-    worker->queue.head = ATOMIC_VAR_INIT(NULL);
-    worker->queue.tail = ATOMIC_VAR_INIT(NULL);
-    atomic_store_explicit_u32(&worker->queue.count, 0, MEMORY_ORDER_RELEASE);
-    worker->queue.lock = mutex_create();
+    for (uint32_t lane = 0; lane < ASYNC_LANES; lane++) {
+        atomic_store_explicit_u32(&worker->deques[lane].top, 0, MEMORY_ORDER_RELAXED);
+        atomic_store_explicit_u32(&worker->deques[lane].bottom, 0, MEMORY_ORDER_RELAXED);
+    }
+    atomic_store_explicit_ptr(&worker->inbox, NULL, MEMORY_ORDER_RELAXED);
+    atomic_store_explicit_u32(&worker->inbox_count, 0, MEMORY_ORDER_RELAXED);
+    atomic_store_explicit_u32(&worker->parked, 0, MEMORY_ORDER_RELEASE);
+    worker->rng = 2463534242u + index * 0x9E3779B9u;
+    worker->park_sem = semaphore_create(0);
+    if (!worker->park_sem) {
+        return false;
+    }
     
     // Create worker thread
-    worker->thread = thread_create(async_process_ops, NULL);
+    worker->thread = thread_create(worker_main, worker);
     return worker->thread != NULL;
 }
 
@@ -45,111 +264,593 @@ bool async_init(uint32_t num_workers) {
             MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_RELAXED)) {
         return false;
     }
-
+    
     if (num_workers > MAX_WORKERS) {
         num_workers = MAX_WORKERS;
     }
-
+    
     async_state.num_workers = num_workers;
     atomic_store_explicit_u32(&async_state.next_op_id, 1, MEMORY_ORDER_RELEASE);
-    atomic_store_explicit_u32(&async_state.op_pool_index, 0, MEMORY_ORDER_RELEASE);
     
-    // Initialize operation pool
+    // Initialize operation pool, all ops free
     async_state.op_pool = calloc(MAX_PENDING_OPS, sizeof(async_op_t));
-    if (!async_state.op_pool) {
+    async_state.op_next = malloc(MAX_PENDING_OPS * sizeof(uint32_t));
+    if (!async_state.op_pool || !async_state.op_next) {
+        free(async_state.op_pool);
+        free(async_state.op_next);
         return false;
     }
-
+    for (uint32_t i = 0; i < MAX_PENDING_OPS; i++) {
+        async_state.op_next[i] = (i + 1 < MAX_PENDING_OPS) ? i + 1 : ASYNC_NO_PARAM_BLOCK;
+    }
+    atomic_store_explicit_u64(&async_state.op_free, 0, MEMORY_ORDER_RELEASE);
+    
+    // Initialize continuation pool, all nodes free
+    async_state.cont_pool = calloc(MAX_CONTINUATIONS, sizeof(async_cont_t));
+    async_state.cont_next = malloc(MAX_CONTINUATIONS * sizeof(uint32_t));
+    if (!async_state.cont_pool || !async_state.cont_next) {
+        free(async_state.cont_pool);
+        free(async_state.cont_next);
+        free(async_state.op_pool);
+        free(async_state.op_next);
+        return false;
+    }
+    for (uint32_t i = 0; i < MAX_CONTINUATIONS; i++) {
+        async_state.cont_next[i] = (i + 1 < MAX_CONTINUATIONS) ? i + 1 : ASYNC_NO_PARAM_BLOCK;
+    }
+    atomic_store_explicit_u64(&async_state.cont_free, 0, MEMORY_ORDER_RELEASE);
+    
+    // Initialize parameter block pool, all blocks free
+    async_state.param_blocks = malloc(ASYNC_PARAM_BLOCKS * ASYNC_PARAM_BLOCK_SIZE);
+    async_state.param_next = malloc(ASYNC_PARAM_BLOCKS * sizeof(uint32_t));
+    if (!async_state.param_blocks || !async_state.param_next) {
+        free(async_state.param_blocks);
+        free(async_state.param_next);
+        free(async_state.cont_pool);
+        free(async_state.cont_next);
+        free(async_state.op_pool);
+        free(async_state.op_next);
+        return false;
+    }
+    for (uint32_t i = 0; i < ASYNC_PARAM_BLOCKS; i++) {
+        async_state.param_next[i] = (i + 1 < ASYNC_PARAM_BLOCKS) ? i + 1 : ASYNC_NO_PARAM_BLOCK;
+    }
+    atomic_store_explicit_u64(&async_state.param_free, 0, MEMORY_ORDER_RELEASE);
+    
     async_state.global_lock = mutex_create();
     if (!async_state.global_lock) {
+        free(async_state.param_blocks);
+        free(async_state.param_next);
+        free(async_state.cont_pool);
+        free(async_state.cont_next);
         free(async_state.op_pool);
+        free(async_state.op_next);
         return false;
     }
-
+    
     // Initialize workers
     for (uint32_t i = 0; i < num_workers; i++) {
-        if (!init_worker(&async_state.workers[i])) {
+        if (!init_worker(&async_state.workers[i], i)) {
             async_shutdown();
             return false;
         }
     }
+    
+    return true;
+}
+
+/* Register a handler for a fixed type id; may precede async_init() */
+bool async_register_handler(async_op_type_t type, const char* name, async_handler_t handler) {
+    if ((uint32_t)type >= ASYNC_MAX_OP_TYPES || type == ASYNC_OP_PROMISE || !handler) {
+        return false;
+    }
+    
+    async_state.types[type].name = name;
+    async_state.types[type].handler = handler;
+    return true;
+}
+
+/* Allocate a type id for a new subsystem */
+int32_t async_register_type(const char* name, async_handler_t handler) {
+    uint32_t type = ASYNC_OP_DYNAMIC_BASE +
+        atomic_fetch_add_explicit_u32(&async_state.next_type, 1, MEMORY_ORDER_ACQ_REL);
+    
+    if (type >= ASYNC_MAX_OP_TYPES || !async_register_handler(type, name, handler)) {
+        return -1;
+    }
+    return (int32_t)type;
+}
 
+/* Snapshot per-type statistics */
+bool async_get_type_stats(async_op_type_t type, async_type_stats_t* stats) {
+    if ((uint32_t)type >= ASYNC_MAX_OP_TYPES || !stats) {
+        return false;
+    }
+    
+    async_type_t* t = &async_state.types[type];
+    stats->submitted = atomic_load_explicit_u64(&t->submitted, MEMORY_ORDER_RELAXED);
+    stats->completed = atomic_load_explicit_u64(&t->completed, MEMORY_ORDER_RELAXED);
+    stats->failed = atomic_load_explicit_u64(&t->failed, MEMORY_ORDER_RELAXED);
+    stats->cancelled = atomic_load_explicit_u64(&t->cancelled, MEMORY_ORDER_RELAXED);
+    stats->queue_ns_total = atomic_load_explicit_u64(&t->queue_ns_total, MEMORY_ORDER_RELAXED);
+    stats->queue_ns_max = atomic_load_explicit_u64(&t->queue_ns_max, MEMORY_ORDER_RELAXED);
+    stats->run_ns_total = atomic_load_explicit_u64(&t->run_ns_total, MEMORY_ORDER_RELAXED);
+    stats->run_ns_max = atomic_load_explicit_u64(&t->run_ns_max, MEMORY_ORDER_RELAXED);
     return true;
 }
 
-/* Get next available operation from pool */
+/* Index free lists shared by the op, continuation and parameter block
+ * pools. The tag in the high word of the head defeats ABA.
+ */
+static uint32_t free_list_pop(atomic_uint64_t* free_head, uint32_t* links) {
+    uint64_t head = atomic_load_explicit_u64(free_head, MEMORY_ORDER_ACQUIRE);
+    
+    for (;;) {
+        uint32_t index = (uint32_t)head;
+        if (index == ASYNC_NO_PARAM_BLOCK) {
+            return ASYNC_NO_PARAM_BLOCK;
+        }
+        
+        uint64_t next = ((head >> 32) + 1) << 32 | links[index];
+        if (atomic_compare_exchange_strong_explicit_u64(free_head,
+                &head, next, MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_ACQUIRE)) {
+            return index;
+        }
+    }
+}
+
+static void free_list_push(atomic_uint64_t* free_head, uint32_t* links, uint32_t index) {
+    uint64_t head = atomic_load_explicit_u64(free_head, MEMORY_ORDER_ACQUIRE);
+    uint64_t next;
+    
+    do {
+        links[index] = (uint32_t)head;
+        next = ((head >> 32) + 1) << 32 | index;
+    } while (!atomic_compare_exchange_strong_explicit_u64(free_head,
+                 &head, next, MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_ACQUIRE));
+}
+
+/* Take a free op holding only the completion reference; NULL when every
+ * op is pending or still referenced by a future or continuation
+ */
 static async_op_t* get_op_from_pool(void) {
-    uint32_t index = atomic_fetch_add_explicit_u32(
-        &async_state.op_pool_index, 1, MEMORY_ORDER_ACQ_REL) % MAX_PENDING_OPS;
-    return &async_state.op_pool[index];
+    uint32_t index = free_list_pop(&async_state.op_free, async_state.op_next);
+    if (index == ASYNC_NO_PARAM_BLOCK) {
+        return NULL;
+    }
+    
+    async_op_t* op = &async_state.op_pool[index];
+    op->result = NULL;
+    atomic_store_explicit_ptr(&op->conts, NULL, MEMORY_ORDER_RELAXED);
+    atomic_store_explicit_u32(&op->refs, 1, MEMORY_ORDER_RELAXED);
+    return op;
+}
+
+static void op_get(async_op_t* op) {
+    atomic_fetch_add_explicit_u32(&op->refs, 1, MEMORY_ORDER_RELAXED);
+}
+
+/* Drop a reference; the last one returns the op to the pool. Its id and
+ * final status stay readable until it is handed out again.
+ */
+static void op_put(async_op_t* op) {
+    if (atomic_fetch_sub_explicit_u32(&op->refs, 1, MEMORY_ORDER_ACQ_REL) == 1) {
+        free_list_push(&async_state.op_free, async_state.op_next,
+                       (uint32_t)(op - async_state.op_pool));
+    }
+}
+
+static uint32_t param_block_alloc(void) {
+    return free_list_pop(&async_state.param_free, async_state.param_next);
+}
+
+static void param_block_free(uint32_t index) {
+    free_list_push(&async_state.param_free, async_state.param_next, index);
+}
+
+/* Copy params into the op, inline or into a pool block */
+static bool op_set_params(async_op_t* op, const void* params, uint32_t param_size) {
+    op->params = NULL;
+    op->param_size = 0;
+    op->param_block = ASYNC_NO_PARAM_BLOCK;
+    
+    if (!params || param_size == 0) {
+        return true;
+    }
+    
+    if (param_size <= ASYNC_INLINE_PARAMS) {
+        op->params = op->inline_params;
+    } else if (param_size <= ASYNC_PARAM_BLOCK_SIZE) {
+        op->param_block = param_block_alloc();
+        if (op->param_block == ASYNC_NO_PARAM_BLOCK) {
+            return false;
+        }
+        op->params = async_state.param_blocks + op->param_block * ASYNC_PARAM_BLOCK_SIZE;
+    } else {
+        return false;
+    }
+    
+    memcpy(op->params, params, param_size);
+    op->param_size = param_size;
+    return true;
+}
+
+static void op_release_params(async_op_t* op) {
+    if (op->param_block != ASYNC_NO_PARAM_BLOCK) {
+        param_block_free(op->param_block);
+        op->param_block = ASYNC_NO_PARAM_BLOCK;
+    }
+    op->params = NULL;
+}
+
+/* Take a continuation node; NULL if all are attached to pending ops.
+ * Nodes only return to the pool once they have run, so a node still
+ * linked into an op's list is never handed out again.
+ */
+static async_cont_t* get_cont_from_pool(void) {
+    uint32_t index = free_list_pop(&async_state.cont_free, async_state.cont_next);
+    if (index == ASYNC_NO_PARAM_BLOCK) {
+        return NULL;
+    }
+    
+    async_cont_t* cont = &async_state.cont_pool[index];
+    memset(cont, 0, sizeof(*cont));
+    return cont;
+}
+
+static void put_cont_to_pool(async_cont_t* cont) {
+    free_list_push(&async_state.cont_free, async_state.cont_next,
+                   (uint32_t)(cont - async_state.cont_pool));
+}
+
+/* Run a detached continuation and give its node back */
+static void cont_run(async_cont_t* cont, async_status_t status, void* result) {
+    cont->run(cont, status, result);
+    put_cont_to_pool(cont);
+}
+
+/* Hand out a future, which takes its own reference */
+static async_future_t make_future(async_op_t* op) {
+    async_future_t future = { .op = op, .op_id = op ? op->op_id : 0 };
+    
+    if (op) {
+        op_get(op);
+    }
+    return future;
+}
+
+static bool status_is_final(async_status_t status) {
+    return status == ASYNC_STATUS_COMPLETED ||
+           status == ASYNC_STATUS_FAILED ||
+           status == ASYNC_STATUS_CANCELLED;
+}
+
+/* Attach a continuation; false if the op already completed */
+static bool op_add_cont(async_op_t* op, async_cont_t* cont) {
+    void* head;
+    
+    do {
+        head = atomic_load_explicit_ptr(&op->conts, MEMORY_ORDER_ACQUIRE);
+        if (head == CONT_CLOSED) {
+            return false;
+        }
+        cont->next = head;
+    } while (!atomic_compare_exchange_strong_explicit_ptr(
+                 &op->conts, &head, cont,
+                 MEMORY_ORDER_RELEASE, MEMORY_ORDER_RELAXED));
+    return true;
+}
+
+/* Publish the final status, then run the callback and continuations */
+static void complete_op(async_op_t* op, async_status_t status, void* result) {
+    op->result = result;
+    atomic_store_explicit_u32(&op->status, status, MEMORY_ORDER_RELEASE);
+    
+    if (op->callback) {
+        op->callback(op->callback_context, status, result);
+    }
+    
+    // Close the list so late registrations run inline, then run in
+    // registration order
+    async_cont_t* list = atomic_exchange_explicit_ptr(&op->conts, CONT_CLOSED,
+                                                      MEMORY_ORDER_ACQ_REL);
+    async_cont_t* fifo = NULL;
+    while (list) {
+        async_cont_t* next = list->next;
+        list->next = fifo;
+        fifo = list;
+        list = next;
+    }
+    
+    while (fifo) {
+        async_cont_t* next = fifo->next;
+        cont_run(fifo, status, result);
+        fifo = next;
+    }
+    
+    op_put(op);
+}
+
+/* Create a pending op that is completed explicitly */
+static async_op_t* promise_alloc(void) {
+    async_op_t* op = get_op_from_pool();
+    if (!op) {
+        return NULL;
+    }
+    
+    op->op_id = atomic_fetch_add_explicit_u32(&async_state.next_op_id, 1, MEMORY_ORDER_ACQ_REL);
+    op->type = ASYNC_OP_PROMISE;
+    op->handler = NULL;
+    op->params = NULL;
+    op->param_size = 0;
+    op->param_block = ASYNC_NO_PARAM_BLOCK;
+    op->callback = NULL;
+    op->callback_context = NULL;
+    atomic_store_explicit_bool(&op->cancellable, false, MEMORY_ORDER_RELAXED);
+    atomic_store_explicit_u32(&op->status, ASYNC_STATUS_PENDING, MEMORY_ORDER_RELEASE);
+    return op;
+}
+
+/* First completer wins */
+static bool promise_settle(async_op_t* op, async_status_t status, void* result) {
+    uint32_t expected = ASYNC_STATUS_PENDING;
+    
+    if (!atomic_compare_exchange_strong_explicit_u32(&op->status,
+            &expected, ASYNC_STATUS_IN_PROGRESS,
+            MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_ACQUIRE)) {
+        return false;
+    }
+    complete_op(op, status, result);
+    return true;
+}
+
+/* Settle a continuation's target and drop the reference it held */
+static void cont_settle(async_cont_t* cont, async_status_t status, void* result) {
+    if (cont->target->op_id == cont->target_id) {
+        promise_settle(cont->target, status, result);
+    }
+    op_put(cont->target);
+}
+
+/* Continuation bodies */
+static void cont_wake(async_cont_t* cont, async_status_t status, void* result) {
+    semaphore_post(cont->context);
+}
+
+static void cont_then(async_cont_t* cont, async_status_t status, void* result) {
+    if (cont->fn) {
+        cont->fn(cont->context, status, result);
+    }
+    cont_settle(cont, status, result);
+}
+
+static void cont_any(async_cont_t* cont, async_status_t status, void* result) {
+    cont_settle(cont, status, result);
+}
+
+static void cont_all(async_cont_t* cont, async_status_t status, void* result) {
+    async_op_t* target = cont->target;
+    
+    if (status != ASYNC_STATUS_COMPLETED) {
+        atomic_store_explicit_u32(&target->combined_status, status, MEMORY_ORDER_RELAXED);
+    }
+    if (atomic_fetch_sub_explicit_u32(&target->pending_inputs, 1, MEMORY_ORDER_ACQ_REL) == 1) {
+        cont_settle(cont,
+            atomic_load_explicit_u32(&target->combined_status, MEMORY_ORDER_RELAXED),
+            NULL);
+    } else {
+        op_put(target);
+    }
+}
+
+/* Take count nodes up front, chained through next, so a combinator
+ * attaches to every input or to none. NULL if the pool runs short.
+ */
+static async_cont_t* cont_reserve(uint32_t count) {
+    async_cont_t* chain = NULL;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        async_cont_t* cont = get_cont_from_pool();
+        if (!cont) {
+            while (chain) {
+                async_cont_t* next = chain->next;
+                put_cont_to_pool(chain);
+                chain = next;
+            }
+            return NULL;
+        }
+        cont->next = chain;
+        chain = cont;
+    }
+    return chain;
+}
+
+/* Attach a reserved node completing target to future, running it now if
+ * the op is already done. The node holds a reference on target until it
+ * has run.
+ */
+static void future_attach(async_future_t future, async_cont_t* cont,
+                          void (*run)(async_cont_t*, async_status_t, void*),
+                          async_callback_t fn, void* context, async_op_t* target) {
+    cont->run = run;
+    cont->fn = fn;
+    cont->context = context;
+    cont->target = target;
+    cont->target_id = target->op_id;
+    op_get(target);
+    
+    if (!future.op || future.op->op_id != future.op_id) {
+        cont_run(cont, ASYNC_STATUS_FAILED, NULL);
+        return;
+    }
+    if (!op_add_cont(future.op, cont)) {
+        cont_run(cont, async_future_status(future), async_future_result(future));
+    }
+}
+
+/* Detach cont if nothing has been pushed in front of it. Pushes only
+ * happen at the head and completion takes the whole list, so while cont
+ * is still the head its next link is stable.
+ */
+static bool op_remove_cont(async_op_t* op, async_cont_t* cont) {
+    void* head = cont;
+    return atomic_compare_exchange_strong_explicit_ptr(&op->conts, &head, cont->next,
+                                                       MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_RELAXED);
 }
 
 /* Select worker based on operation type and current load */
 static worker_state_t* select_worker(async_op_type_t type, uint32_t priority) {
     worker_state_t* best_worker = &async_state.workers[0];
     uint32_t min_count = UINT32_MAX;
-
+    
     for (uint32_t i = 0; i < async_state.num_workers; i++) {
         worker_state_t* worker = &async_state.workers[i];
-        uint32_t count = atomic_load_explicit_u32(&worker->queue.count, MEMORY_ORDER_ACQUIRE);
+        uint32_t count = atomic_load_explicit_u32(&worker->inbox_count, MEMORY_ORDER_RELAXED);
+        for (uint32_t lane = 0; lane < ASYNC_LANES; lane++) {
+            count += deque_size(&worker->deques[lane]);
+        }
         
         if (count < min_count) {
             min_count = count;
             best_worker = worker;
         }
     }
-
+    
     return best_worker;
 }
 
-/* Submit an async operation */
-uint32_t async_submit(async_op_type_t type, void* params, uint32_t param_size,
-                     async_callback_t callback, void* context,
-                     uint64_t deadline, uint32_t priority) {
-    if (!atomic_load_explicit_bool(&async_state.initialized, MEMORY_ORDER_ACQUIRE)) {
-        return 0;
+static uint8_t priority_to_lane(uint32_t priority) {
+    if (priority >= ASYNC_PRIORITY_HIGH) {
+        return ASYNC_LANE_HIGH;
     }
+    return priority >= ASYNC_PRIORITY_NORMAL ? ASYNC_LANE_NORMAL : ASYNC_LANE_LOW;
+}
 
-    // Prepare operation
+static void stat_max_u64(atomic_uint64_t* max, uint64_t value) {
+    uint64_t cur = atomic_load_explicit_u64(max, MEMORY_ORDER_RELAXED);
+    while (value > cur &&
+           !atomic_compare_exchange_strong_explicit_u64(max, &cur, value,
+               MEMORY_ORDER_RELAXED, MEMORY_ORDER_RELAXED)) {
+    }
+}
+
+/* Fill a pooled op; NULL if the type has no handler or its params
+ * can't be stored
+ */
+static async_op_t* prepare_op(async_op_type_t type, const void* params, uint32_t param_size,
+                              async_callback_t callback, void* context,
+                              uint64_t deadline, uint32_t priority) {
+    if ((uint32_t)type >= ASYNC_MAX_OP_TYPES || !async_state.types[type].handler) {
+        return NULL;
+    }
+    
     async_op_t* op = get_op_from_pool();
-    op->op_id = atomic_fetch_add_explicit_u32(&async_state.next_op_id, 1, MEMORY_ORDER_ACQ_REL);
-    op->type = type;
-    atomic_store_explicit_u32((atomic_uint32_t*)&op->status, ASYNC_STATUS_PENDING, MEMORY_ORDER_RELEASE);
+    if (!op) {
+        return NULL;
+    }
     
     // Copy parameters
-    if (params && param_size > 0) {
-        op->params = malloc(param_size);
-        if (!op->params) {
-            return 0;
-        }
-        memcpy(op->params, params, param_size);
-        op->param_size = param_size;
+    if (!op_set_params(op, params, param_size)) {
+        op_put(op);
+        return NULL;
     }
-
+    
+    op->op_id = atomic_fetch_add_explicit_u32(&async_state.next_op_id, 1, MEMORY_ORDER_ACQ_REL);
+    op->type = type;
+    op->handler = async_state.types[type].handler;
+    op->lane = priority_to_lane(priority);
+    op->submit_ns = timer_get_time_ns();
     op->callback = callback;
     op->callback_context = context;
     atomic_store_explicit_ptr(&op->next, NULL, MEMORY_ORDER_RELEASE);
     op->deadline = deadline;
     op->priority = priority;
     atomic_store_explicit_bool(&op->cancellable, true, MEMORY_ORDER_RELEASE);
+    atomic_store_explicit_u32(&op->status, ASYNC_STATUS_PENDING, MEMORY_ORDER_RELEASE);
+    
+    atomic_fetch_add_explicit_u64(&async_state.types[type].submitted, 1, MEMORY_ORDER_RELAXED);
+    return op;
+}
 
-    // Select worker and add to queue
+/* Submit an async operation */
+async_future_t async_submit(async_op_type_t type, void* params, uint32_t param_size,
+                     async_callback_t callback, void* context,
+                     uint64_t deadline, uint32_t priority) {
+    if (!atomic_load_explicit_bool(&async_state.initialized, MEMORY_ORDER_ACQUIRE)) {
+        return make_future(NULL);
+    }
+    
+    // Prepare operation
+    async_op_t* op = prepare_op(type, params, param_size, callback, context,
+                                deadline, priority);
+    if (!op) {
+        return make_future(NULL);
+    }
+    
+    // Take the future's reference before a worker can complete the op
+    async_future_t future = make_future(op);
+    
+    // Workers push to their own deque; idle peers will steal it
+    if (current_worker && deque_push(&current_worker->deques[op->lane], op)) {
+        wake_idle_worker(current_worker);
+        return future;
+    }
+    
+    // External submitters hand off through the least loaded worker's inbox
     worker_state_t* worker = select_worker(type, priority);
-    mutex_lock(worker->queue.lock);
+    inbox_push(worker, op);
+    wake_worker(worker);
+    
+    return future;
+}
 
-    if (!atomic_load_explicit_ptr(&worker->queue.tail, MEMORY_ORDER_ACQUIRE)) {
-        atomic_store_explicit_ptr(&worker->queue.head, op, MEMORY_ORDER_RELEASE);
-        atomic_store_explicit_ptr(&worker->queue.tail, op, MEMORY_ORDER_RELEASE);
-    } else {
-        async_op_t* tail = atomic_load_explicit_ptr(&worker->queue.tail, MEMORY_ORDER_ACQUIRE);
-        atomic_store_explicit_ptr(&tail->next, op, MEMORY_ORDER_RELEASE);
-        atomic_store_explicit_ptr(&worker->queue.tail, op, MEMORY_ORDER_RELEASE);
+/* Submit a batch of async operations */
+uint32_t async_submit_batch(const async_request_t* reqs, uint32_t count,
+                           async_future_t* futures) {
+    if (!atomic_load_explicit_bool(&async_state.initialized, MEMORY_ORDER_ACQUIRE)) {
+        return 0;
     }
-
-    atomic_fetch_add_explicit_u32(&worker->queue.count, 1, MEMORY_ORDER_ACQ_REL);
-    mutex_unlock(worker->queue.lock);
-
-    return op->op_id;
+    
+    async_op_t* first = NULL;
+    async_op_t* last = NULL;
+    uint32_t chained = 0;
+    uint32_t queued = 0;
+    
+    for (; queued < count; queued++) {
+        const async_request_t* req = &reqs[queued];
+        async_op_t* op = prepare_op(req->type, req->params, req->param_size,
+                                    req->callback, req->context,
+                                    req->deadline, req->priority);
+        if (!op) {
+            break;
+        }
+        if (futures) {
+            futures[queued] = make_future(op);
+        }
+        
+        // Workers fill their own deque first
+        if (current_worker && deque_push(&current_worker->deques[op->lane], op)) {
+            continue;
+        }
+        
+        // Everything else is chained newest-first for one inbox splice
+        atomic_store_explicit_ptr(&op->next, first, MEMORY_ORDER_RELAXED);
+        first = op;
+        if (!last) {
+            last = op;
+        }
+        chained++;
+    }
+    
+    if (chained) {
+        worker_state_t* worker = select_worker(reqs[0].type, reqs[0].priority);
+        inbox_push_chain(worker, first, last, chained);
+        wake_worker(worker);
+    } else if (queued && current_worker) {
+        wake_idle_worker(current_worker);
+    }
+    
+    return queued;
 }
 
 /* Cancel an async operation */
@@ -158,9 +859,12 @@ bool async_cancel(uint32_t op_id) {
         async_op_t* op = &async_state.op_pool[i];
         if (op->op_id == op_id && 
             atomic_load_explicit_bool(&op->cancellable, MEMORY_ORDER_ACQUIRE)) {
-            atomic_store_explicit_u32((atomic_uint32_t*)&op->status,
-                                    ASYNC_STATUS_CANCELLED, MEMORY_ORDER_RELEASE);
-            return true;
+            // Only a still-queued op can be cancelled; a worker may have
+            // claimed it since the check above
+            uint32_t expected = ASYNC_STATUS_PENDING;
+            return atomic_compare_exchange_strong_explicit_u32(&op->status,
+                &expected, ASYNC_STATUS_CANCELLED,
+                MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_ACQUIRE);
         }
     }
     return false;
@@ -201,95 +905,274 @@ async_status_t async_get_status(uint32_t op_id) {
     return ASYNC_STATUS_FAILED;
 }
 
-/* Process pending operations (called by worker threads) */
-void async_process_ops(void) {
-    while (atomic_load_explicit_bool(&async_state.initialized, MEMORY_ORDER_ACQUIRE)) {
-        bool processed = false;
-        
-        // Process operations from all queues
-        for (uint32_t i = 0; i < async_state.num_workers; i++) {
-            worker_state_t* worker = &async_state.workers[i];
-            if (!atomic_load_explicit_bool(&worker->active, MEMORY_ORDER_ACQUIRE)) {
-                continue;
+/* Get future status; FAILED for an invalid or already released future */
+async_status_t async_future_status(async_future_t future) {
+    if (!future.op || future.op->op_id != future.op_id) {
+        return ASYNC_STATUS_FAILED;
+    }
+    return atomic_load_explicit_u32(&future.op->status, MEMORY_ORDER_ACQUIRE);
+}
+
+/* Get future result, NULL until completed */
+void* async_future_result(async_future_t future) {
+    if (!future.op || future.op->op_id != future.op_id ||
+        !status_is_final(atomic_load_explicit_u32(&future.op->status, MEMORY_ORDER_ACQUIRE))) {
+        return NULL;
+    }
+    return future.op->result;
+}
+
+/* Drop the future's reference */
+void async_future_release(async_future_t future) {
+    if (future.op && future.op->op_id == future.op_id) {
+        op_put(future.op);
+    }
+}
+
+/* Block on a per-thread semaphore posted by the completing worker */
+bool async_future_wait(async_future_t future, uint32_t timeout_ms) {
+    if (!future.op) {
+        return false;
+    }
+    if (status_is_final(async_future_status(future))) {
+        return true;
+    }
+    
+    if (!wait_sem) {
+        wait_sem = semaphore_create(0);
+        if (!wait_sem) {
+            return false;
+        }
+    }
+    
+    // An earlier timed-out wait on this op left its node attached; the op
+    // is still pending, so the node has not run and can be waited on again
+    async_cont_t* cont = NULL;
+    if (wait_cont && wait_future.op == future.op && wait_future.op_id == future.op_id) {
+        cont = wait_cont;
+    } else {
+        cont = get_cont_from_pool();
+        if (cont) {
+            cont->run = cont_wake;
+            cont->context = wait_sem;
+            if (!op_add_cont(future.op, cont)) {
+                put_cont_to_pool(cont);
+                return true;
+            }
+        }
+    }
+    wait_cont = NULL;
+    
+    // Posts left over from earlier timed-out waits only cause a re-check.
+    // Without a node, fall back to polling.
+    uint64_t deadline = get_system_time_ms() + timeout_ms;
+    while (!status_is_final(async_future_status(future))) {
+        uint64_t now = get_system_time_ms();
+        if (now >= deadline) {
+            if (cont && !op_remove_cont(future.op, cont)) {
+                // Someone attached after us or completion is running; the
+                // node goes back to the pool once it has run
+                wait_cont = cont;
+                wait_future = future;
+            } else if (cont) {
+                put_cont_to_pool(cont);
             }
+            return false;
+        }
+        semaphore_wait(wait_sem, cont ? (uint32_t)(deadline - now) : 1);
+    }
+    return true;
+}
 
-            mutex_lock(worker->queue.lock);
-            async_op_t* op = atomic_load_explicit_ptr(&worker->queue.head, MEMORY_ORDER_ACQUIRE);
-            
-            if (op) {
-                // Remove from queue
-                atomic_store_explicit_ptr(&worker->queue.head,
-                    atomic_load_explicit_ptr(&op->next, MEMORY_ORDER_ACQUIRE),
-                    MEMORY_ORDER_RELEASE);
-                
-                if (!atomic_load_explicit_ptr(&worker->queue.head, MEMORY_ORDER_ACQUIRE)) {
-                    atomic_store_explicit_ptr(&worker->queue.tail, NULL, MEMORY_ORDER_RELEASE);
-                }
-                
-                atomic_fetch_sub_explicit_u32(&worker->queue.count, 1, MEMORY_ORDER_ACQ_REL);
-                mutex_unlock(worker->queue.lock);
-
-                // Process operation
-                atomic_store_explicit_u32((atomic_uint32_t*)&op->status,
-                                        ASYNC_STATUS_IN_PROGRESS, MEMORY_ORDER_RELEASE);
-                atomic_store_explicit_bool(&op->cancellable, false, MEMORY_ORDER_RELEASE);
-
-                bool success = true;
-                void* result = NULL;
-
-                switch (op->type) {
-                    case ASYNC_OP_TASK_MIGRATION:
-                        // Handle task migration
-                        success = handle_task_migration(op->params);
-                        break;
-                        
-                    case ASYNC_OP_LOAD_UPDATE:
-                        // Handle load update
-                        success = handle_load_update(op->params);
-                        break;
-                        
-                    case ASYNC_OP_POLICY_CHANGE:
-                        // Handle policy change
-                        success = handle_policy_change(op->params);
-                        break;
-                        
-                    case ASYNC_OP_THERMAL_ADJUST:
-                        // Handle thermal adjustment
-                        success = handle_thermal_adjust(op->params);
-                        break;
-                        
-                    case ASYNC_OP_MEMORY_REBALANCE:
-                        // Handle memory rebalancing
-                        success = handle_memory_rebalance(op->params);
-                        break;
-                }
+/* Allocate a combinator's promise and reserve a node per input. The
+ * future is taken before any input can settle and release the promise.
+ */
+static async_op_t* combinator_alloc(uint32_t count, async_cont_t** conts,
+                                    async_future_t* future) {
+    async_op_t* target = promise_alloc();
+    
+    *future = make_future(NULL);
+    if (!target) {
+        return NULL;
+    }
+    
+    *conts = cont_reserve(count);
+    if (count && !*conts) {
+        op_put(target);
+        return NULL;
+    }
+    
+    *future = make_future(target);
+    return target;
+}
 
-                // Update status and call callback
-                atomic_store_explicit_u32((atomic_uint32_t*)&op->status,
-                    success ? ASYNC_STATUS_COMPLETED : ASYNC_STATUS_FAILED,
-                    MEMORY_ORDER_RELEASE);
+/* Chain a continuation */
+async_future_t async_then(async_future_t future, async_callback_t fn, void* context) {
+    async_cont_t* cont;
+    async_future_t result;
+    async_op_t* target = combinator_alloc(1, &cont, &result);
+    
+    if (target) {
+        future_attach(future, cont, cont_then, fn, context, target);
+    }
+    
+    return result;
+}
 
-                if (op->callback) {
-                    op->callback(op->callback_context,
-                               success ? ASYNC_STATUS_COMPLETED : ASYNC_STATUS_FAILED,
-                               result);
-                }
+/* Complete when every input has */
+async_future_t async_when_all(const async_future_t* futures, uint32_t count) {
+    async_cont_t* conts;
+    async_future_t result;
+    async_op_t* target = combinator_alloc(count, &conts, &result);
+    
+    if (!target) {
+        return result;
+    }
+    
+    atomic_store_explicit_u32(&target->combined_status, ASYNC_STATUS_COMPLETED, MEMORY_ORDER_RELAXED);
+    if (count == 0) {
+        promise_settle(target, ASYNC_STATUS_COMPLETED, NULL);
+        return result;
+    }
+    
+    // Set the count first; inputs may complete while we attach
+    atomic_store_explicit_u32(&target->pending_inputs, count, MEMORY_ORDER_RELEASE);
+    for (uint32_t i = 0; i < count; i++) {
+        async_cont_t* next = conts->next;
+        future_attach(futures[i], conts, cont_all, NULL, NULL, target);
+        conts = next;
+    }
+    
+    return result;
+}
 
-                // Cleanup
-                if (op->params) {
-                    free(op->params);
-                    op->params = NULL;
-                }
+/* Complete when the first input does */
+async_future_t async_when_any(const async_future_t* futures, uint32_t count) {
+    async_cont_t* conts;
+    async_future_t result;
+    async_op_t* target = combinator_alloc(count, &conts, &result);
+    
+    if (!target) {
+        return result;
+    }
+    
+    // Nothing could ever settle it
+    if (count == 0) {
+        promise_settle(target, ASYNC_STATUS_FAILED, NULL);
+        return result;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        async_cont_t* next = conts->next;
+        future_attach(futures[i], conts, cont_any, NULL, NULL, target);
+        conts = next;
+    }
+    
+    return result;
+}
 
-                processed = true;
-            } else {
-                mutex_unlock(worker->queue.lock);
-            }
+/* Create a promise */
+async_future_t async_promise_create(void) {
+    return make_future(promise_alloc());
+}
+
+/* Complete a promise; false if already completed or recycled */
+bool async_promise_complete(async_future_t promise, async_status_t status, void* result) {
+    if (!promise.op || promise.op->op_id != promise.op_id ||
+        promise.op->type != ASYNC_OP_PROMISE || !status_is_final(status)) {
+        return false;
+    }
+    return promise_settle(promise.op, status, result);
+}
+
+/* Run one dequeued operation */
+static void run_op(async_op_t* op) {
+    // Claim it; a cancelled op is completed without running
+    uint32_t expected = ASYNC_STATUS_PENDING;
+    atomic_store_explicit_bool(&op->cancellable, false, MEMORY_ORDER_RELEASE);
+    if (!atomic_compare_exchange_strong_explicit_u32(&op->status,
+            &expected, ASYNC_STATUS_IN_PROGRESS,
+            MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_ACQUIRE)) {
+        atomic_fetch_add_explicit_u64(&async_state.types[op->type].cancelled, 1, MEMORY_ORDER_RELAXED);
+        op_release_params(op);
+        complete_op(op, ASYNC_STATUS_CANCELLED, NULL);
+        return;
+    }
+    
+    async_type_t* type = &async_state.types[op->type];
+    uint64_t start_ns = timer_get_time_ns();
+    void* result = NULL;
+    bool success = op->handler(op->params, &result);
+    uint64_t end_ns = timer_get_time_ns();
+    
+    // Account queue and run time against the op's type
+    atomic_fetch_add_explicit_u64(&type->queue_ns_total, start_ns - op->submit_ns, MEMORY_ORDER_RELAXED);
+    atomic_fetch_add_explicit_u64(&type->run_ns_total, end_ns - start_ns, MEMORY_ORDER_RELAXED);
+    stat_max_u64(&type->queue_ns_max, start_ns - op->submit_ns);
+    stat_max_u64(&type->run_ns_max, end_ns - start_ns);
+    atomic_fetch_add_explicit_u64(success ? &type->completed : &type->failed, 1, MEMORY_ORDER_RELAXED);
+    
+    // Return the param block before continuations can submit more work
+    op_release_params(op);
+    
+    // Update status, call callback and run continuations
+    complete_op(op, success ? ASYNC_STATUS_COMPLETED : ASYNC_STATUS_FAILED, result);
+}
+
+/* Find the next op: drain own inbox, then own lanes, then steal */
+static async_op_t* find_work(worker_state_t* self) {
+    if (atomic_load_explicit_ptr(&self->inbox, MEMORY_ORDER_ACQUIRE)) {
+        inbox_drain(self);
+    }
+    
+    for (uint32_t lane = 0; lane < ASYNC_LANES; lane++) {
+        async_op_t* op = deque_pop(&self->deques[lane]);
+        if (op) {
+            return op;
         }
+    }
+    
+    return steal_work(self);
+}
 
-        if (!processed) {
+/* Process pending operations (called by worker threads) */
+void async_process_ops(void) {
+    worker_state_t* self = current_worker;
+    uint32_t idle_rounds = 0;
+    
+    if (!self) {
+        return;
+    }
+    
+    while (atomic_load_explicit_bool(&self->active, MEMORY_ORDER_ACQUIRE)) {
+        async_op_t* op = find_work(self);
+        
+        if (op) {
+            idle_rounds = 0;
+            run_op(op);
+            continue;
+        }
+        
+        // Spin a bounded number of rounds before sleeping
+        if (++idle_rounds < ASYNC_SPIN_ROUNDS) {
             thread_yield();
+            continue;
         }
+        
+        // Advertise we're parking, then re-check so a racing submit
+        // either sees the flag or we see its work
+        atomic_store_explicit_u32(&self->parked, 1, MEMORY_ORDER_SEQ_CST);
+        op = find_work(self);
+        if (op) {
+            atomic_store_explicit_u32(&self->parked, 0, MEMORY_ORDER_RELEASE);
+            idle_rounds = 0;
+            run_op(op);
+            continue;
+        }
+        
+        semaphore_wait(self->park_sem, ASYNC_PARK_TIMEOUT_MS);
+        atomic_store_explicit_u32(&self->parked, 0, MEMORY_ORDER_RELEASE);
+        idle_rounds = 0;
     }
 }
 
@@ -298,39 +1181,48 @@ void async_shutdown(void) {
     if (!atomic_load_explicit_bool(&async_state.initialized, MEMORY_ORDER_ACQUIRE)) {
         return;
     }
-
+    
     // Stop workers
     for (uint32_t i = 0; i < async_state.num_workers; i++) {
-        atomic_store_explicit_bool(&async_state.workers[i].active, false, MEMORY_ORDER_RELEASE);
-        if (async_state.workers[i].thread) {
-            thread_join(async_state.workers[i].thread);
-            async_state.workers[i].thread = NULL;
+        worker_state_t* worker = &async_state.workers[i];
+        atomic_store_explicit_bool(&worker->active, false, MEMORY_ORDER_RELEASE);
+        if (worker->park_sem) {
+            semaphore_post(worker->park_sem);
         }
-        if (async_state.workers[i].queue.lock) {
-            mutex_destroy(async_state.workers[i].queue.lock);
-            async_state.workers[i].queue.lock = NULL;
+        if (worker->thread) {
+            thread_join(worker->thread);
+            worker->thread = NULL;
         }
-    }
-
-    // Cleanup remaining operations
-    for (uint32_t i = 0; i < MAX_PENDING_OPS; i++) {
-        async_op_t* op = &async_state.op_pool[i];
-        if (op->params) {
-            free(op->params);
-            op->params = NULL;
+        if (worker->park_sem) {
+            semaphore_destroy(worker->park_sem);
+            worker->park_sem = NULL;
         }
     }
-
-    // Free resources
+    
+    // Free resources; op params live inline or in the block pool
     if (async_state.op_pool) {
         free(async_state.op_pool);
         async_state.op_pool = NULL;
     }
+    free(async_state.op_next);
+    async_state.op_next = NULL;
+    
+    if (async_state.cont_pool) {
+        free(async_state.cont_pool);
+        async_state.cont_pool = NULL;
+    }
+    free(async_state.cont_next);
+    async_state.cont_next = NULL;
+    
+    free(async_state.param_blocks);
+    free(async_state.param_next);
+    async_state.param_blocks = NULL;
+    async_state.param_next = NULL;
     
     if (async_state.global_lock) {
         mutex_destroy(async_state.global_lock);
         async_state.global_lock = NULL;
     }
-
+    
     atomic_store_explicit_bool(&async_state.initialized, false, MEMORY_ORDER_RELEASE);
 }
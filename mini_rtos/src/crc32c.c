@@ -0,0 +1,236 @@
+#include <string.h>
+#include "crc32c.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42 1
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_HAVE_ARMV8 1
+#if defined(__linux__) && !defined(__ARM_FEATURE_CRC32)
+#include <sys/auxv.h>
+#endif
+#endif
+
+#define CRC32C_POLY 0x82F63B78u
+
+typedef uint32_t (*crc32c_fn_t)(uint32_t crc, const uint8_t *data, size_t length);
+
+/* Slicing tables: table[0] is the classic byte table, table[k] advances
+ * a byte through k further zero bytes */
+static uint32_t crc32c_table[8][256];
+static bool crc32c_tables_ready = false;
+static crc32c_fn_t crc32c_fn = NULL;
+static crc32c_impl_t crc32c_impl = CRC32C_IMPL_BYTE;
+
+static void crc32c_build_tables(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+        }
+        crc32c_table[0][i] = crc;
+    }
+    
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = crc32c_table[k - 1][i];
+            crc32c_table[k][i] = (prev >> 8) ^ crc32c_table[0][prev & 0xFF];
+        }
+    }
+    
+    crc32c_tables_ready = true;
+}
+
+/* Software Implementations */
+static uint32_t crc32c_byte(uint32_t crc, const uint8_t *data, size_t length) {
+    while (length--) {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+static uint32_t crc32c_slice8(uint32_t crc, const uint8_t *data, size_t length) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    /* Align so the 8-byte loads below are natural */
+    while (length && ((uintptr_t)data & 7)) {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *data++) & 0xFF];
+        length--;
+    }
+    
+    while (length >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+        lo ^= crc;
+        crc = crc32c_table[7][lo & 0xFF] ^
+              crc32c_table[6][(lo >> 8) & 0xFF] ^
+              crc32c_table[5][(lo >> 16) & 0xFF] ^
+              crc32c_table[4][lo >> 24] ^
+              crc32c_table[3][hi & 0xFF] ^
+              crc32c_table[2][(hi >> 8) & 0xFF] ^
+              crc32c_table[1][(hi >> 16) & 0xFF] ^
+              crc32c_table[0][hi >> 24];
+        data += 8;
+        length -= 8;
+    }
+#endif
+    
+    return crc32c_byte(crc, data, length);
+}
+
+/* Hardware Implementations */
+#ifdef CRC32C_HAVE_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *data, size_t length) {
+    while (length && ((uintptr_t)data & 7)) {
+        crc = _mm_crc32_u8(crc, *data++);
+        length--;
+    }
+    
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+    
+    while (length >= 4) {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        crc = _mm_crc32_u32(crc, word);
+        data += 4;
+        length -= 4;
+    }
+    while (length--) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+#ifdef CRC32C_HAVE_ARMV8
+#if defined(__aarch64__) && !defined(__ARM_FEATURE_CRC32)
+__attribute__((target("+crc")))
+#endif
+static uint32_t crc32c_armv8(uint32_t crc, const uint8_t *data, size_t length) {
+    while (length && ((uintptr_t)data & 7)) {
+        crc = __crc32cb(crc, *data++);
+        length--;
+    }
+    
+#if defined(__aarch64__)
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+        data += 8;
+        length -= 8;
+    }
+#endif
+    
+    while (length >= 4) {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        crc = __crc32cw(crc, word);
+        data += 4;
+        length -= 4;
+    }
+    while (length--) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+static const crc32c_fn_t crc32c_impls[CRC32C_IMPL_COUNT] = {
+    [CRC32C_IMPL_BYTE] = crc32c_byte,
+    [CRC32C_IMPL_SLICE8] = crc32c_slice8,
+#ifdef CRC32C_HAVE_SSE42
+    [CRC32C_IMPL_SSE42] = crc32c_sse42,
+#endif
+#ifdef CRC32C_HAVE_ARMV8
+    [CRC32C_IMPL_ARMV8] = crc32c_armv8,
+#endif
+};
+
+/* Runtime Selection */
+bool crc32c_impl_available(crc32c_impl_t impl) {
+    switch (impl) {
+    case CRC32C_IMPL_BYTE:
+    case CRC32C_IMPL_SLICE8:
+        return true;
+#ifdef CRC32C_HAVE_SSE42
+    case CRC32C_IMPL_SSE42:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2");
+#endif
+#ifdef CRC32C_HAVE_ARMV8
+    case CRC32C_IMPL_ARMV8:
+#if defined(__ARM_FEATURE_CRC32)
+        return true;        /* Built for a core that has it */
+#elif defined(__linux__)
+        return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+        return false;
+#endif
+#endif
+    default:
+        return false;
+    }
+}
+
+bool crc32c_select(crc32c_impl_t impl) {
+    if (impl >= CRC32C_IMPL_COUNT || !crc32c_impl_available(impl)) {
+        return false;
+    }
+    
+    if (!crc32c_tables_ready) {
+        crc32c_build_tables();
+    }
+    crc32c_impl = impl;
+    crc32c_fn = crc32c_impls[impl];
+    return true;
+}
+
+void crc32c_init(void) {
+    if (crc32c_fn) return;
+    
+    if (!crc32c_select(CRC32C_IMPL_SSE42) && !crc32c_select(CRC32C_IMPL_ARMV8)) {
+        crc32c_select(CRC32C_IMPL_SLICE8);
+    }
+}
+
+crc32c_impl_t crc32c_get_impl(void) {
+    crc32c_init();
+    return crc32c_impl;
+}
+
+const char *crc32c_impl_name(crc32c_impl_t impl) {
+    static const char *names[CRC32C_IMPL_COUNT] = {
+        "byte",
+        "slice8",
+        "sse4.2",
+        "armv8"
+    };
+    
+    if (impl >= CRC32C_IMPL_COUNT) return "unknown";
+    return names[impl];
+}
+
+/* Checksum */
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t length) {
+    if (!crc32c_fn) crc32c_init();
+    return crc32c_fn(crc, data, length);
+}
+
+uint32_t crc32c(const void *data, size_t length) {
+    return ~crc32c_update(CRC32C_INIT, data, length);
+}
@@ -0,0 +1,1489 @@
+#define _GNU_SOURCE
+#include "ipc.h"
+#include "rtos_core.h"
+#include "systick.h"
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <unistd.h>
+#include <time.h>
+#define IPC_HAVE_MEMFD 1
+#else
+#include "timer.h"
+#endif
+
+#define IPC_SPIN_NS       4000  /* How long a waiter polls before it parks */
+#define IPC_SPIN_CLOCK    16    /* Polls between clock reads */
+
+static uint32_t ipc_elapsed_ms(uint32_t start_tick) {
+    return (uint32_t)((uint64_t)(get_system_ticks() - start_tick) * 1000u / SYSTICK_HZ);
+}
+
+/* Polling Before Parking
+ *
+ * A peer that answers within a few microseconds is cheaper to wait for
+ * than a futex or semaphore round trip, so waiters poll for IPC_SPIN_NS
+ * first. The bound is in time rather than rounds so it does not shrink
+ * on faster cores. On a host with one CPU online the peer cannot run
+ * while we poll, so waiters park straight away.
+ */
+static inline void ipc_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+    __asm__ volatile("yield" ::: "memory");
+#else
+    __asm__ volatile("" ::: "memory");
+#endif
+}
+
+static uint64_t ipc_now_ns(void) {
+#if IPC_HAVE_MEMFD
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#else
+    return timer_get_time_ns();
+#endif
+}
+
+static uint32_t ipc_spin_budget_ns(void) {
+#if IPC_HAVE_MEMFD
+    static int cpus;
+    if (cpus == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        cpus = online > 0 ? (int)online : 1;
+    }
+    return cpus > 1 ? IPC_SPIN_NS : 0;
+#else
+    return IPC_SPIN_NS;
+#endif
+}
+
+/* True once ready(arg) holds, false when the spin budget runs out */
+static bool ipc_spin(bool (*ready)(void *arg), void *arg) {
+    uint32_t budget = ipc_spin_budget_ns();
+    if (budget == 0) return false;
+
+    uint64_t deadline = ipc_now_ns() + budget;
+    for (uint32_t spin = 1; ; spin++) {
+        ipc_cpu_relax();
+        if (ready(arg)) return true;
+        if (spin % IPC_SPIN_CLOCK == 0 && ipc_now_ns() >= deadline) return false;
+    }
+}
+
+/* Channel Layout */
+static uint32_t channel_stride(uint32_t slot_size) {
+    uint32_t bytes = offsetof(msg_slot_t, data) + slot_size;
+    return (bytes + CACHE_LINE_SIZE - 1) & ~(uint32_t)(CACHE_LINE_SIZE - 1);
+}
+
+static uint32_t channel_round_count(uint32_t slot_count) {
+    uint32_t count = 1;
+    while (count < slot_count) {
+        count <<= 1;
+    }
+    return count;
+}
+
+/* Bytes of shared state for a channel, 0 if it does not fit in 32 bits */
+static uint32_t channel_region_size(uint32_t slot_count, uint32_t slot_size) {
+    uint64_t size = sizeof(msg_channel_shm_t) +
+                    (uint64_t)slot_count * channel_stride(slot_size);
+    return size > UINT32_MAX ? 0 : (uint32_t)size;
+}
+
+static inline msg_slot_t *channel_slot(msg_channel_t *channel, uint32_t seq) {
+    return (msg_slot_t *)(channel->slots + (seq & channel->mask) * channel->shm->stride);
+}
+
+static void channel_format(msg_channel_shm_t *shm, uint32_t slot_count, uint32_t slot_size) {
+    uint8_t *slots = (uint8_t *)shm + sizeof(msg_channel_shm_t);
+    uint32_t stride = channel_stride(slot_size);
+
+    memset(shm, 0, sizeof(msg_channel_shm_t));
+    shm->slot_count = slot_count;
+    shm->slot_size = slot_size;
+    shm->stride = stride;
+
+    /* Slot i is free for the send with sequence i */
+    for (uint32_t i = 0; i < slot_count; i++) {
+        msg_slot_t *slot = (msg_slot_t *)(slots + i * stride);
+        atomic_store_explicit_u32(&slot->seq, i, MEMORY_ORDER_RELAXED);
+    }
+
+    /* Attachers check the magic, so it goes last */
+    memory_fence_release();
+    shm->magic = MSG_CHANNEL_MAGIC;
+}
+
+static msg_channel_t *channel_open(void *base, msg_channel_shm_t *shm,
+                                   uint32_t map_size, int fd) {
+    msg_channel_t *channel = malloc(sizeof(msg_channel_t));
+    if (!channel) return NULL;
+
+    channel->shm = shm;
+    channel->slots = (uint8_t *)shm + sizeof(msg_channel_shm_t);
+    channel->mask = shm->slot_count - 1;
+    channel->base = base;
+    channel->map_size = map_size;
+    channel->fd = fd;
+    channel->rx_sem = NULL;
+    channel->tx_sem = NULL;
+
+#if !IPC_HAVE_MEMFD
+    channel->rx_sem = semaphore_create(0);
+    channel->tx_sem = semaphore_create(0);
+    if (!channel->rx_sem || !channel->tx_sem) {
+        if (channel->rx_sem) semaphore_destroy(channel->rx_sem);
+        if (channel->tx_sem) semaphore_destroy(channel->tx_sem);
+        free(channel);
+        return NULL;
+    }
+#endif
+
+    return channel;
+}
+
+/* Channel Wait/Notify
+ *
+ * The waiter sets its parked flag and re-checks the ring; the peer
+ * advances the ring and then checks the flag. With a full fence on both
+ * sides at least one of them sees the other, so a wakeup is never lost
+ * and a peer that finds the flag clear skips the scheduler entirely.
+ */
+#if IPC_HAVE_MEMFD
+static void ipc_futex(atomic_uint32_t *word, int op, uint32_t value, uint32_t timeout_ms) {
+    struct timespec ts = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_nsec = (long)(timeout_ms % 1000) * 1000000L
+    };
+    syscall(SYS_futex, (uint32_t *)&word->value, op, value,
+            timeout_ms == MSG_WAIT_FOREVER ? NULL : &ts, NULL, 0);
+}
+#endif
+
+static void channel_park(atomic_uint32_t *parked, void *sem, uint32_t timeout_ms) {
+#if IPC_HAVE_MEMFD
+    (void)sem;
+    /* Not FUTEX_PRIVATE: the flag may live in a mapping shared with
+     * another process */
+    ipc_futex(parked, FUTEX_WAIT, 1, timeout_ms);
+#else
+    (void)parked;
+    semaphore_wait(sem, timeout_ms);
+#endif
+}
+
+static void channel_notify(atomic_uint32_t *parked, void *sem) {
+    memory_fence_full();
+    if (!atomic_load_explicit_u32(parked, MEMORY_ORDER_RELAXED) ||
+        !atomic_exchange_explicit_u32(parked, 0, MEMORY_ORDER_ACQ_REL)) {
+        return;
+    }
+#if IPC_HAVE_MEMFD
+    (void)sem;
+    ipc_futex(parked, FUTEX_WAKE, 1, MSG_WAIT_FOREVER);
+#else
+    semaphore_post(sem);
+#endif
+}
+
+/* Sender: the slot at tail has been handed back. Receiver: it has been
+ * published. */
+static bool channel_ready(msg_channel_t *channel, bool tx) {
+    msg_channel_shm_t *shm = channel->shm;
+
+    if (tx) {
+        uint32_t tail = atomic_load_explicit_u32(&shm->tail, MEMORY_ORDER_RELAXED);
+        return atomic_load_explicit_u32(&channel_slot(channel, tail)->seq,
+                                        MEMORY_ORDER_ACQUIRE) == tail;
+    }
+
+    uint32_t head = atomic_load_explicit_u32(&shm->head, MEMORY_ORDER_RELAXED);
+    return atomic_load_explicit_u32(&channel_slot(channel, head)->seq,
+                                    MEMORY_ORDER_ACQUIRE) == head + 1;
+}
+
+static bool channel_tx_ready(void *arg) {
+    return channel_ready(arg, true);
+}
+
+static bool channel_rx_ready(void *arg) {
+    return channel_ready(arg, false);
+}
+
+static bool channel_wait(msg_channel_t *channel, bool tx, uint32_t timeout) {
+    atomic_uint32_t *parked = tx ? &channel->shm->tx_parked : &channel->shm->rx_parked;
+    void *sem = tx ? channel->tx_sem : channel->rx_sem;
+
+    if (channel_ready(channel, tx)) return true;
+    if (timeout == 0) return false;
+    if (ipc_spin(tx ? channel_tx_ready : channel_rx_ready, channel)) return true;
+
+    /* Posts left over from earlier timed-out waits only cause a re-check */
+    uint32_t start = get_system_ticks();
+    for (;;) {
+        atomic_store_explicit_u32(parked, 1, MEMORY_ORDER_RELAXED);
+        memory_fence_full();
+        if (channel_ready(channel, tx)) {
+            break;
+        }
+
+        uint32_t waited = ipc_elapsed_ms(start);
+        if (timeout != MSG_WAIT_FOREVER && waited >= timeout) {
+            atomic_store_explicit_u32(parked, 0, MEMORY_ORDER_RELAXED);
+            return false;
+        }
+        channel_park(parked, sem, timeout == MSG_WAIT_FOREVER ?
+                     MSG_WAIT_FOREVER : timeout - waited);
+    }
+
+    atomic_store_explicit_u32(parked, 0, MEMORY_ORDER_RELAXED);
+    return true;
+}
+
+/* Channel Lifecycle */
+msg_channel_t *msg_channel_create(uint32_t slot_count, uint32_t slot_size) {
+    if (slot_count == 0 || slot_count > (1u << 31)) return NULL;
+
+    slot_count = channel_round_count(slot_count);
+    uint32_t size = channel_region_size(slot_count, slot_size);
+    if (size == 0 || size > UINT32_MAX - CACHE_LINE_SIZE) return NULL;
+
+    void *base = malloc(size + CACHE_LINE_SIZE);
+    if (!base) return NULL;
+
+    msg_channel_shm_t *shm = (msg_channel_shm_t *)
+        (((uintptr_t)base + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+    channel_format(shm, slot_count, slot_size);
+
+    msg_channel_t *channel = channel_open(base, shm, 0, -1);
+    if (!channel) {
+        free(base);
+    }
+    return channel;
+}
+
+msg_channel_t *msg_channel_create_shared(uint32_t slot_count, uint32_t slot_size) {
+#if IPC_HAVE_MEMFD
+    if (slot_count == 0 || slot_count > (1u << 31)) return NULL;
+
+    slot_count = channel_round_count(slot_count);
+    uint32_t size = channel_region_size(slot_count, slot_size);
+    if (size == 0) return NULL;
+
+    int fd = memfd_create("msg_channel", MFD_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    channel_format(map, slot_count, slot_size);
+
+    msg_channel_t *channel = channel_open(map, map, size, fd);
+    if (!channel) {
+        munmap(map, size);
+        close(fd);
+    }
+    return channel;
+#else
+    (void)slot_count;
+    (void)slot_size;
+    return NULL;
+#endif
+}
+
+/* Map a channel created by msg_channel_create_shared() in another
+ * process. The fd is duplicated, so the caller keeps its own. */
+msg_channel_t *msg_channel_attach(int fd) {
+#if IPC_HAVE_MEMFD
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 ||
+        st.st_size < (off_t)sizeof(msg_channel_shm_t) || st.st_size > UINT32_MAX) {
+        return NULL;
+    }
+
+    uint32_t size = (uint32_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) return NULL;
+
+    msg_channel_shm_t *shm = map;
+    uint32_t magic = shm->magic;
+    memory_fence_acquire();
+    uint32_t count = shm->slot_count;
+    if (magic != MSG_CHANNEL_MAGIC || count == 0 || (count & (count - 1)) ||
+        shm->stride != channel_stride(shm->slot_size) ||
+        channel_region_size(count, shm->slot_size) != size) {
+        munmap(map, size);
+        return NULL;
+    }
+
+    int own_fd = dup(fd);
+    msg_channel_t *channel = own_fd < 0 ? NULL : channel_open(map, shm, size, own_fd);
+    if (!channel) {
+        if (own_fd >= 0) close(own_fd);
+        munmap(map, size);
+    }
+    return channel;
+#else
+    (void)fd;
+    return NULL;
+#endif
+}
+
+int msg_channel_fd(msg_channel_t *channel) {
+    return channel ? channel->fd : -1;
+}
+
+void msg_channel_delete(msg_channel_t *channel) {
+    if (!channel) return;
+
+#if IPC_HAVE_MEMFD
+    if (channel->map_size) {
+        munmap(channel->base, channel->map_size);
+        close(channel->fd);
+    } else {
+        free(channel->base);
+    }
+#else
+    semaphore_destroy(channel->rx_sem);
+    semaphore_destroy(channel->tx_sem);
+    free(channel->base);
+#endif
+    free(channel);
+}
+
+/* Zero-Copy Send */
+void *msg_channel_reserve(msg_channel_t *channel, uint32_t length, uint32_t timeout) {
+    if (!channel || length > channel->shm->slot_size) return NULL;
+    if (!channel_wait(channel, true, timeout)) return NULL;
+
+    uint32_t tail = atomic_load_explicit_u32(&channel->shm->tail, MEMORY_ORDER_RELAXED);
+    return channel_slot(channel, tail)->data;
+}
+
+int msg_channel_publish(msg_channel_t *channel, const message_t *msg) {
+    if (!channel || !msg || msg->length > channel->shm->slot_size) {
+        return IPC_ERR_INVALID;
+    }
+
+    msg_channel_shm_t *shm = channel->shm;
+    uint32_t tail = atomic_load_explicit_u32(&shm->tail, MEMORY_ORDER_RELAXED);
+    msg_slot_t *slot = channel_slot(channel, tail);
+
+    /* Only a slot handed back by the receiver can be published */
+    if (atomic_load_explicit_u32(&slot->seq, MEMORY_ORDER_ACQUIRE) != tail) {
+        return IPC_ERR_INVALID;
+    }
+
+    slot->type = msg->type;
+    slot->sender_id = msg->sender_id;
+    slot->receiver_id = msg->receiver_id;
+    slot->msg_id = msg->msg_id;
+    slot->length = msg->length;
+
+    atomic_store_explicit_u32(&slot->seq, tail + 1, MEMORY_ORDER_RELEASE);
+    atomic_store_explicit_u32(&shm->tail, tail + 1, MEMORY_ORDER_RELAXED);
+
+    channel_notify(&shm->rx_parked, channel->rx_sem);
+    return IPC_ERR_NONE;
+}
+
+/* Zero-Copy Receive */
+int msg_channel_acquire(msg_channel_t *channel, message_t *msg, uint32_t timeout) {
+    if (!channel || !msg) return IPC_ERR_INVALID;
+    if (!channel_wait(channel, false, timeout)) return IPC_ERR_TIMEOUT;
+
+    uint32_t head = atomic_load_explicit_u32(&channel->shm->head, MEMORY_ORDER_RELAXED);
+    msg_slot_t *slot = channel_slot(channel, head);
+
+    msg->type = (message_type_t)slot->type;
+    msg->sender_id = slot->sender_id;
+    msg->receiver_id = slot->receiver_id;
+    msg->msg_id = slot->msg_id;
+    msg->length = slot->length;
+    msg->data = slot->data;
+    return IPC_ERR_NONE;
+}
+
+void msg_channel_release(msg_channel_t *channel) {
+    if (!channel) return;
+
+    msg_channel_shm_t *shm = channel->shm;
+    uint32_t head = atomic_load_explicit_u32(&shm->head, MEMORY_ORDER_RELAXED);
+    msg_slot_t *slot = channel_slot(channel, head);
+
+    if (atomic_load_explicit_u32(&slot->seq, MEMORY_ORDER_RELAXED) != head + 1) {
+        return;
+    }
+
+    /* Free for the send one lap ahead */
+    atomic_store_explicit_u32(&slot->seq, head + shm->slot_count, MEMORY_ORDER_RELEASE);
+    atomic_store_explicit_u32(&shm->head, head + 1, MEMORY_ORDER_RELAXED);
+
+    channel_notify(&shm->tx_parked, channel->tx_sem);
+}
+
+/* Copying Send/Receive */
+int msg_channel_send(msg_channel_t *channel, const message_t *msg, uint32_t timeout) {
+    if (!channel || !msg || (msg->length && !msg->data)) return IPC_ERR_INVALID;
+    if (msg->length > channel->shm->slot_size) return IPC_ERR_TOO_LARGE;
+
+    void *payload = msg_channel_reserve(channel, msg->length, timeout);
+    if (!payload) return IPC_ERR_TIMEOUT;
+
+    memcpy(payload, msg->data, msg->length);
+    return msg_channel_publish(channel, msg);
+}
+
+/* msg->data and msg->length give the receive buffer. A message that does
+ * not fit is left in the channel. */
+int msg_channel_receive(msg_channel_t *channel, message_t *msg, uint32_t timeout) {
+    if (!channel || !msg || (msg->length && !msg->data)) return IPC_ERR_INVALID;
+
+    message_t slot_msg;
+    int err = msg_channel_acquire(channel, &slot_msg, timeout);
+    if (err != IPC_ERR_NONE) return err;
+
+    if (slot_msg.length > msg->length) {
+        return IPC_ERR_TOO_LARGE;
+    }
+
+    memcpy(msg->data, slot_msg.data, slot_msg.length);
+    slot_msg.data = msg->data;
+    *msg = slot_msg;
+
+    msg_channel_release(channel);
+    return IPC_ERR_NONE;
+}
+
+uint32_t msg_channel_count(msg_channel_t *channel) {
+    if (!channel) return 0;
+
+    uint32_t head = atomic_load_explicit_u32(&channel->shm->head, MEMORY_ORDER_ACQUIRE);
+    uint32_t tail = atomic_load_explicit_u32(&channel->shm->tail, MEMORY_ORDER_ACQUIRE);
+    return tail - head;
+}
+
+/* Multi-Waiter Wait/Notify
+ *
+ * An eventcount: a waiter registers, reads the epoch and re-checks its
+ * condition before sleeping on that epoch. A notifier makes the condition
+ * true, issues a full fence and calls ipc_wake(), which bumps the epoch
+ * and wakes everyone, but only if anyone is registered.
+ */
+static bool ipc_wait(atomic_uint32_t *waiters, atomic_uint32_t *epoch, void *sem,
+                     bool (*ready)(void *arg), void *arg, uint32_t timeout) {
+    if (ready(arg)) return true;
+    if (timeout == 0) return false;
+    if (ipc_spin(ready, arg)) return true;
+
+    bool ok = false;
+    uint32_t start = get_system_ticks();
+    atomic_fetch_add_explicit_u32(waiters, 1, MEMORY_ORDER_RELAXED);
+    for (;;) {
+        memory_fence_full();
+        uint32_t seen = atomic_load_explicit_u32(epoch, MEMORY_ORDER_ACQUIRE);
+        if (ready(arg)) {
+            ok = true;
+            break;
+        }
+
+        uint32_t waited = ipc_elapsed_ms(start);
+        if (timeout != MSG_WAIT_FOREVER && waited >= timeout) {
+            break;
+        }
+        uint32_t remaining = timeout == MSG_WAIT_FOREVER ? MSG_WAIT_FOREVER : timeout - waited;
+#if IPC_HAVE_MEMFD
+        (void)sem;
+        ipc_futex(epoch, FUTEX_WAIT_PRIVATE, seen, remaining);
+#else
+        (void)seen;
+        semaphore_wait(sem, remaining);
+#endif
+    }
+    atomic_fetch_sub_explicit_u32(waiters, 1, MEMORY_ORDER_RELAXED);
+    return ok;
+}
+
+static void ipc_wake(atomic_uint32_t *waiters, atomic_uint32_t *epoch, void *sem) {
+    uint32_t count = atomic_load_explicit_u32(waiters, MEMORY_ORDER_RELAXED);
+    if (count == 0) return;
+
+    atomic_fetch_add_explicit_u32(epoch, 1, MEMORY_ORDER_RELEASE);
+#if IPC_HAVE_MEMFD
+    (void)sem;
+    ipc_futex(epoch, FUTEX_WAKE_PRIVATE, INT32_MAX, MSG_WAIT_FOREVER);
+#else
+    while (count--) {
+        semaphore_post(sem);
+    }
+#endif
+}
+
+/* Broadcast Bus
+ *
+ * Entry seq holds the published sequence + 1. A publisher claims sequence
+ * t by advancing tail, but only once the entry's previous lap (t - depth)
+ * is fully published and no blocking subscriber still needs it. While it
+ * rewrites the entry, seq holds t itself, which no reader can mistake for
+ * a published message when depth >= 2.
+ *
+ * Readers copy an entry optimistically and validate seq afterwards, like
+ * a seqlock. Their payload reference is taken with an increment that
+ * fails on zero, which is safe on an overwritten entry because payloads
+ * are never returned to the heap while the bus exists.
+ */
+static msg_bus_t *default_bus = NULL;
+
+static inline msg_bus_entry_t *bus_entry(msg_bus_t *bus, uint32_t seq) {
+    return &bus->entries[seq & bus->mask];
+}
+
+static inline msg_payload_t *bus_payload(msg_bus_t *bus, uint32_t index) {
+    return (msg_payload_t *)(bus->pool + index * bus->payload_stride);
+}
+
+static bool payload_tryget(msg_payload_t *payload) {
+    uint32_t refs = atomic_load_explicit_u32(&payload->refs, MEMORY_ORDER_RELAXED);
+    while (refs != 0) {
+        if (atomic_compare_exchange_strong_explicit_u32(&payload->refs, &refs, refs + 1,
+                                                        MEMORY_ORDER_ACQUIRE,
+                                                        MEMORY_ORDER_RELAXED)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Publishers never run a blocking subscriber over: claiming t needs
+ * every MSG_SUB_BLOCK cursor above t - depth. The lowest cursor is cached
+ * and rescanned only when the cache says the ring is full. */
+static bool bus_gate_open(msg_bus_t *bus, uint32_t tail) {
+    uint32_t gate = atomic_load_explicit_u32(&bus->gate, MEMORY_ORDER_RELAXED);
+    if (tail - gate < bus->depth) return true;
+
+    gate = tail;
+    for (uint32_t i = 0; i < MSG_BUS_MAX_SUBS; i++) {
+        msg_sub_t *sub = &bus->subs[i];
+        if (!sub->active || sub->policy != MSG_SUB_BLOCK) continue;
+
+        uint32_t cursor = atomic_load_explicit_u32(&sub->cursor, MEMORY_ORDER_ACQUIRE);
+        if ((int32_t)(cursor - gate) < 0) {
+            gate = cursor;
+        }
+    }
+    atomic_store_explicit_u32(&bus->gate, gate, MEMORY_ORDER_RELAXED);
+    return tail - gate < bus->depth;
+}
+
+static bool bus_entry_free(msg_bus_t *bus, uint32_t tail) {
+    return atomic_load_explicit_u32(&bus_entry(bus, tail)->seq, MEMORY_ORDER_ACQUIRE) ==
+           tail - bus->depth + 1;
+}
+
+static bool bus_can_claim(void *arg) {
+    msg_bus_t *bus = arg;
+    uint32_t tail = atomic_load_explicit_u32(&bus->tail, MEMORY_ORDER_RELAXED);
+    return bus_entry_free(bus, tail) && bus_gate_open(bus, tail);
+}
+
+static bool bus_pool_ready(void *arg) {
+    msg_bus_t *bus = arg;
+    return *(msg_payload_t * volatile *)&bus->free_list != NULL;
+}
+
+static bool bus_sub_ready(void *arg) {
+    msg_sub_t *sub = arg;
+    msg_bus_t *bus = sub->bus;
+    uint32_t cursor = atomic_load_explicit_u32(&sub->cursor, MEMORY_ORDER_RELAXED);
+    uint32_t tail = atomic_load_explicit_u32(&bus->tail, MEMORY_ORDER_ACQUIRE);
+
+    if (tail == cursor) return false;
+    if (tail - cursor > bus->depth) return true;
+    if (sub->policy == MSG_SUB_LATEST) {
+        cursor = tail - 1;
+    }
+    return atomic_load_explicit_u32(&bus_entry(bus, cursor)->seq,
+                                    MEMORY_ORDER_ACQUIRE) == cursor + 1;
+}
+
+/* Bus Lifecycle */
+msg_bus_t *msg_bus_create(uint32_t depth, uint32_t max_payload, uint32_t pool_count) {
+    if (depth < 2 || depth > (1u << 30)) return NULL;
+
+    depth = channel_round_count(depth);
+    if (pool_count == 0) {
+        pool_count = depth + 2 * MSG_BUS_MAX_SUBS;
+    }
+    if (pool_count <= depth) return NULL;
+
+    uint32_t stride = offsetof(msg_payload_t, data) + max_payload;
+    stride = (stride + CACHE_LINE_SIZE - 1) & ~(uint32_t)(CACHE_LINE_SIZE - 1);
+    uint64_t size = sizeof(msg_bus_t) + (uint64_t)depth * sizeof(msg_bus_entry_t) +
+                    (uint64_t)pool_count * stride + CACHE_LINE_SIZE;
+    if (size > UINT32_MAX) return NULL;
+
+    void *base = malloc((size_t)size);
+    if (!base) return NULL;
+
+    msg_bus_t *bus = (msg_bus_t *)
+        (((uintptr_t)base + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+    memset(bus, 0, sizeof(msg_bus_t));
+    bus->base = base;
+    bus->entries = (msg_bus_entry_t *)(bus + 1);
+    bus->depth = depth;
+    bus->mask = depth - 1;
+    bus->max_payload = max_payload;
+    bus->pool = (uint8_t *)(bus->entries + depth);
+    bus->pool_count = pool_count;
+    bus->payload_stride = stride;
+
+    /* Entry i starts as if lap -1 had been published through it */
+    for (uint32_t i = 0; i < depth; i++) {
+        msg_bus_entry_t *entry = &bus->entries[i];
+        atomic_store_explicit_u32(&entry->seq, i - depth + 1, MEMORY_ORDER_RELAXED);
+        entry->payload = NULL;
+    }
+
+    for (uint32_t i = pool_count; i-- > 0;) {
+        msg_payload_t *payload = bus_payload(bus, i);
+        atomic_store_explicit_u32(&payload->refs, 0, MEMORY_ORDER_RELAXED);
+        payload->bus = bus;
+        payload->next_free = bus->free_list;
+        bus->free_list = payload;
+    }
+
+#if !IPC_HAVE_MEMFD
+    bus->rx_sem = semaphore_create(0);
+    bus->tx_sem = semaphore_create(0);
+    if (!bus->rx_sem || !bus->tx_sem) {
+        if (bus->rx_sem) semaphore_destroy(bus->rx_sem);
+        if (bus->tx_sem) semaphore_destroy(bus->tx_sem);
+        free(base);
+        return NULL;
+    }
+#endif
+
+    return bus;
+}
+
+/* Payloads still held by subscribers must not be used afterwards */
+void msg_bus_delete(msg_bus_t *bus) {
+    if (!bus) return;
+
+    if (default_bus == bus) {
+        default_bus = NULL;
+    }
+#if !IPC_HAVE_MEMFD
+    semaphore_destroy(bus->rx_sem);
+    semaphore_destroy(bus->tx_sem);
+#endif
+    free(bus->base);
+}
+
+void msg_bus_set_default(msg_bus_t *bus) {
+    default_bus = bus;
+}
+
+/* Subscriptions start at the next message published */
+msg_sub_t *msg_bus_subscribe(msg_bus_t *bus, msg_sub_policy_t policy) {
+    if (!bus || policy > MSG_SUB_LATEST) return NULL;
+
+    msg_sub_t *sub = NULL;
+
+    enter_critical();
+    for (uint32_t i = 0; i < MSG_BUS_MAX_SUBS; i++) {
+        if (!bus->subs[i].active) {
+            sub = &bus->subs[i];
+            break;
+        }
+    }
+    if (sub) {
+        sub->bus = bus;
+        sub->policy = policy;
+        sub->received = 0;
+        sub->dropped = 0;
+        atomic_store_explicit_u32(&sub->cursor,
+                                  atomic_load_explicit_u32(&bus->tail, MEMORY_ORDER_ACQUIRE),
+                                  MEMORY_ORDER_RELAXED);
+        memory_fence_full();
+        sub->active = true;
+    }
+    exit_critical();
+
+    return sub;
+}
+
+/* Payloads the subscriber still holds stay valid until put */
+void msg_bus_unsubscribe(msg_sub_t *sub) {
+    if (!sub || !sub->active) return;
+
+    msg_bus_t *bus = sub->bus;
+    enter_critical();
+    sub->active = false;
+    exit_critical();
+
+    /* A blocking subscriber may have been holding publishers back */
+    memory_fence_full();
+    ipc_wake(&bus->tx_waiters, &bus->tx_epoch, bus->tx_sem);
+}
+
+/* Payload References */
+void msg_payload_get(msg_payload_t *payload) {
+    if (!payload) return;
+    atomic_fetch_add_explicit_u32(&payload->refs, 1, MEMORY_ORDER_RELAXED);
+}
+
+void msg_payload_put(msg_payload_t *payload) {
+    if (!payload) return;
+    if (atomic_fetch_sub_explicit_u32(&payload->refs, 1, MEMORY_ORDER_ACQ_REL) != 1) return;
+
+    msg_bus_t *bus = payload->bus;
+    enter_critical();
+    payload->next_free = bus->free_list;
+    bus->free_list = payload;
+    exit_critical();
+
+    memory_fence_full();
+    ipc_wake(&bus->tx_waiters, &bus->tx_epoch, bus->tx_sem);
+}
+
+msg_payload_t *msg_bus_alloc(msg_bus_t *bus, uint32_t timeout) {
+    if (!bus) return NULL;
+
+    for (;;) {
+        enter_critical();
+        msg_payload_t *payload = bus->free_list;
+        if (payload) {
+            bus->free_list = payload->next_free;
+        }
+        exit_critical();
+
+        if (payload) {
+            atomic_store_explicit_u32(&payload->refs, 1, MEMORY_ORDER_RELAXED);
+            return payload;
+        }
+        if (!ipc_wait(&bus->tx_waiters, &bus->tx_epoch, bus->tx_sem,
+                      bus_pool_ready, bus, timeout)) {
+            return NULL;
+        }
+    }
+}
+
+/* Publish and Receive */
+int msg_bus_publish(msg_bus_t *bus, const message_t *msg, msg_payload_t *payload,
+                    uint32_t timeout) {
+    if (!payload) return IPC_ERR_INVALID;
+    if (!bus || !msg || payload->bus != bus) {
+        msg_payload_put(payload);
+        return IPC_ERR_INVALID;
+    }
+    if (msg->length > bus->max_payload) {
+        msg_payload_put(payload);
+        return IPC_ERR_TOO_LARGE;
+    }
+
+    uint32_t tail;
+    for (;;) {
+        tail = atomic_load_explicit_u32(&bus->tail, MEMORY_ORDER_RELAXED);
+        if (bus_entry_free(bus, tail) && bus_gate_open(bus, tail)) {
+            if (atomic_compare_exchange_strong_explicit_u32(&bus->tail, &tail, tail + 1,
+                                                            MEMORY_ORDER_ACQ_REL,
+                                                            MEMORY_ORDER_RELAXED)) {
+                break;
+            }
+            continue;
+        }
+        if (!ipc_wait(&bus->tx_waiters, &bus->tx_epoch, bus->tx_sem,
+                      bus_can_claim, bus, timeout)) {
+            msg_payload_put(payload);
+            return IPC_ERR_TIMEOUT;
+        }
+    }
+
+    msg_bus_entry_t *entry = bus_entry(bus, tail);
+    msg_payload_t *old = entry->payload;
+
+    /* Readers validating the old message see it change before its
+     * payload can go back to the pool */
+    atomic_store_explicit_u32(&entry->seq, tail, MEMORY_ORDER_RELAXED);
+    memory_fence_full();
+
+    entry->msg = *msg;
+    entry->msg.data = payload->data;
+    entry->payload = payload;
+    atomic_store_explicit_u32(&entry->seq, tail + 1, MEMORY_ORDER_RELEASE);
+
+    if (old) {
+        msg_payload_put(old);
+    }
+
+    /* One wakeup for every waiting subscriber, and for a publisher that
+     * was waiting for this entry's next lap */
+    memory_fence_full();
+    ipc_wake(&bus->rx_waiters, &bus->rx_epoch, bus->rx_sem);
+    ipc_wake(&bus->tx_waiters, &bus->tx_epoch, bus->tx_sem);
+    return IPC_ERR_NONE;
+}
+
+/* msg->data points into *payload, which the subscriber must put */
+int msg_bus_receive(msg_sub_t *sub, message_t *msg, msg_payload_t **payload,
+                    uint32_t timeout) {
+    if (!sub || !sub->active || !msg || !payload) return IPC_ERR_INVALID;
+
+    msg_bus_t *bus = sub->bus;
+    for (;;) {
+        uint32_t cursor = atomic_load_explicit_u32(&sub->cursor, MEMORY_ORDER_RELAXED);
+        uint32_t tail = atomic_load_explicit_u32(&bus->tail, MEMORY_ORDER_ACQUIRE);
+
+        /* Lapped: the entry at cursor has been claimed again, resume at
+         * the oldest message still in the ring */
+        uint32_t next = cursor;
+        if (tail - cursor > bus->depth) {
+            next = tail - bus->depth;
+        }
+        if (sub->policy == MSG_SUB_LATEST && tail - next > 1) {
+            next = tail - 1;
+        }
+        if (next != cursor) {
+            sub->dropped += next - cursor;
+            cursor = next;
+            atomic_store_explicit_u32(&sub->cursor, cursor, MEMORY_ORDER_RELEASE);
+        }
+
+        msg_bus_entry_t *entry = bus_entry(bus, cursor);
+        if (atomic_load_explicit_u32(&entry->seq, MEMORY_ORDER_ACQUIRE) == cursor + 1) {
+            message_t copy = entry->msg;
+            msg_payload_t *held = entry->payload;
+
+            if (payload_tryget(held)) {
+                memory_fence_full();
+                if (atomic_load_explicit_u32(&entry->seq, MEMORY_ORDER_RELAXED) == cursor + 1) {
+                    atomic_store_explicit_u32(&sub->cursor, cursor + 1, MEMORY_ORDER_RELEASE);
+                    if (sub->policy == MSG_SUB_BLOCK) {
+                        memory_fence_full();
+                        ipc_wake(&bus->tx_waiters, &bus->tx_epoch, bus->tx_sem);
+                    }
+                    sub->received++;
+                    *msg = copy;
+                    *payload = held;
+                    return IPC_ERR_NONE;
+                }
+                msg_payload_put(held);
+            }
+            /* Overwritten while reading, re-check against the new tail */
+            continue;
+        }
+
+        if (!ipc_wait(&bus->rx_waiters, &bus->rx_epoch, bus->rx_sem,
+                      bus_sub_ready, sub, timeout)) {
+            return IPC_ERR_TIMEOUT;
+        }
+    }
+}
+
+int msg_broadcast(message_t *msg, uint32_t timeout) {
+    msg_bus_t *bus = default_bus;
+
+    if (!bus || !msg || (msg->length && !msg->data)) return IPC_ERR_INVALID;
+    if (msg->length > bus->max_payload) return IPC_ERR_TOO_LARGE;
+
+    /* The one copy: every subscriber shares this payload */
+    msg_payload_t *payload = msg_bus_alloc(bus, timeout);
+    if (!payload) return IPC_ERR_TIMEOUT;
+
+    memcpy(payload->data, msg->data, msg->length);
+    return msg_bus_publish(bus, msg, payload, timeout);
+}
+
+/* Message Queue
+ *
+ * Every operation runs under the queue mutex. Blocked senders and
+ * receivers wait on eventcounts, so a send wakes all waiting receivers
+ * once and each re-checks its own filter.
+ */
+static void list_push(msg_queue_t *queue, msg_list_t *list, uint32_t index, int link) {
+    msg_node_t *node = &queue->nodes[index];
+
+    node->next[link] = MSG_NIL;
+    node->prev[link] = list->tail;
+    if (list->tail != MSG_NIL) {
+        queue->nodes[list->tail].next[link] = index;
+    } else {
+        list->head = index;
+    }
+    list->tail = index;
+    list->count++;
+}
+
+static void list_unlink(msg_queue_t *queue, msg_list_t *list, uint32_t index, int link) {
+    msg_node_t *node = &queue->nodes[index];
+
+    if (node->prev[link] != MSG_NIL) {
+        queue->nodes[node->prev[link]].next[link] = node->next[link];
+    } else {
+        list->head = node->next[link];
+    }
+    if (node->next[link] != MSG_NIL) {
+        queue->nodes[node->next[link]].prev[link] = node->prev[link];
+    } else {
+        list->tail = node->prev[link];
+    }
+    list->count--;
+}
+
+static uint32_t sender_hash(uint32_t sender_id) {
+    sender_id *= 0x9E3779B1u;
+    return sender_id ^ (sender_id >> 16);
+}
+
+/* Slot holding sender_id's list, or the free slot where it would go */
+static uint32_t sender_slot(msg_queue_t *queue, uint32_t sender_id) {
+    uint32_t i = sender_hash(sender_id) & queue->sender_mask;
+
+    while (queue->by_sender[i].list.count &&
+           queue->by_sender[i].sender_id != sender_id) {
+        i = (i + 1) & queue->sender_mask;
+    }
+    return i;
+}
+
+/* Backward-shift deletion keeps probe chains intact without tombstones */
+static void sender_slot_release(msg_queue_t *queue, uint32_t hole) {
+    uint32_t mask = queue->sender_mask;
+    uint32_t i = (hole + 1) & mask;
+
+    while (queue->by_sender[i].list.count) {
+        uint32_t home = sender_hash(queue->by_sender[i].sender_id) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            queue->by_sender[hole] = queue->by_sender[i];
+            queue->by_sender[i].list.count = 0;
+            hole = i;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static void msgq_insert(msg_queue_t *queue, const message_t *msg) {
+    uint32_t index = queue->free_head;
+    msg_node_t *node = &queue->nodes[index];
+
+    queue->free_head = node->next[MSG_LINK_FIFO];
+    node->msg = *msg;
+
+    list_push(queue, &queue->fifo, index, MSG_LINK_FIFO);
+    list_push(queue, &queue->by_type[msg->type], index, MSG_LINK_TYPE);
+
+    msg_sender_slot_t *slot = &queue->by_sender[sender_slot(queue, msg->sender_id)];
+    if (slot->list.count == 0) {
+        slot->sender_id = msg->sender_id;
+        slot->list.head = MSG_NIL;
+        slot->list.tail = MSG_NIL;
+    }
+    list_push(queue, &slot->list, index, MSG_LINK_SENDER);
+
+    queue->count++;
+}
+
+static void msgq_take(msg_queue_t *queue, uint32_t index, message_t *msg) {
+    msg_node_t *node = &queue->nodes[index];
+
+    *msg = node->msg;
+
+    list_unlink(queue, &queue->fifo, index, MSG_LINK_FIFO);
+    list_unlink(queue, &queue->by_type[node->msg.type], index, MSG_LINK_TYPE);
+
+    uint32_t slot = sender_slot(queue, node->msg.sender_id);
+    list_unlink(queue, &queue->by_sender[slot].list, index, MSG_LINK_SENDER);
+    if (queue->by_sender[slot].list.count == 0) {
+        sender_slot_release(queue, slot);
+    }
+
+    node->next[MSG_LINK_FIFO] = queue->free_head;
+    queue->free_head = index;
+    queue->count--;
+}
+
+/* Oldest message matching both keys: walk the shorter list */
+static uint32_t msgq_find_match(msg_queue_t *queue, const msg_match_t *match) {
+    msg_list_t *list = &queue->fifo;
+    int link = MSG_LINK_FIFO;
+
+    if (match->flags & MSG_MATCH_TYPE) {
+        list = &queue->by_type[match->type];
+        link = MSG_LINK_TYPE;
+    }
+    if (match->flags & MSG_MATCH_SENDER) {
+        msg_sender_slot_t *slot = &queue->by_sender[sender_slot(queue, match->sender_id)];
+        if (slot->list.count == 0) return MSG_NIL;
+        if (link == MSG_LINK_FIFO || slot->list.count < list->count) {
+            list = &slot->list;
+            link = MSG_LINK_SENDER;
+        }
+    }
+
+    for (uint32_t i = list->head; i != MSG_NIL; i = queue->nodes[i].next[link]) {
+        message_t *msg = &queue->nodes[i].msg;
+        if ((match->flags & MSG_MATCH_TYPE) && msg->type != match->type) continue;
+        if ((match->flags & MSG_MATCH_SENDER) && msg->sender_id != match->sender_id) continue;
+        return i;
+    }
+    return MSG_NIL;
+}
+
+typedef struct {
+    msg_queue_t *queue;
+    const msg_match_t *match;   /* NULL takes the oldest message */
+    msg_filter_t filter;        /* Fallback: scan in arrival order */
+    void *arg;
+} msg_select_t;
+
+static uint32_t msgq_select(msg_select_t *select) {
+    msg_queue_t *queue = select->queue;
+
+    if (select->filter) {
+        for (uint32_t i = queue->fifo.head; i != MSG_NIL;
+             i = queue->nodes[i].next[MSG_LINK_FIFO]) {
+            if (select->filter(&queue->nodes[i].msg, select->arg)) {
+                return i;
+            }
+        }
+        return MSG_NIL;
+    }
+    if (select->match) {
+        return msgq_find_match(queue, select->match);
+    }
+    return queue->fifo.head;
+}
+
+static bool msgq_select_ready(void *arg) {
+    msg_select_t *select = arg;
+
+    mutex_lock(select->queue->lock);
+    bool found = msgq_select(select) != MSG_NIL;
+    mutex_unlock(select->queue->lock);
+    return found;
+}
+
+static bool msgq_has_room(void *arg) {
+    msg_queue_t *queue = arg;
+    return *(volatile uint32_t *)&queue->count < queue->capacity;
+}
+
+static int msgq_receive(msg_select_t *select, message_t *msg, uint32_t timeout) {
+    msg_queue_t *queue = select->queue;
+
+    for (;;) {
+        mutex_lock(queue->lock);
+        uint32_t index = msgq_select(select);
+        if (index != MSG_NIL) {
+            msgq_take(queue, index, msg);
+            mutex_unlock(queue->lock);
+
+            memory_fence_full();
+            ipc_wake(&queue->tx_waiters, &queue->tx_epoch, queue->tx_sem);
+            return IPC_ERR_NONE;
+        }
+        mutex_unlock(queue->lock);
+
+        if (!ipc_wait(&queue->rx_waiters, &queue->rx_epoch, queue->rx_sem,
+                      msgq_select_ready, select, timeout)) {
+            return IPC_ERR_TIMEOUT;
+        }
+    }
+}
+
+msg_queue_t *msg_queue_create(uint32_t capacity) {
+    if (capacity == 0 || capacity > (1u << 30)) return NULL;
+
+    uint32_t table = channel_round_count(capacity * 2);
+    uint64_t size = sizeof(msg_queue_t) + (uint64_t)capacity * sizeof(msg_node_t) +
+                    (uint64_t)table * sizeof(msg_sender_slot_t) + CACHE_LINE_SIZE;
+    if (size > UINT32_MAX) return NULL;
+
+    void *base = malloc((size_t)size);
+    if (!base) return NULL;
+
+    msg_queue_t *queue = (msg_queue_t *)
+        (((uintptr_t)base + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+    memset(queue, 0, sizeof(msg_queue_t));
+    queue->base = base;
+    queue->nodes = (msg_node_t *)(queue + 1);
+    queue->capacity = capacity;
+    queue->by_sender = (msg_sender_slot_t *)(queue->nodes + capacity);
+    queue->sender_mask = table - 1;
+    memset(queue->by_sender, 0, table * sizeof(msg_sender_slot_t));
+
+    queue->fifo.head = queue->fifo.tail = MSG_NIL;
+    for (uint32_t t = 0; t < MSG_TYPE_COUNT; t++) {
+        queue->by_type[t].head = queue->by_type[t].tail = MSG_NIL;
+    }
+    for (uint32_t i = 0; i < capacity; i++) {
+        queue->nodes[i].next[MSG_LINK_FIFO] = i + 1 < capacity ? i + 1 : MSG_NIL;
+    }
+    queue->free_head = 0;
+
+    queue->lock = mutex_create();
+    if (!queue->lock) {
+        free(base);
+        return NULL;
+    }
+
+#if !IPC_HAVE_MEMFD
+    queue->rx_sem = semaphore_create(0);
+    queue->tx_sem = semaphore_create(0);
+    if (!queue->rx_sem || !queue->tx_sem) {
+        if (queue->rx_sem) semaphore_destroy(queue->rx_sem);
+        if (queue->tx_sem) semaphore_destroy(queue->tx_sem);
+        mutex_delete(queue->lock);
+        free(base);
+        return NULL;
+    }
+#endif
+
+    return queue;
+}
+
+void msg_queue_delete(msg_queue_t *queue) {
+    if (!queue) return;
+
+    mutex_delete(queue->lock);
+#if !IPC_HAVE_MEMFD
+    semaphore_destroy(queue->rx_sem);
+    semaphore_destroy(queue->tx_sem);
+#endif
+    free(queue->base);
+}
+
+/* The message is copied; msg->data is passed through as is */
+int msg_send(msg_queue_t *queue, message_t *msg, uint32_t timeout) {
+    if (!queue || !msg || (uint32_t)msg->type >= MSG_TYPE_COUNT) return IPC_ERR_INVALID;
+
+    for (;;) {
+        mutex_lock(queue->lock);
+        if (queue->count < queue->capacity) {
+            msgq_insert(queue, msg);
+            mutex_unlock(queue->lock);
+
+            memory_fence_full();
+            ipc_wake(&queue->rx_waiters, &queue->rx_epoch, queue->rx_sem);
+            return IPC_ERR_NONE;
+        }
+        mutex_unlock(queue->lock);
+
+        if (!ipc_wait(&queue->tx_waiters, &queue->tx_epoch, queue->tx_sem,
+                      msgq_has_room, queue, timeout)) {
+            return IPC_ERR_TIMEOUT;
+        }
+    }
+}
+
+int msg_receive(msg_queue_t *queue, message_t *msg, uint32_t timeout) {
+    if (!queue || !msg) return IPC_ERR_INVALID;
+
+    msg_select_t select = { .queue = queue };
+    return msgq_receive(&select, msg, timeout);
+}
+
+int msg_peek(msg_queue_t *queue, message_t *msg) {
+    if (!queue || !msg) return IPC_ERR_INVALID;
+
+    int err = IPC_ERR_EMPTY;
+    mutex_lock(queue->lock);
+    if (queue->fifo.head != MSG_NIL) {
+        *msg = queue->nodes[queue->fifo.head].msg;
+        err = IPC_ERR_NONE;
+    }
+    mutex_unlock(queue->lock);
+    return err;
+}
+
+/* Oldest message of a type and/or from a sender, without a scan */
+int msg_receive_match(msg_queue_t *queue, message_t *msg,
+                      const msg_match_t *match, uint32_t timeout) {
+    if (!queue || !msg || !match) return IPC_ERR_INVALID;
+    if ((match->flags & MSG_MATCH_TYPE) && (uint32_t)match->type >= MSG_TYPE_COUNT) {
+        return IPC_ERR_INVALID;
+    }
+
+    msg_select_t select = { .queue = queue, .match = match };
+    return msgq_receive(&select, msg, timeout);
+}
+
+/* Arbitrary filters are checked against every queued message in turn;
+ * use msg_receive_match() for type or sender selection */
+int msg_receive_filtered(msg_queue_t *queue, message_t *msg,
+                         msg_filter_t filter, void *arg, uint32_t timeout) {
+    if (!queue || !msg || !filter) return IPC_ERR_INVALID;
+
+    msg_select_t select = { .queue = queue, .filter = filter, .arg = arg };
+    return msgq_receive(&select, msg, timeout);
+}
+
+/* Event Groups */
+#if IPC_HAVE_MEMFD
+/* Per-thread futex word for event_group_wait_bits(). Setters wake it
+ * after leaving the critical section, by which time the waiter may have
+ * returned, so it must outlive the waiter's stack frame. */
+static __thread atomic_uint32_t event_wait_word;
+#else
+/* Per-task semaphore for event_group_wait_bits(), created on first use */
+static __thread void *event_wait_sem;
+#endif
+
+static bool event_satisfied(uint32_t flags, uint32_t bits, uint8_t operation) {
+    if (operation & EVENT_WAIT_ALL) {
+        return (flags & bits) == bits;
+    }
+    return (flags & bits) != 0;
+}
+
+static void event_unindex(event_group_t *group, uint32_t slot) {
+    uint32_t bits = group->waiters[slot]->bits;
+
+    while (bits) {
+        group->bit_waiters[__builtin_ctz(bits)] &= ~(1u << slot);
+        bits &= bits - 1;
+    }
+    group->waiters[slot] = NULL;
+    group->waiter_map &= ~(1u << slot);
+}
+
+/* Wake the thread behind a waiter's wait object once its state is set */
+static void event_wake(void *wait_object) {
+#if IPC_HAVE_MEMFD
+    atomic_uint32_t *word = wait_object;
+    atomic_fetch_add_explicit_u32(word, 1, MEMORY_ORDER_RELEASE);
+    ipc_futex(word, FUTEX_WAKE_PRIVATE, 1, MSG_WAIT_FOREVER);
+#else
+    semaphore_post(wait_object);
+#endif
+}
+
+static void event_overflow_unlink(event_group_t *group, event_waiter_t *waiter) {
+    if (waiter->prev) {
+        waiter->prev->next = waiter->next;
+    } else {
+        group->overflow = waiter->next;
+    }
+    if (waiter->next) {
+        waiter->next->prev = waiter->prev;
+    }
+}
+
+event_group_t *event_group_create(void) {
+    event_group_t *group = malloc(sizeof(event_group_t));
+    if (!group) return NULL;
+
+    memset(group, 0, sizeof(event_group_t));
+    return group;
+}
+
+/* Tasks still waiting on the group must not be left behind */
+void event_group_delete(event_group_t *group) {
+    free(group);
+}
+
+uint32_t event_group_set_bits(event_group_t *group, uint32_t bits) {
+    if (!group) return 0;
+
+    void *wake[EVENT_MAX_WAITERS];
+    uint32_t woken = 0;
+
+    enter_critical();
+
+    group->flags |= bits;
+    uint32_t flags = group->flags;
+
+    /* Only waiters indexed under a bit being set can become satisfied */
+    uint32_t candidates = 0;
+    for (uint32_t set = bits; set; set &= set - 1) {
+        candidates |= group->bit_waiters[__builtin_ctz(set)];
+    }
+
+    uint32_t clear = 0;
+    while (candidates) {
+        uint32_t slot = __builtin_ctz(candidates);
+        event_waiter_t *waiter = group->waiters[slot];
+        candidates &= candidates - 1;
+
+        if (!event_satisfied(flags, waiter->bits, waiter->operation)) continue;
+
+        /* Everything the wake needs is taken here: once state is set the
+         * waiter may return before it is woken */
+        waiter->result = flags;
+        if (waiter->operation & EVENT_CLEAR_ON_EXIT) {
+            clear |= waiter->bits;
+        }
+        event_unindex(group, slot);
+        wake[woken++] = waiter->sem;
+        atomic_store_explicit_u32(&waiter->state, 1, MEMORY_ORDER_RELEASE);
+    }
+
+    /* Overflow waiters are woken in place: each re-enters the critical
+     * section before returning, so it outlives the wake */
+    for (event_waiter_t *waiter = group->overflow, *next; waiter; waiter = next) {
+        next = waiter->next;
+        if (!(waiter->bits & bits) ||
+            !event_satisfied(flags, waiter->bits, waiter->operation)) {
+            continue;
+        }
+
+        waiter->result = flags;
+        if (waiter->operation & EVENT_CLEAR_ON_EXIT) {
+            clear |= waiter->bits;
+        }
+        event_overflow_unlink(group, waiter);
+        atomic_store_explicit_u32(&waiter->state, 1, MEMORY_ORDER_RELEASE);
+        event_wake(waiter->sem);
+    }
+
+    /* Cleared once every waiter has seen the bits */
+    group->flags &= ~clear;
+    flags = group->flags;
+
+#if IPC_HAVE_MEMFD
+    /* The wait objects are per thread, so waking after the waiter has
+     * returned only costs it a re-check */
+    exit_critical();
+    for (uint32_t i = 0; i < woken; i++) {
+        event_wake(wake[i]);
+    }
+#else
+    /* Posted together so the scheduler switches once, on exit */
+    for (uint32_t i = 0; i < woken; i++) {
+        event_wake(wake[i]);
+    }
+    exit_critical();
+#endif
+
+    return flags;
+}
+
+/* Returns the flags before clearing */
+uint32_t event_group_clear_bits(event_group_t *group, uint32_t bits) {
+    if (!group) return 0;
+
+    enter_critical();
+    uint32_t flags = group->flags;
+    group->flags = flags & ~bits;
+    exit_critical();
+
+    return flags;
+}
+
+/* Returns the flags that satisfied the wait, or the current flags on
+ * timeout. EVENT_WAIT_ALL waits for every bit, otherwise any bit. */
+uint32_t event_group_wait_bits(event_group_t *group, uint32_t bits,
+                               uint8_t operation, uint32_t timeout) {
+    if (!group || bits == 0) return 0;
+
+    event_waiter_t waiter;
+    atomic_store_explicit_u32(&waiter.state, 0, MEMORY_ORDER_RELAXED);
+    waiter.bits = bits;
+    waiter.operation = operation;
+    waiter.result = 0;
+    waiter.sem = NULL;
+
+#if IPC_HAVE_MEMFD
+    waiter.sem = &event_wait_word;
+#else
+    if (!event_wait_sem) {
+        event_wait_sem = semaphore_create(0);
+    }
+    waiter.sem = event_wait_sem;
+    if (!waiter.sem) {
+        timeout = 0;
+    }
+#endif
+
+    enter_critical();
+
+    uint32_t flags = group->flags;
+    if (event_satisfied(flags, bits, operation)) {
+        if (operation & EVENT_CLEAR_ON_EXIT) {
+            group->flags &= ~bits;
+        }
+        exit_critical();
+        return flags;
+    }
+    if (timeout == 0) {
+        exit_critical();
+        return flags;
+    }
+
+    /* Index under the waiter's bits, or queue unindexed once every slot
+     * is taken */
+    uint32_t slot = EVENT_MAX_WAITERS;
+    if (group->waiter_map != ~0u) {
+        slot = __builtin_ctz(~group->waiter_map);
+        group->waiter_map |= 1u << slot;
+        group->waiters[slot] = &waiter;
+        for (uint32_t set = bits; set; set &= set - 1) {
+            group->bit_waiters[__builtin_ctz(set)] |= 1u << slot;
+        }
+    } else {
+        waiter.prev = NULL;
+        waiter.next = group->overflow;
+        if (waiter.next) {
+            waiter.next->prev = &waiter;
+        }
+        group->overflow = &waiter;
+    }
+
+    exit_critical();
+
+    /* Posts left over from earlier timed-out waits only cause a re-check */
+    uint32_t start = get_system_ticks();
+    for (;;) {
+#if IPC_HAVE_MEMFD
+        /* Read before state: a setter bumps the word after setting it */
+        uint32_t seen = atomic_load_explicit_u32(&event_wait_word, MEMORY_ORDER_ACQUIRE);
+#endif
+        if (atomic_load_explicit_u32(&waiter.state, MEMORY_ORDER_ACQUIRE)) {
+            break;
+        }
+        uint32_t waited = ipc_elapsed_ms(start);
+        if (timeout != MSG_WAIT_FOREVER && waited >= timeout) {
+            break;
+        }
+        uint32_t remaining = timeout == MSG_WAIT_FOREVER ? MSG_WAIT_FOREVER : timeout - waited;
+#if IPC_HAVE_MEMFD
+        ipc_futex(&event_wait_word, FUTEX_WAIT_PRIVATE, seen, remaining);
+#else
+        semaphore_wait(waiter.sem, remaining);
+#endif
+    }
+
+    /* A setter that got here first has already unindexed us */
+    enter_critical();
+    if (!atomic_load_explicit_u32(&waiter.state, MEMORY_ORDER_ACQUIRE)) {
+        if (slot < EVENT_MAX_WAITERS) {
+            event_unindex(group, slot);
+        } else {
+            event_overflow_unlink(group, &waiter);
+        }
+        flags = group->flags;
+    } else {
+        flags = waiter.result;
+    }
+    exit_critical();
+
+    return flags;
+}
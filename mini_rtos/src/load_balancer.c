@@ -3,10 +3,91 @@
 #include <string.h>
 #include "async_ops.h"
 
-#define MAX_CORES 32
+#define MAX_CORES LB_MAX_CORES
+#define MAX_DOMAINS (MAX_CORES * LB_NUM_LEVELS)
+/* Overridable at build time so they can be tuned offline
+ * (see examples/lb_simulator.c)
+ */
+#ifndef THERMAL_THRESHOLD
 #define THERMAL_THRESHOLD 85
+#endif
+#ifndef MEMORY_PRESSURE_THRESHOLD
 #define MEMORY_PRESSURE_THRESHOLD 90
+#endif
+#ifndef LOAD_IMBALANCE_THRESHOLD
 #define LOAD_IMBALANCE_THRESHOLD 20
+#endif
+
+/* Decayed load tracking (PELT): 1 ms periods, y^32 = 1/2 */
+#define PELT_PERIOD_MS 1
+#define PELT_HALFLIFE 32
+#define PELT_SHIFT 10               // Averages kept in 1/1024ths of a score point
+#define MIGRATION_COST 64           // ms before a task/core pair may move back
+#define LB_MAX_TRACKED_TASKS 256
+
+/* Async metric updates expire after 100 ms; by then the next periodic
+ * sample has superseded them
+ */
+#define LB_METRICS_DEADLINE_MS 100
+
+/* Scheduling domain: the cores sharing one level, split into groups
+ * that are the child domains one level down (single cores at SMT)
+ */
+typedef struct {
+    uint8_t level;
+    uint8_t num_groups;
+    uint32_t span;                  // Cores in this domain
+    uint32_t groups[MAX_CORES];     // Group spans
+    uint64_t last_balance;
+} lb_domain_t;
+
+/* y^n in 0.32 fixed point for n < PELT_HALFLIFE */
+static const uint32_t pelt_y_inv[PELT_HALFLIFE] = {
+    0xffffffff, 0xfa83b2da, 0xf5257d14, 0xefe4b99a, 0xeac0c6e6, 0xe5b906e6,
+    0xe0ccdeeb, 0xdbfbb796, 0xd744fcc9, 0xd2a81d91, 0xce248c14, 0xc9b9bd85,
+    0xc5672a10, 0xc12c4cc9, 0xbd08a39e, 0xb8fbaf46, 0xb504f333, 0xb123f581,
+    0xad583ee9, 0xa9a15ab4, 0xa5fed6a9, 0xa2704302, 0x9ef5325f, 0x9b8d39b9,
+    0x9837f050, 0x94f3efe1, 0x91c3d373, 0x8ea4398a, 0x8b95c1e3, 0x88980e80,
+    0x85aac367, 0x82cd8698,
+};
+
+/* Decayed average of a held signal */
+typedef struct {
+    uint64_t last_update;           // ms
+    uint32_t avg;                   // << PELT_SHIFT
+    uint32_t sample;                // Value held since last_update
+} lb_pelt_t;
+
+/* Per-task tracking entry; key is task_id + 1, 0 when never used and
+ * LB_TASK_TOMBSTONE once untracked. Lookups probe past tombstones;
+ * inserts reuse the first one on the probe path.
+ */
+#define LB_TASK_TOMBSTONE UINT32_MAX
+
+typedef struct {
+    atomic_uint32_t key;
+    uint32_t core;
+    uint32_t prev_core;
+    uint64_t last_migration;
+    lb_pelt_t pelt;
+} lb_task_t;
+
+/* Domain tree built from an lb_topology_t */
+typedef struct {
+    lb_domain_t domains[MAX_DOMAINS];
+    uint32_t num_domains;
+    uint8_t core_domain[MAX_CORES][LB_NUM_LEVELS];
+} lb_topo_t;
+
+/* Default per-level parameters: tolerate more imbalance and balance
+ * less often the further apart the cores are
+ */
+static const lb_level_config_t default_level_config[LB_NUM_LEVELS] = {
+    [LB_LEVEL_SMT]     = { .imbalance_threshold = 10, .interval_ms = 4 },
+    [LB_LEVEL_LLC]     = { .imbalance_threshold = LOAD_IMBALANCE_THRESHOLD, .interval_ms = 8 },
+    [LB_LEVEL_PACKAGE] = { .imbalance_threshold = 35, .interval_ms = 32 },
+    [LB_LEVEL_SYSTEM]  = { .imbalance_threshold = 50, .interval_ms = 64 },
+};
 
 /* Global load balancer state */
 static struct {
@@ -17,9 +98,30 @@ static struct {
     atomic_uint32_t active_cores;
     atomic_uint32_t total_load;
     void *lock;
+    
+    // Per-core seqlocks over core_metrics and core_pelt; odd while a
+    // write is open
+    atomic_uint32_t metrics_seq[MAX_CORES];
+    lb_pelt_t core_pelt[MAX_CORES];
+    
+    // Per-task decayed load and migration history
+    lb_task_t tasks[LB_MAX_TRACKED_TASKS];
+    
+    // Last aggregate move into each core, for balance hysteresis
+    uint8_t pulled_from[MAX_CORES];
+    uint64_t pulled_at[MAX_CORES];
+    
+    // Topology, double buffered so placement can read it without the lock;
+    // per-buffer seqlocks, odd while lb_set_topology() rebuilds one
+    lb_topo_t topo_buf[2];
+    atomic_uint32_t topo_seq[2];
+    atomic_ptr_t topo;
+    lb_level_config_t level_config[LB_NUM_LEVELS];
 } lb_state;
 
 /* Initialize the load balancer */
+static void lb_register_async_handlers(void);
+
 bool lb_init(lb_config_t *config) {
     bool expected = false;
     if (!atomic_compare_exchange_strong_explicit_bool(
@@ -34,67 +136,392 @@ bool lb_init(lb_config_t *config) {
     atomic_store_explicit_u32(&lb_state.active_cores, 0, MEMORY_ORDER_RELEASE);
     atomic_store_explicit_u32(&lb_state.total_load, 0, MEMORY_ORDER_RELEASE);
     
+    atomic_store_explicit_ptr(&lb_state.topo, NULL, MEMORY_ORDER_RELEASE);
+    memcpy(lb_state.level_config, default_level_config, sizeof(default_level_config));
+    
     lb_state.lock = mutex_create();
+    lb_register_async_handlers();
     
     return true;
 }
 
-/* Calculate core load score based on multiple metrics */
-static uint32_t calculate_core_load(core_metrics_t *metrics) {
-    uint32_t cpu_score = atomic_load_explicit_u32(&metrics->cpu_usage, MEMORY_ORDER_ACQUIRE);
-    uint32_t mem_score = atomic_load_explicit_u32(&metrics->memory_pressure, MEMORY_ORDER_ACQUIRE);
-    uint32_t temp_score = atomic_load_explicit_u32(&metrics->temperature, MEMORY_ORDER_ACQUIRE);
-    uint32_t tasks = atomic_load_explicit_u32(&metrics->task_count, MEMORY_ORDER_ACQUIRE);
+/* Tear down the load balancer */
+void lb_shutdown(void) {
+    if (!atomic_load_explicit_bool(&lb_state.initialized, MEMORY_ORDER_ACQUIRE)) {
+        return;
+    }
     
-    return (cpu_score * 4 + mem_score * 2 + temp_score + tasks * 2) / 9;
+    if (lb_state.lock) {
+        mutex_destroy(lb_state.lock);
+    }
+    memset(&lb_state, 0, sizeof(lb_state));
 }
 
-/* Find least loaded core considering task requirements */
-static uint32_t find_best_core(task_requirements_t *task) {
-    uint32_t best_core = 0;
-    uint32_t min_load = UINT32_MAX;
-    uint32_t active_cores = atomic_load_explicit_u32(&lb_state.active_cores, MEMORY_ORDER_ACQUIRE);
+/* val * y^n */
+static uint32_t pelt_decay(uint32_t val, uint64_t n) {
+    if (n >= PELT_HALFLIFE * 32) {
+        return 0;
+    }
+    val >>= n / PELT_HALFLIFE;
+    return (uint32_t)(((uint64_t)val * pelt_y_inv[n % PELT_HALFLIFE]) >> 32);
+}
 
-    for (uint32_t i = 0; i < active_cores; i++) {
-        if (!(task->affinity_mask & (1 << i))) {
-            continue;
-        }
+/* Average after the held sample persisted until now */
+static uint32_t pelt_project(const lb_pelt_t *pelt, uint64_t now) {
+    uint64_t periods = (now - pelt->last_update) / PELT_PERIOD_MS;
+    uint32_t sample = pelt->sample << PELT_SHIFT;
+    
+    // avg' = sample + (avg - sample) * y^n
+    if (pelt->avg >= sample) {
+        return sample + pelt_decay(pelt->avg - sample, periods);
+    }
+    return sample - pelt_decay(sample - pelt->avg, periods);
+}
+
+/* Fold the held sample up to now, then hold the new one */
+static void pelt_update(lb_pelt_t *pelt, uint64_t now, uint32_t sample) {
+    if (pelt->last_update == 0) {
+        pelt->avg = sample << PELT_SHIFT;
+    } else {
+        pelt->avg = pelt_project(pelt, now);
+    }
+    pelt->sample = sample;
+    pelt->last_update = now;
+}
+
+/* Seqlock write side; writers to one core are rare and short, so they
+ * just spin for the odd count
+ */
+static void metrics_write_begin(uint32_t core_id) {
+    atomic_uint32_t *seq = &lb_state.metrics_seq[core_id];
+    uint32_t s;
+    
+    do {
+        s = atomic_load_explicit_u32(seq, MEMORY_ORDER_RELAXED) & ~1u;
+    } while (!atomic_compare_exchange_strong_explicit_u32(seq, &s, s + 1,
+                 MEMORY_ORDER_ACQUIRE, MEMORY_ORDER_RELAXED));
+    memory_fence_release();
+}
+
+static void metrics_write_end(uint32_t core_id) {
+    atomic_fetch_add_explicit_u32(&lb_state.metrics_seq[core_id], 1, MEMORY_ORDER_RELEASE);
+}
+
+/* Seqlock read side: retry until no writer overlapped the copy */
+void lb_read_core_metrics(uint32_t core_id, lb_core_snapshot_t *snap) {
+    core_metrics_t *metrics = &lb_state.core_metrics[core_id];
+    atomic_uint32_t *seq = &lb_state.metrics_seq[core_id];
+    lb_pelt_t pelt;
+    uint32_t s1, s2;
+    
+    do {
+        s1 = atomic_load_explicit_u32(seq, MEMORY_ORDER_ACQUIRE);
+        snap->cpu_usage = atomic_load_explicit_u32(&metrics->cpu_usage, MEMORY_ORDER_RELAXED);
+        snap->task_count = atomic_load_explicit_u32(&metrics->task_count, MEMORY_ORDER_RELAXED);
+        snap->memory_pressure = atomic_load_explicit_u32(&metrics->memory_pressure, MEMORY_ORDER_RELAXED);
+        snap->cache_misses = atomic_load_explicit_u32(&metrics->cache_misses, MEMORY_ORDER_RELAXED);
+        snap->temperature = atomic_load_explicit_u32(&metrics->temperature, MEMORY_ORDER_RELAXED);
+        snap->power_consumption = atomic_load_explicit_u32(&metrics->power_consumption, MEMORY_ORDER_RELAXED);
+        pelt = lb_state.core_pelt[core_id];
+        memory_fence_acquire();
+        s2 = atomic_load_explicit_u32(seq, MEMORY_ORDER_RELAXED);
+    } while ((s1 & 1) || s1 != s2);
+    
+    snap->load_avg = pelt.last_update ? pelt_project(&pelt, get_system_time_ms()) >> PELT_SHIFT : 0;
+    snap->load_sample = pelt.sample;
+}
+
+/* Instantaneous load score based on multiple metrics */
+static uint32_t instant_core_load(const lb_core_snapshot_t *snap) {
+    return (snap->cpu_usage * 4 + snap->memory_pressure * 2 +
+            snap->temperature + snap->task_count * 2) / 9;
+}
 
-        core_metrics_t *metrics = &lb_state.core_metrics[i];
-        uint32_t core_load = calculate_core_load(metrics);
+/* Load used for decisions: the decayed average, plus whatever was
+ * placed on the core since the last metrics sample
+ */
+static uint32_t calculate_core_load(const lb_core_snapshot_t *snap) {
+    uint32_t now_load = instant_core_load(snap);
+    
+    if (snap->load_sample == 0 && snap->load_avg == 0) {
+        return now_load;
+    }
+    return snap->load_avg + (now_load > snap->load_sample ? now_load - snap->load_sample : 0);
+}
+
+static uint32_t core_load(uint32_t core_id) {
+    lb_core_snapshot_t snap;
+    lb_read_core_metrics(core_id, &snap);
+    return calculate_core_load(&snap);
+}
+
+static bool snapshot_can_take(const lb_core_snapshot_t *snap) {
+    return snap->temperature < THERMAL_THRESHOLD &&
+           snap->memory_pressure < MEMORY_PRESSURE_THRESHOLD;
+}
+
+/* Topology seqlock read side: the current buffer, NULL if no topology
+ * was described. lb_set_topology() does not wait for readers, so it may
+ * start rebuilding the buffer under a slow reader; such a lookup is
+ * redone once topo_read_retry() reports the overlap.
+ */
+static lb_topo_t *topo_read_begin(uint32_t *seq) {
+    for (;;) {
+        lb_topo_t *topo = atomic_load_explicit_ptr(&lb_state.topo, MEMORY_ORDER_ACQUIRE);
+        if (!topo) {
+            return NULL;
+        }
         
-        // Check thermal constraints
-        if (atomic_load_explicit_u32(&metrics->temperature, MEMORY_ORDER_ACQUIRE) >= THERMAL_THRESHOLD) {
-            continue;
+        *seq = atomic_load_explicit_u32(&lb_state.topo_seq[topo - lb_state.topo_buf],
+                                        MEMORY_ORDER_ACQUIRE);
+        if (!(*seq & 1)) {
+            return topo;
         }
+    }
+}
+
+static bool topo_read_retry(lb_topo_t *topo, uint32_t seq) {
+    if (!topo) {
+        return false;
+    }
+    memory_fence_acquire();
+    return atomic_load_explicit_u32(&lb_state.topo_seq[topo - lb_state.topo_buf],
+                                    MEMORY_ORDER_RELAXED) != seq;
+}
 
-        // Check memory pressure
-        if (atomic_load_explicit_u32(&metrics->memory_pressure, MEMORY_ORDER_ACQUIRE) >= MEMORY_PRESSURE_THRESHOLD) {
+/* Current topology for callers holding lb_state.lock, which excludes
+ * lb_set_topology()
+ */
+static lb_topo_t *topo_locked(void) {
+    return atomic_load_explicit_ptr(&lb_state.topo, MEMORY_ORDER_ACQUIRE);
+}
+
+/* Mask of all active cores */
+static uint32_t active_mask(void) {
+    uint32_t active_cores = atomic_load_explicit_u32(&lb_state.active_cores, MEMORY_ORDER_ACQUIRE);
+    return active_cores >= 32 ? UINT32_MAX : (1u << active_cores) - 1;
+}
+
+/* Cores sharing the given level with core; every active core when no
+ * topology was described
+ */
+static uint32_t domain_span(uint32_t core, lb_level_t level) {
+    lb_topo_t *topo;
+    uint32_t span;
+    uint32_t seq;
+    
+    do {
+        topo = topo_read_begin(&seq);
+        span = topo ? topo->domains[topo->core_domain[core][level]].span : active_mask();
+    } while (topo_read_retry(topo, seq));
+    
+    return span;
+}
+
+static bool core_can_take(uint32_t core) {
+    lb_core_snapshot_t snap;
+    lb_read_core_metrics(core, &snap);
+    return snapshot_can_take(&snap);
+}
+
+/* Find least loaded eligible core within span */
+static bool find_best_core_in(task_requirements_t *task, uint32_t span, uint32_t *best_core) {
+    uint32_t min_load = UINT32_MAX;
+    
+    span &= task->affinity_mask;
+    while (span) {
+        uint32_t i = __builtin_ctz(span);
+        span &= span - 1;
+        
+        lb_core_snapshot_t snap;
+        lb_read_core_metrics(i, &snap);
+        if (!snapshot_can_take(&snap)) {
             continue;
         }
-
+        
+        uint32_t load = calculate_core_load(&snap);
+        
         // Consider task priority
         if (task->priority > 0) {
-            core_load = core_load * (10 - task->priority) / 10;
+            load = load * (10 - task->priority) / 10;
         }
+        
+        if (load < min_load) {
+            min_load = load;
+            *best_core = i;
+        }
+    }
+    
+    return min_load != UINT32_MAX;
+}
 
-        if (core_load < min_load) {
-            min_load = core_load;
-            best_core = i;
+/* Average load over the eligible cores of a group; UINT32_MAX if none */
+static uint32_t group_load(uint32_t group, uint32_t allowed) {
+    uint32_t total = 0;
+    uint32_t count = 0;
+    
+    group &= allowed;
+    while (group) {
+        uint32_t i = __builtin_ctz(group);
+        group &= group - 1;
+        
+        lb_core_snapshot_t snap;
+        lb_read_core_metrics(i, &snap);
+        if (snapshot_can_take(&snap)) {
+            total += calculate_core_load(&snap);
+            count++;
+        }
+    }
+    
+    return count ? total / count : UINT32_MAX;
+}
+
+/* Descend the domain tree through the idlest group at each level and
+ * return the span reached. The step count is capped so a read torn by
+ * a concurrent rebuild still ends before it is retried.
+ */
+static uint32_t descend_idlest(lb_topo_t *topo, task_requirements_t *task) {
+    lb_domain_t *domain = &topo->domains[topo->core_domain[0][LB_LEVEL_SYSTEM]];
+    
+    for (uint32_t step = 0; step < LB_NUM_LEVELS && domain->level > LB_LEVEL_SMT; step++) {
+        uint32_t best_group = 0;
+        uint32_t min_load = UINT32_MAX;
+        
+        for (uint32_t g = 0; g < domain->num_groups; g++) {
+            uint32_t load = group_load(domain->groups[g], task->affinity_mask);
+            if (load < min_load) {
+                min_load = load;
+                best_group = domain->groups[g];
+            }
+        }
+        
+        if (!best_group) {
+            break;
         }
+        domain = &topo->domains[topo->core_domain[__builtin_ctz(best_group)][domain->level - 1]];
     }
+    
+    return domain->span;
+}
 
+/* Find least loaded core considering task requirements */
+static uint32_t find_best_core(task_requirements_t *task) {
+    lb_topo_t *topo;
+    uint32_t best_core = 0;
+    uint32_t span;
+    uint32_t seq;
+    
+    do {
+        topo = topo_read_begin(&seq);
+        span = topo ? descend_idlest(topo, task) : active_mask();
+    } while (topo_read_retry(topo, seq));
+    
+    if (!find_best_core_in(task, span, &best_core)) {
+        find_best_core_in(task, active_mask(), &best_core);
+    }
     return best_core;
 }
 
-/* Balance a new task */
-uint32_t lb_balance_task(task_requirements_t *task) {
+/* Do two cores share a level? */
+static bool topo_shares(const lb_topology_t *topo, uint32_t a, uint32_t b, lb_level_t level) {
+    switch (level) {
+        case LB_LEVEL_SMT:
+            if (topo->core_id[a] != topo->core_id[b]) {
+                return false;
+            }
+            // fall through
+        case LB_LEVEL_LLC:
+            if (topo->llc_id[a] != topo->llc_id[b]) {
+                return false;
+            }
+            // fall through
+        case LB_LEVEL_PACKAGE:
+            return topo->package_id[a] == topo->package_id[b];
+        
+        default:
+            return true;
+    }
+}
+
+/* Describe the core topology */
+bool lb_set_topology(const lb_topology_t *desc) {
+    if (!desc || desc->num_cores == 0 || desc->num_cores > MAX_CORES) {
+        return false;
+    }
+    
     mutex_lock(lb_state.lock);
     
+    // Build into the buffer that isn't published. Readers still inside it
+    // from before the last swap see its count go odd and retry.
+    uint32_t spare = (topo_locked() == &lb_state.topo_buf[0]) ? 1 : 0;
+    lb_topo_t *topo = &lb_state.topo_buf[spare];
+    atomic_fetch_add_explicit_u32(&lb_state.topo_seq[spare], 1, MEMORY_ORDER_RELAXED);
+    memory_fence_release();
+    
+    // One domain per distinct set of cores at each level
+    topo->num_domains = 0;
+    for (uint32_t level = 0; level < LB_NUM_LEVELS; level++) {
+        for (uint32_t c = 0; c < desc->num_cores; c++) {
+            uint32_t d;
+            for (d = 0; d < topo->num_domains; d++) {
+                lb_domain_t *domain = &topo->domains[d];
+                if (domain->level == level &&
+                    topo_shares(desc, c, __builtin_ctz(domain->span), level)) {
+                    break;
+                }
+            }
+            
+            if (d == topo->num_domains) {
+                lb_domain_t *domain = &topo->domains[topo->num_domains++];
+                memset(domain, 0, sizeof(*domain));
+                domain->level = level;
+            }
+            topo->domains[d].span |= 1u << c;
+            topo->core_domain[c][level] = d;
+        }
+    }
+    
+    // Groups are the child domains, or single cores at the SMT level
+    for (uint32_t d = 0; d < topo->num_domains; d++) {
+        lb_domain_t *domain = &topo->domains[d];
+        uint32_t span = domain->span;
+        
+        while (span) {
+            uint32_t c = __builtin_ctz(span);
+            uint32_t group = (domain->level == LB_LEVEL_SMT) ? 1u << c :
+                topo->domains[topo->core_domain[c][domain->level - 1]].span;
+            
+            domain->groups[domain->num_groups++] = group;
+            span &= ~group;
+        }
+    }
+    
+    atomic_fetch_add_explicit_u32(&lb_state.topo_seq[spare], 1, MEMORY_ORDER_RELEASE);
+    atomic_store_explicit_ptr(&lb_state.topo, topo, MEMORY_ORDER_RELEASE);
+    atomic_store_explicit_u32(&lb_state.active_cores, desc->num_cores, MEMORY_ORDER_RELEASE);
+    mutex_unlock(lb_state.lock);
+    return true;
+}
+
+/* Override balancing parameters for one level */
+void lb_set_level_config(lb_level_t level, const lb_level_config_t *cfg) {
+    if (level >= LB_NUM_LEVELS || !cfg) {
+        return;
+    }
+    
+    mutex_lock(lb_state.lock);
+    lb_state.level_config[level] = *cfg;
+    mutex_unlock(lb_state.lock);
+}
+
+/* Balance a new task */
+uint32_t lb_balance_task(task_requirements_t *task) {
+    // Lock-free: decisions read seqlock snapshots and the published
+    // topology; only the target core's counters are written
     uint32_t target_core;
-    switch (lb_state.config.policy) {
+    switch (*(volatile lb_policy_t *)&lb_state.config.policy) {
         case LB_POLICY_ROUND_ROBIN: {
-            static atomic_uint32_t next_core = ATOMIC_VAR_INIT(0);
+            static atomic_uint32_t next_core;
             uint32_t active_cores = atomic_load_explicit_u32(&lb_state.active_cores, MEMORY_ORDER_ACQUIRE);
             target_core = atomic_fetch_add_explicit_u32(&next_core, 1, MEMORY_ORDER_ACQ_REL) % active_cores;
             break;
@@ -121,7 +548,9 @@ uint32_t lb_balance_task(task_requirements_t *task) {
             uint32_t active_cores = atomic_load_explicit_u32(&lb_state.active_cores, MEMORY_ORDER_ACQUIRE);
             
             for (uint32_t i = 0; i < active_cores; i++) {
-                uint32_t misses = atomic_load_explicit_u32(&lb_state.core_metrics[i].cache_misses, MEMORY_ORDER_ACQUIRE);
+                lb_core_snapshot_t snap;
+                lb_read_core_metrics(i, &snap);
+                uint32_t misses = snap.cache_misses;
                 if (misses < min_misses) {
                     min_misses = misses;
                     best_core = i;
@@ -138,7 +567,9 @@ uint32_t lb_balance_task(task_requirements_t *task) {
             uint32_t active_cores = atomic_load_explicit_u32(&lb_state.active_cores, MEMORY_ORDER_ACQUIRE);
             
             for (uint32_t i = 0; i < active_cores; i++) {
-                uint32_t temp = atomic_load_explicit_u32(&lb_state.core_metrics[i].temperature, MEMORY_ORDER_ACQUIRE);
+                lb_core_snapshot_t snap;
+                lb_read_core_metrics(i, &snap);
+                uint32_t temp = snap.temperature;
                 if (temp < min_temp && temp < THERMAL_THRESHOLD) {
                     min_temp = temp;
                     best_core = i;
@@ -159,16 +590,139 @@ uint32_t lb_balance_task(task_requirements_t *task) {
     }
 
     // Update core metrics
-    atomic_fetch_add_explicit_u32(&lb_state.core_metrics[target_core].task_count, 1, MEMORY_ORDER_ACQ_REL);
-    atomic_fetch_add_explicit_u32(&lb_state.core_metrics[target_core].cpu_usage, task->cpu_requirement, MEMORY_ORDER_ACQ_REL);
+    metrics_write_begin(target_core);
+    atomic_fetch_add_explicit_u32(&lb_state.core_metrics[target_core].task_count, 1, MEMORY_ORDER_RELAXED);
+    atomic_fetch_add_explicit_u32(&lb_state.core_metrics[target_core].cpu_usage, task->cpu_requirement, MEMORY_ORDER_RELAXED);
+    metrics_write_end(target_core);
     
     // Update statistics
     atomic_fetch_add_explicit_u64(&lb_state.stats.balanced_tasks, 1, MEMORY_ORDER_RELAXED);
     
-    mutex_unlock(lb_state.lock);
     return target_core;
 }
 
+/* Find (or with create, claim) a task's tracking slot */
+static lb_task_t *task_lookup(uint32_t task_id, bool create) {
+    uint32_t key = task_id + 1;
+    uint32_t start = (task_id * 2654435761u) % LB_MAX_TRACKED_TASKS;
+    
+    for (;;) {
+        lb_task_t *reuse = NULL;
+        uint32_t i;
+        
+        for (i = 0; i < LB_MAX_TRACKED_TASKS; i++) {
+            lb_task_t *task = &lb_state.tasks[(start + i) % LB_MAX_TRACKED_TASKS];
+            uint32_t cur = atomic_load_explicit_u32(&task->key, MEMORY_ORDER_ACQUIRE);
+            
+            if (cur == key) {
+                return task;
+            }
+            if (cur == LB_TASK_TOMBSTONE) {
+                if (!reuse) {
+                    reuse = task;
+                }
+                continue;
+            }
+            if (cur == 0) {
+                if (!create) {
+                    return NULL;
+                }
+                if (reuse) {
+                    break;
+                }
+                if (atomic_compare_exchange_strong_explicit_u32(&task->key, &cur, key,
+                        MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_ACQUIRE)) {
+                    return task;
+                }
+                if (cur == key) {
+                    return task;
+                }
+            }
+        }
+        
+        if (!create || !reuse) {
+            return NULL;
+        }
+        
+        // The key isn't on the probe path; take the earliest tombstone,
+        // rescanning if another insert got there first
+        uint32_t cur = LB_TASK_TOMBSTONE;
+        if (atomic_compare_exchange_strong_explicit_u32(&reuse->key, &cur, key,
+                MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_ACQUIRE)) {
+            return reuse;
+        }
+    }
+}
+
+/* Update a task's decayed load; called by the core running it */
+void lb_update_task_load(uint32_t task_id, uint32_t core_id, uint32_t util) {
+    lb_task_t *task = task_lookup(task_id, true);
+    if (!task) {
+        return;
+    }
+    
+    if (task->pelt.last_update == 0) {
+        task->core = core_id;
+        task->prev_core = core_id;
+    }
+    pelt_update(&task->pelt, get_system_time_ms(), util);
+}
+
+/* Free a task's slot, cleared so whoever reuses it starts fresh */
+void lb_untrack_task(uint32_t task_id) {
+    mutex_lock(lb_state.lock);
+    
+    lb_task_t *task = task_lookup(task_id, false);
+    if (task) {
+        task->core = 0;
+        task->prev_core = 0;
+        task->last_migration = 0;
+        memset(&task->pelt, 0, sizeof(task->pelt));
+        atomic_store_explicit_u32(&task->key, LB_TASK_TOMBSTONE, MEMORY_ORDER_RELEASE);
+    }
+    
+    mutex_unlock(lb_state.lock);
+}
+
+uint32_t lb_get_task_load(uint32_t task_id) {
+    lb_task_t *task = task_lookup(task_id, false);
+    
+    if (!task || task->pelt.last_update == 0) {
+        return 0;
+    }
+    return pelt_project(&task->pelt, get_system_time_ms()) >> PELT_SHIFT;
+}
+
+/* Move tasks and their decayed contribution between two cores; each
+ * core's count and average change inside one seqlock write
+ */
+static void metrics_move(uint32_t src_core, uint32_t dst_core, uint32_t tasks, uint32_t load) {
+    lb_pelt_t *src = &lb_state.core_pelt[src_core];
+    lb_pelt_t *dst = &lb_state.core_pelt[dst_core];
+    uint32_t delta = load << PELT_SHIFT;
+    
+    metrics_write_begin(src_core);
+    atomic_fetch_sub_explicit_u32(&lb_state.core_metrics[src_core].task_count, tasks, MEMORY_ORDER_RELAXED);
+    src->avg = src->avg > delta ? src->avg - delta : 0;
+    metrics_write_end(src_core);
+    
+    metrics_write_begin(dst_core);
+    atomic_fetch_add_explicit_u32(&lb_state.core_metrics[dst_core].task_count, tasks, MEMORY_ORDER_RELAXED);
+    dst->avg += delta;
+    metrics_write_end(dst_core);
+}
+
+/* Move tasks off a core whose individual loads aren't known, taking an
+ * even share of its decayed load with them
+ */
+static void metrics_move_share(uint32_t src_core, uint32_t dst_core, uint32_t tasks) {
+    lb_core_snapshot_t snap;
+    
+    lb_read_core_metrics(src_core, &snap);
+    metrics_move(src_core, dst_core, tasks,
+                 snap.task_count ? snap.load_avg * tasks / snap.task_count : 0);
+}
+
 /* Migrate an existing task */
 bool lb_migrate_task(uint32_t task_id, uint32_t src_core, uint32_t dst_core) {
     if (src_core == dst_core) {
@@ -183,10 +737,25 @@ bool lb_migrate_task(uint32_t task_id, uint32_t src_core, uint32_t dst_core) {
         mutex_unlock(lb_state.lock);
         return false;
     }
-
-    // Perform migration
-    atomic_fetch_sub_explicit_u32(&lb_state.core_metrics[src_core].task_count, 1, MEMORY_ORDER_ACQ_REL);
-    atomic_fetch_add_explicit_u32(&lb_state.core_metrics[dst_core].task_count, 1, MEMORY_ORDER_ACQ_REL);
+    
+    // Hysteresis: don't send a task straight back where it came from
+    uint64_t now = get_system_time_ms();
+    lb_task_t *task = task_lookup(task_id, false);
+    if (task && task->last_migration && dst_core == task->prev_core &&
+        now - task->last_migration < MIGRATION_COST) {
+        atomic_fetch_add_explicit_u64(&lb_state.stats.failed_balancing, 1, MEMORY_ORDER_RELAXED);
+        mutex_unlock(lb_state.lock);
+        return false;
+    }
+    
+    // Perform migration; an untracked task carries no decayed load
+    metrics_move(src_core, dst_core, 1, task ? lb_get_task_load(task_id) : 0);
+    
+    if (task) {
+        task->prev_core = src_core;
+        task->core = dst_core;
+        task->last_migration = now;
+    }
     
     // Update statistics
     atomic_fetch_add_explicit_u64(&lb_state.stats.total_migrations, 1, MEMORY_ORDER_RELAXED);
@@ -195,22 +764,54 @@ bool lb_migrate_task(uint32_t task_id, uint32_t src_core, uint32_t dst_core) {
     return true;
 }
 
-/* Update core metrics */
-void lb_update_metrics(uint32_t core_id, core_metrics_t *metrics) {
-    memcpy(&lb_state.core_metrics[core_id], metrics, sizeof(core_metrics_t));
+/* Plain copy of a caller's metrics, small enough to travel inline in
+ * an async op
+ */
+static void metrics_sample(const core_metrics_t *metrics, lb_core_snapshot_t *sample) {
+    sample->cpu_usage = atomic_load_explicit_u32(&metrics->cpu_usage, MEMORY_ORDER_RELAXED);
+    sample->task_count = atomic_load_explicit_u32(&metrics->task_count, MEMORY_ORDER_RELAXED);
+    sample->memory_pressure = atomic_load_explicit_u32(&metrics->memory_pressure, MEMORY_ORDER_RELAXED);
+    sample->cache_misses = atomic_load_explicit_u32(&metrics->cache_misses, MEMORY_ORDER_RELAXED);
+    sample->temperature = atomic_load_explicit_u32(&metrics->temperature, MEMORY_ORDER_RELAXED);
+    sample->power_consumption = atomic_load_explicit_u32(&metrics->power_consumption, MEMORY_ORDER_RELAXED);
+    sample->load_avg = 0;
+    sample->load_sample = 0;
+}
+
+/* Publish a sample and react to thermal/memory thresholds */
+static void update_metrics_sample(uint32_t core_id, const lb_core_snapshot_t *sample) {
+    core_metrics_t *metrics = &lb_state.core_metrics[core_id];
+    
+    metrics_write_begin(core_id);
+    atomic_store_explicit_u32(&metrics->cpu_usage, sample->cpu_usage, MEMORY_ORDER_RELAXED);
+    atomic_store_explicit_u32(&metrics->task_count, sample->task_count, MEMORY_ORDER_RELAXED);
+    atomic_store_explicit_u32(&metrics->memory_pressure, sample->memory_pressure, MEMORY_ORDER_RELAXED);
+    atomic_store_explicit_u32(&metrics->cache_misses, sample->cache_misses, MEMORY_ORDER_RELAXED);
+    atomic_store_explicit_u32(&metrics->temperature, sample->temperature, MEMORY_ORDER_RELAXED);
+    atomic_store_explicit_u32(&metrics->power_consumption, sample->power_consumption, MEMORY_ORDER_RELAXED);
+    pelt_update(&lb_state.core_pelt[core_id], get_system_time_ms(), instant_core_load(sample));
+    metrics_write_end(core_id);
     
     // Check for thermal throttling
-    if (metrics->temperature >= THERMAL_THRESHOLD && lb_state.config.thermal_throttling) {
+    if (sample->temperature >= THERMAL_THRESHOLD && lb_state.config.thermal_throttling) {
         atomic_fetch_add_explicit_u64(&lb_state.stats.thermal_throttling, 1, MEMORY_ORDER_RELAXED);
-        lb_handle_thermal_event(core_id, metrics->temperature);
+        lb_handle_thermal_event(core_id, sample->temperature);
     }
     
     // Check memory pressure
-    if (metrics->memory_pressure >= MEMORY_PRESSURE_THRESHOLD) {
-        lb_handle_memory_pressure(core_id, metrics->memory_pressure);
+    if (sample->memory_pressure >= MEMORY_PRESSURE_THRESHOLD) {
+        lb_handle_memory_pressure(core_id, sample->memory_pressure);
     }
 }
 
+/* Update core metrics */
+void lb_update_metrics(uint32_t core_id, core_metrics_t *metrics) {
+    lb_core_snapshot_t sample;
+    
+    metrics_sample(metrics, &sample);
+    update_metrics_sample(core_id, &sample);
+}
+
 /* Get current load balancing statistics */
 void lb_get_stats(lb_stats_t *stats) {
     memcpy(stats, &lb_state.stats, sizeof(lb_stats_t));
@@ -228,19 +829,184 @@ void lb_adjust_policy(lb_policy_t new_policy) {
     mutex_unlock(lb_state.lock);
 }
 
-/* Check system balance */
-bool lb_check_balance(void) {
+/* Busiest and idlest group of a domain by average load. The idlest is
+ * judged as group_load() does for placement, over the cores that can
+ * take work, so a thermally throttled or memory-pressured core neither
+ * hides behind cool siblings nor makes its group look idle. A group
+ * with no such core is never the idlest.
+ */
+static uint32_t domain_imbalance(lb_domain_t *domain, uint32_t *busiest, uint32_t *idlest) {
     uint32_t max_load = 0;
     uint32_t min_load = UINT32_MAX;
-    uint32_t active_cores = atomic_load_explicit_u32(&lb_state.active_cores, MEMORY_ORDER_ACQUIRE);
     
-    for (uint32_t i = 0; i < active_cores; i++) {
-        uint32_t load = calculate_core_load(&lb_state.core_metrics[i]);
-        max_load = (load > max_load) ? load : max_load;
-        min_load = (load < min_load) ? load : min_load;
+    for (uint32_t g = 0; g < domain->num_groups; g++) {
+        uint32_t group = domain->groups[g];
+        uint32_t total = 0;
+        uint32_t count = 0;
+        
+        while (group) {
+            uint32_t i = __builtin_ctz(group);
+            group &= group - 1;
+            total += core_load(i);
+            count++;
+        }
+        
+        uint32_t load = total / count;
+        if (load >= max_load) {
+            max_load = load;
+            *busiest = domain->groups[g];
+        }
+        
+        load = group_load(domain->groups[g], UINT32_MAX);
+        if (load < min_load) {
+            min_load = load;
+            *idlest = domain->groups[g];
+        }
     }
     
-    return (max_load - min_load) <= LOAD_IMBALANCE_THRESHOLD;
+    if (min_load == UINT32_MAX || max_load <= min_load) {
+        return 0;
+    }
+    return max_load - min_load;
+}
+
+/* Check system balance */
+bool lb_check_balance(void) {
+    lb_topo_t *topo;
+    uint32_t seq;
+    bool balanced;
+    
+    topo = topo_read_begin(&seq);
+    if (!topo) {
+        uint32_t max_load = 0;
+        uint32_t min_load = UINT32_MAX;
+        uint32_t active_cores = atomic_load_explicit_u32(&lb_state.active_cores, MEMORY_ORDER_ACQUIRE);
+        
+        for (uint32_t i = 0; i < active_cores; i++) {
+            uint32_t load = core_load(i);
+            max_load = (load > max_load) ? load : max_load;
+            min_load = (load < min_load) ? load : min_load;
+        }
+        
+        return (max_load - min_load) <= LOAD_IMBALANCE_THRESHOLD;
+    }
+    
+    // Each domain is judged against its own level's threshold
+    for (;;) {
+        balanced = true;
+        for (uint32_t d = 0; d < topo->num_domains && balanced; d++) {
+            lb_domain_t *domain = &topo->domains[d];
+            uint32_t busiest, idlest;
+            
+            if (domain->num_groups < 2) {
+                continue;
+            }
+            balanced = domain_imbalance(domain, &busiest, &idlest) <=
+                       lb_state.level_config[domain->level].imbalance_threshold;
+        }
+        
+        if (!topo_read_retry(topo, seq)) {
+            return balanced;
+        }
+        topo = topo_read_begin(&seq);
+    }
+}
+
+/* Core in span with the highest (or lowest) load */
+static uint32_t pick_core(uint32_t span, bool busiest) {
+    uint32_t best_core = __builtin_ctz(span);
+    uint32_t best_load = busiest ? 0 : UINT32_MAX;
+    
+    while (span) {
+        uint32_t i = __builtin_ctz(span);
+        span &= span - 1;
+        
+        if (!busiest && !core_can_take(i)) {
+            continue;
+        }
+        
+        uint32_t load = core_load(i);
+        if (busiest ? load >= best_load : load < best_load) {
+            best_load = load;
+            best_core = i;
+        }
+    }
+    return best_core;
+}
+
+/* Move tasks from the busiest to the idlest group of one domain */
+static uint32_t balance_domain(lb_domain_t *domain, uint32_t budget, uint64_t now) {
+    uint32_t busiest, idlest;
+    
+    if (domain_imbalance(domain, &busiest, &idlest) <=
+        lb_state.level_config[domain->level].imbalance_threshold) {
+        return 0;
+    }
+    
+    uint32_t src = pick_core(busiest, true);
+    uint32_t dst = pick_core(idlest, false);
+    if (src == dst || !core_can_take(dst)) {
+        return 0;
+    }
+    
+    // Don't reverse a move made within MIGRATION_COST
+    if (lb_state.pulled_from[src] == dst && now - lb_state.pulled_at[src] < MIGRATION_COST) {
+        return 0;
+    }
+    
+    uint32_t src_tasks = atomic_load_explicit_u32(&lb_state.core_metrics[src].task_count, MEMORY_ORDER_ACQUIRE);
+    uint32_t dst_tasks = atomic_load_explicit_u32(&lb_state.core_metrics[dst].task_count, MEMORY_ORDER_ACQUIRE);
+    if (src_tasks <= dst_tasks + 1) {
+        return 0;
+    }
+    
+    uint32_t tasks_to_migrate = (src_tasks - dst_tasks) / 2;
+    if (tasks_to_migrate > budget) {
+        tasks_to_migrate = budget;
+    }
+    
+    // Move the migrated share of the decayed load along with the tasks
+    metrics_move_share(src, dst, tasks_to_migrate);
+    atomic_fetch_add_explicit_u64(&lb_state.stats.total_migrations, tasks_to_migrate, MEMORY_ORDER_RELAXED);
+    
+    lb_state.pulled_from[dst] = src;
+    lb_state.pulled_at[dst] = now;
+    return tasks_to_migrate;
+}
+
+/* Hierarchical balance pass. Inner levels run first and more often, so
+ * load evens out inside a shared cache before anything crosses an LLC
+ * or package boundary.
+ */
+uint32_t lb_rebalance(void) {
+    uint64_t now = get_system_time_ms();
+    uint32_t budget = lb_state.config.max_migrations ? lb_state.config.max_migrations : UINT32_MAX;
+    uint32_t moved = 0;
+    
+    mutex_lock(lb_state.lock);
+    
+    lb_topo_t *topo = topo_locked();
+    if (!topo) {
+        mutex_unlock(lb_state.lock);
+        return 0;
+    }
+    
+    for (uint32_t level = 0; level < LB_NUM_LEVELS && moved < budget; level++) {
+        for (uint32_t d = 0; d < topo->num_domains && moved < budget; d++) {
+            lb_domain_t *domain = &topo->domains[d];
+            
+            if (domain->level != level || domain->num_groups < 2 ||
+                now - domain->last_balance < lb_state.level_config[level].interval_ms) {
+                continue;
+            }
+            
+            domain->last_balance = now;
+            moved += balance_domain(domain, budget - moved, now);
+        }
+    }
+    
+    mutex_unlock(lb_state.lock);
+    return moved;
 }
 
 /* Thermal management */
@@ -255,15 +1021,26 @@ void lb_handle_thermal_event(uint32_t core_id, uint32_t temperature) {
     uint32_t task_count = atomic_load_explicit_u32(&lb_state.core_metrics[core_id].task_count, MEMORY_ORDER_ACQUIRE);
     uint32_t active_cores = atomic_load_explicit_u32(&lb_state.active_cores, MEMORY_ORDER_ACQUIRE);
     
-    for (uint32_t i = 0; i < active_cores; i++) {
-        if (i == core_id) continue;
+    uint32_t searched = 1u << core_id;
+    
+    // Nearest cool core first: SMT sibling, then LLC, package, system
+    for (uint32_t level = 0; level < LB_NUM_LEVELS; level++) {
+        uint32_t span = domain_span(core_id, level) & ~searched;
+        searched |= span;
         
-        if (atomic_load_explicit_u32(&lb_state.core_metrics[i].temperature, MEMORY_ORDER_ACQUIRE) < THERMAL_THRESHOLD) {
-            // Migrate half of tasks to cooler core
-            uint32_t tasks_to_migrate = task_count / 2;
-            atomic_fetch_sub_explicit_u32(&lb_state.core_metrics[core_id].task_count, tasks_to_migrate, MEMORY_ORDER_ACQ_REL);
-            atomic_fetch_add_explicit_u32(&lb_state.core_metrics[i].task_count, tasks_to_migrate, MEMORY_ORDER_ACQ_REL);
-            break;
+        while (span) {
+            uint32_t i = __builtin_ctz(span);
+            span &= span - 1;
+            if (i >= active_cores) {
+                continue;
+            }
+            
+            if (atomic_load_explicit_u32(&lb_state.core_metrics[i].temperature, MEMORY_ORDER_ACQUIRE) < THERMAL_THRESHOLD) {
+                // Migrate half of tasks to cooler core
+                metrics_move_share(core_id, i, task_count / 2);
+                mutex_unlock(lb_state.lock);
+                return;
+            }
         }
     }
     
@@ -274,28 +1051,40 @@ void lb_handle_thermal_event(uint32_t core_id, uint32_t temperature) {
 void lb_handle_memory_pressure(uint32_t core_id, uint32_t pressure) {
     mutex_lock(lb_state.lock);
     
-    // Find core with lowest memory pressure
+    // Find core with lowest memory pressure, stopping at the nearest
+    // level that has one below the threshold
     uint32_t best_core = core_id;
     uint32_t min_pressure = pressure;
     uint32_t active_cores = atomic_load_explicit_u32(&lb_state.active_cores, MEMORY_ORDER_ACQUIRE);
+    uint32_t searched = 1u << core_id;
     
-    for (uint32_t i = 0; i < active_cores; i++) {
-        if (i == core_id) continue;
+    for (uint32_t level = 0; level < LB_NUM_LEVELS; level++) {
+        uint32_t span = domain_span(core_id, level) & ~searched;
+        searched |= span;
         
-        uint32_t core_pressure = atomic_load_explicit_u32(&lb_state.core_metrics[i].memory_pressure, MEMORY_ORDER_ACQUIRE);
-        if (core_pressure < min_pressure) {
-            min_pressure = core_pressure;
-            best_core = i;
+        while (span) {
+            uint32_t i = __builtin_ctz(span);
+            span &= span - 1;
+            if (i >= active_cores) {
+                continue;
+            }
+            
+            uint32_t core_pressure = atomic_load_explicit_u32(&lb_state.core_metrics[i].memory_pressure, MEMORY_ORDER_ACQUIRE);
+            if (core_pressure < min_pressure) {
+                min_pressure = core_pressure;
+                best_core = i;
+            }
+        }
+        
+        if (min_pressure < MEMORY_PRESSURE_THRESHOLD) {
+            break;
         }
     }
     
     if (best_core != core_id) {
         // Migrate some tasks to reduce memory pressure
         uint32_t task_count = atomic_load_explicit_u32(&lb_state.core_metrics[core_id].task_count, MEMORY_ORDER_ACQUIRE);
-        uint32_t tasks_to_migrate = task_count / 4;  // Migrate 25% of tasks
-        
-        atomic_fetch_sub_explicit_u32(&lb_state.core_metrics[core_id].task_count, tasks_to_migrate, MEMORY_ORDER_ACQ_REL);
-        atomic_fetch_add_explicit_u32(&lb_state.core_metrics[best_core].task_count, tasks_to_migrate, MEMORY_ORDER_ACQ_REL);
+        metrics_move_share(core_id, best_core, task_count / 4);  // Migrate 25% of tasks
     }
     
     mutex_unlock(lb_state.lock);
@@ -308,9 +1097,12 @@ typedef struct {
     uint32_t dst_core;
 } migration_params_t;
 
+/* Plain values rather than core_metrics_t, whose cache-line aligned
+ * atomics would push the params out of the op's inline storage
+ */
 typedef struct {
     uint32_t core_id;
-    core_metrics_t metrics;
+    lb_core_snapshot_t sample;
 } load_update_params_t;
 
 typedef struct {
@@ -350,35 +1142,44 @@ static void memory_complete(void* context, async_status_t status, void* result)
 }
 
 /* Async operation handlers */
-static bool handle_task_migration(void* params) {
+static bool handle_task_migration(void* params, void** result) {
     migration_params_t* mp = (migration_params_t*)params;
     return lb_migrate_task(mp->task_id, mp->src_core, mp->dst_core);
 }
 
-static bool handle_load_update(void* params) {
+static bool handle_load_update(void* params, void** result) {
     load_update_params_t* lp = (load_update_params_t*)params;
-    lb_update_metrics(lp->core_id, &lp->metrics);
+    update_metrics_sample(lp->core_id, &lp->sample);
     return true;
 }
 
-static bool handle_policy_change(void* params) {
+static bool handle_policy_change(void* params, void** result) {
     policy_change_params_t* pp = (policy_change_params_t*)params;
     lb_adjust_policy(pp->new_policy);
     return true;
 }
 
-static bool handle_thermal_adjust(void* params) {
+static bool handle_thermal_adjust(void* params, void** result) {
     thermal_params_t* tp = (thermal_params_t*)params;
     lb_handle_thermal_event(tp->core_id, tp->temperature);
     return true;
 }
 
-static bool handle_memory_rebalance(void* params) {
+static bool handle_memory_rebalance(void* params, void** result) {
     memory_params_t* mp = (memory_params_t*)params;
     lb_handle_memory_pressure(mp->core_id, mp->pressure);
     return true;
 }
 
+/* Bind the load balancer op types to their handlers */
+static void lb_register_async_handlers(void) {
+    async_register_handler(ASYNC_OP_TASK_MIGRATION, "lb_migrate", handle_task_migration);
+    async_register_handler(ASYNC_OP_LOAD_UPDATE, "lb_load_update", handle_load_update);
+    async_register_handler(ASYNC_OP_POLICY_CHANGE, "lb_policy", handle_policy_change);
+    async_register_handler(ASYNC_OP_THERMAL_ADJUST, "lb_thermal", handle_thermal_adjust);
+    async_register_handler(ASYNC_OP_MEMORY_REBALANCE, "lb_memory", handle_memory_rebalance);
+}
+
 /* Async public interfaces */
 bool lb_migrate_task_async(uint32_t task_id, uint32_t src_core, uint32_t dst_core) {
     migration_params_t params = {
@@ -387,19 +1188,66 @@ bool lb_migrate_task_async(uint32_t task_id, uint32_t src_core, uint32_t dst_cor
         .dst_core = dst_core
     };
     
-    uint32_t op_id = async_submit(ASYNC_OP_TASK_MIGRATION, &params, sizeof(params),
-                                 migration_complete, NULL, get_system_time_ms() + 1000, 8);
-    return op_id != 0;
+    async_future_t future = async_submit(ASYNC_OP_TASK_MIGRATION, &params, sizeof(params),
+                                         migration_complete, NULL, get_system_time_ms() + 1000, 8);
+    async_future_release(future);
+    return ASYNC_FUTURE_VALID(future);
 }
 
 void lb_update_metrics_async(uint32_t core_id, core_metrics_t* metrics) {
     load_update_params_t params = {
         .core_id = core_id
     };
-    memcpy(&params.metrics, metrics, sizeof(core_metrics_t));
+    metrics_sample(metrics, &params.sample);
+    
+    async_future_t future = async_submit(ASYNC_OP_LOAD_UPDATE, &params, sizeof(params),
+                                         NULL, NULL, get_system_time_ms() + LB_METRICS_DEADLINE_MS, 5);
+    if (!ASYNC_FUTURE_VALID(future)) {
+        atomic_fetch_add_explicit_u64(&lb_state.stats.dropped_updates, 1, MEMORY_ORDER_RELAXED);
+    }
+    async_future_release(future);
+}
+
+/* One update per core goes out as a single batch, with one wakeup */
+#define LB_METRICS_BATCH LB_MAX_CORES
+
+/* Returns how many updates were queued; the rest are counted as dropped */
+uint32_t lb_update_metrics_batch_async(const uint32_t* core_ids, core_metrics_t* metrics, uint32_t count) {
+    load_update_params_t params[LB_METRICS_BATCH];
+    async_request_t reqs[LB_METRICS_BATCH];
+    uint64_t deadline = get_system_time_ms() + LB_METRICS_DEADLINE_MS;
+    uint32_t submitted = 0;
     
-    async_submit(ASYNC_OP_LOAD_UPDATE, &params, sizeof(params),
-                NULL, NULL, get_system_time_ms() + 100, 5);
+    // Params are copied at submit; only more than one update per core
+    // needs a second pass through the window
+    for (uint32_t base = 0; base < count; base += LB_METRICS_BATCH) {
+        uint32_t n = count - base < LB_METRICS_BATCH ? count - base : LB_METRICS_BATCH;
+        
+        for (uint32_t i = 0; i < n; i++) {
+            params[i].core_id = core_ids[base + i];
+            metrics_sample(&metrics[base + i], &params[i].sample);
+            reqs[i] = (async_request_t){
+                .type = ASYNC_OP_LOAD_UPDATE,
+                .params = &params[i],
+                .param_size = sizeof(params[i]),
+                .deadline = deadline,
+                .priority = 5
+            };
+        }
+        uint32_t queued = async_submit_batch(reqs, n, NULL);
+        submitted += queued;
+        
+        // Op pool or queue full: later chunks would fail the same way
+        if (queued < n) {
+            break;
+        }
+    }
+    
+    if (submitted < count) {
+        atomic_fetch_add_explicit_u64(&lb_state.stats.dropped_updates, count - submitted,
+                                      MEMORY_ORDER_RELAXED);
+    }
+    return submitted;
 }
 
 void lb_adjust_policy_async(lb_policy_t new_policy, bool force_update) {
@@ -408,8 +1256,8 @@ void lb_adjust_policy_async(lb_policy_t new_policy, bool force_update) {
         .force_update = force_update
     };
     
-    async_submit(ASYNC_OP_POLICY_CHANGE, &params, sizeof(params),
-                NULL, NULL, get_system_time_ms() + 500, 6);
+    async_future_release(async_submit(ASYNC_OP_POLICY_CHANGE, &params, sizeof(params),
+                                      NULL, NULL, get_system_time_ms() + 500, 6));
 }
 
 void lb_handle_thermal_event_async(uint32_t core_id, uint32_t temperature, bool emergency) {
@@ -420,8 +1268,8 @@ void lb_handle_thermal_event_async(uint32_t core_id, uint32_t temperature, bool
     };
     
     uint32_t priority = emergency ? 9 : 7;
-    async_submit(ASYNC_OP_THERMAL_ADJUST, &params, sizeof(params),
-                thermal_complete, NULL, get_system_time_ms() + 200, priority);
+    async_future_release(async_submit(ASYNC_OP_THERMAL_ADJUST, &params, sizeof(params),
+                                      thermal_complete, NULL, get_system_time_ms() + 200, priority));
 }
 
 void lb_handle_memory_pressure_async(uint32_t core_id, uint32_t pressure, bool force_rebalance) {
@@ -432,6 +1280,6 @@ void lb_handle_memory_pressure_async(uint32_t core_id, uint32_t pressure, bool f
     };
     
     uint32_t priority = force_rebalance ? 8 : 6;
-    async_submit(ASYNC_OP_MEMORY_REBALANCE, &params, sizeof(params),
-                memory_complete, NULL, get_system_time_ms() + 300, priority);
+    async_future_release(async_submit(ASYNC_OP_MEMORY_REBALANCE, &params, sizeof(params),
+                                      memory_complete, NULL, get_system_time_ms() + 300, priority));
 }
@@ -166,6 +166,18 @@ uint32_t atomic_fetch_add_explicit_u32(atomic_uint32_t *obj, uint32_t value, mem
     return old_val;
 }
 
+uint64_t atomic_fetch_add_explicit_u64(atomic_uint64_t *obj, uint64_t value, memory_order_t order) {
+    uint64_t old_val, new_val;
+    
+    do {
+        old_val = atomic_load_explicit_u64(obj, MEMORY_ORDER_RELAXED);
+        new_val = old_val + value;
+    } while (!atomic_compare_exchange_strong_explicit_u64(obj, &old_val, new_val,
+                                                        order, MEMORY_ORDER_RELAXED));
+    
+    return old_val;
+}
+
 uint32_t atomic_fetch_sub_explicit_u32(atomic_uint32_t *obj, uint32_t value, memory_order_t order) {
     uint32_t old_val, new_val;
     
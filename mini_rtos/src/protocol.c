@@ -1,6 +1,10 @@
 #include "protocol.h"
 #include "rtos_core.h"
+#include "timer.h"
+#include "systick.h"
+#include "crc32c.h"
 #include <string.h>
+#include <stdlib.h>
 
 /* Static Protocol Manager Instance */
 static proto_manager_t proto_manager = {
@@ -9,22 +13,79 @@ static proto_manager_t proto_manager = {
     .initialized = false
 };
 
-/* CRC-32 Lookup Table */
-static const uint32_t crc32_table[256] = {
-    0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA,
-    0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
-    /* ... Add complete CRC table here ... */
-};
+/* Per-Protocol Transmit Queue */
+typedef struct {
+    proto_frame_t *frame;
+    proto_tx_callback_t callback;
+    void *context;
+} proto_tx_entry_t;
+
+typedef struct {
+    proto_tx_entry_t ring[PROTO_TXQ_DEPTH];
+    uint32_t head;              /* Next frame to send */
+    uint32_t tail;              /* Next free slot */
+    uint32_t attempts;          /* Rejections of the head frame */
+    bool busy;                  /* A context is pushing frames to the handler */
+    bool backoff;               /* Waiting for retry_timer */
+    bool closing;               /* Unregistering; refuse sends and drain */
+    timer_t *retry_timer;
+    proto_tx_stats_t stats;
+} proto_txq_t;
+
+#define PROTO_TXQ_MASK (PROTO_TXQ_DEPTH - 1)
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+static proto_txq_t proto_txq[PROTO_MAX_TYPES];
+
+/* Per-Protocol Receive State */
+typedef struct {
+    proto_rx_handler_t handler;
+    void *context;
+    bool busy;                  /* A context is polling the handler */
+    proto_rx_stats_t stats;
+} proto_rxq_t;
+
+static proto_rxq_t proto_rxq[PROTO_MAX_TYPES];
+
+static void proto_tx_close(proto_txq_t *q);
+
+
+static void proto_frame_free_segs(proto_frame_t *frame) {
+    proto_seg_t *seg = frame->segs;
+    
+    while (seg) {
+        proto_seg_t *next = seg->next;
+        proto_buf_put(seg->buf);
+        free(seg);
+        seg = next;
+    }
+    frame->segs = frame->segs_tail = NULL;
+    frame->seg_count = 0;
+    frame->seg_length = 0;
+}
+
+/* Bytes of buffer in front of data */
+static uint32_t proto_frame_headroom(const proto_frame_t *frame) {
+    return frame->buffer ? (uint32_t)(frame->data - frame->buffer) : 0;
+}
 
 /* Initialize Protocol Manager */
 void proto_init(void) {
     if (proto_manager.initialized) return;
     
+    /* Pick the checksum implementation before anything can send */
+    crc32c_init();
+    
     enter_critical();
     
     proto_manager.handlers = ht_create(16, ht_hash_int, ht_compare_int);
     proto_manager.active_protocols = 0;
     proto_manager.initialized = true;
+    memset(proto_txq, 0, sizeof(proto_txq));
+    memset(proto_rxq, 0, sizeof(proto_rxq));
     
     exit_critical();
 }
@@ -33,6 +94,16 @@ void proto_init(void) {
 void proto_shutdown(void) {
     if (!proto_manager.initialized) return;
     
+    /* Complete anything still queued before the handlers go away */
+    for (int type = 0; type < PROTO_MAX_TYPES; type++) {
+        proto_tx_close(&proto_txq[type]);
+        if (proto_txq[type].retry_timer) {
+            timer_stop(proto_txq[type].retry_timer);
+            timer_destroy(proto_txq[type].retry_timer);
+            proto_txq[type].retry_timer = NULL;
+        }
+    }
+    
     enter_critical();
     
     /* Free all registered handlers */
@@ -46,7 +117,13 @@ void proto_shutdown(void) {
 
 /* Register Protocol Handler */
 bool proto_register(protocol_type_t type, proto_handler_t *handler) {
-    if (!proto_manager.initialized || !handler) return false;
+    if (!proto_manager.initialized || !handler || type >= PROTO_MAX_TYPES) return false;
+    
+    proto_txq_t *q = &proto_txq[type];
+    if (!q->retry_timer) {
+        q->retry_timer = timer_create(TIMER_ONESHOT, 0);
+        if (!q->retry_timer) return false;
+    }
     
     enter_critical();
     
@@ -55,6 +132,8 @@ bool proto_register(protocol_type_t type, proto_handler_t *handler) {
                            handler);
     if (success) {
         proto_manager.active_protocols++;
+        q->closing = false;
+        q->backoff = false;
         if (handler->init) {
             handler->init(handler->config);
         }
@@ -66,7 +145,14 @@ bool proto_register(protocol_type_t type, proto_handler_t *handler) {
 
 /* Unregister Protocol Handler */
 bool proto_unregister(protocol_type_t type) {
-    if (!proto_manager.initialized) return false;
+    if (!proto_manager.initialized || type >= PROTO_MAX_TYPES) return false;
+    
+    proto_txq_t *q = &proto_txq[type];
+    if (q->retry_timer) {
+        timer_stop(q->retry_timer);
+        q->backoff = false;
+    }
+    proto_tx_close(q);
     
     enter_critical();
     
@@ -86,38 +172,313 @@ proto_handler_t *proto_get_handler(protocol_type_t type) {
     return ht_get(proto_manager.handlers, (void*)(uintptr_t)type);
 }
 
-/* Send Protocol Frame */
-bool proto_send(protocol_type_t type, proto_frame_t *frame) {
+/* Transmit Queues
+ *
+ * Sends are queued per protocol and pushed to the handler outside any
+ * critical section; the critical section only guards the ring indices.
+ * One context at a time owns transmission (busy). A rejected frame is
+ * retried from a one-shot timer with exponential backoff.
+ */
+
+static bool proto_tx_transmit_one(proto_handler_t *handler, proto_frame_t *frame) {
+    if (frame->segs) {
+        /* proto_send_async() linearized it unless the gather list fits */
+        proto_iovec_t iov[PROTO_MAX_IOV];
+        uint32_t iov_count = proto_frame_to_iovec(frame, iov, PROTO_MAX_IOV);
+        return handler->send_gather(frame, iov, iov_count);
+    }
+    return handler->send(frame);
+}
+
+/* Returns how many frames from the front of batch were accepted */
+static uint32_t proto_tx_transmit(proto_handler_t *handler, proto_frame_t **batch, uint32_t count) {
+    if (handler->send_batch) {
+        uint32_t sent = handler->send_batch(batch, count);
+        return sent < count ? sent : count;
+    }
+    
+    uint32_t sent = 0;
+    while (sent < count && proto_tx_transmit_one(handler, batch[sent])) {
+        sent++;
+    }
+    return sent;
+}
+
+static uint32_t proto_tx_backoff_ms(proto_handler_t *handler, uint32_t attempts) {
+    uint32_t limit = handler->timeout_ms ? handler->timeout_ms : PROTO_TX_BACKOFF_MAX_MS;
+    uint32_t shift = attempts - 1;
+    
+    if (shift >= 31 || (PROTO_TX_BACKOFF_MIN_MS << shift) > limit) {
+        return limit;
+    }
+    return PROTO_TX_BACKOFF_MIN_MS << shift;
+}
+
+/* Complete every queued frame unsuccessfully. While another context owns
+ * transmission the frames are left to it; it drains the queue when it
+ * lets go if the queue is closing.
+ */
+static void proto_tx_fail_all(proto_txq_t *q) {
+    for (;;) {
+        enter_critical();
+        if (q->head == q->tail || q->busy) {
+            exit_critical();
+            return;
+        }
+        proto_tx_entry_t entry = q->ring[q->head & PROTO_TXQ_MASK];
+        q->head++;
+        q->attempts = 0;
+        q->stats.frames_failed++;
+        exit_critical();
+        
+        if (entry.callback) {
+            entry.callback(entry.frame, false, entry.context);
+        }
+    }
+}
+
+/* Stop accepting frames and fail the queued ones, now or once the
+ * context transmitting has finished with the handler
+ */
+static void proto_tx_close(proto_txq_t *q) {
+    enter_critical();
+    q->closing = true;
+    exit_critical();
+    
+    proto_tx_fail_all(q);
+}
+
+static void proto_tx_retry(void *arg) {
+    protocol_type_t type = (protocol_type_t)(uintptr_t)arg;
+    
+    proto_txq[type].backoff = false;
+    proto_tx_kick(type);
+}
+
+/* Push queued frames to the handler until the queue drains or the
+ * handler pushes back
+ */
+void proto_tx_kick(protocol_type_t type) {
     proto_handler_t *handler = proto_get_handler(type);
-    if (!handler || !frame || handler->state == PROTO_STATE_ERROR) {
+    if (!handler || type >= PROTO_MAX_TYPES) return;
+    
+    proto_txq_t *q = &proto_txq[type];
+    
+    for (;;) {
+        proto_frame_t *batch[PROTO_TX_BATCH];
+        proto_tx_entry_t done[PROTO_TX_BATCH];
+        uint32_t count, sent, delay = 0;
+        bool give_up = false, closing;
+        
+        enter_critical();
+        if (q->busy || q->backoff || q->closing || q->head == q->tail ||
+            handler->state == PROTO_STATE_ERROR) {
+            exit_critical();
+            return;
+        }
+        q->busy = true;
+        count = MIN(q->tail - q->head, PROTO_TX_BATCH);
+        for (uint32_t i = 0; i < count; i++) {
+            batch[i] = q->ring[(q->head + i) & PROTO_TXQ_MASK].frame;
+        }
+        exit_critical();
+        
+        sent = proto_tx_transmit(handler, batch, count);
+        
+        enter_critical();
+        for (uint32_t i = 0; i < sent; i++) {
+            done[i] = q->ring[q->head & PROTO_TXQ_MASK];
+            q->head++;
+        }
+        q->stats.frames_sent += sent;
+        if (sent) {
+            q->attempts = 0;
+            if (sent > 1) q->stats.batches++;
+        }
+        /* A partial batch just loops; only a refused head frame backs off */
+        if (!sent) {
+            q->stats.retries++;
+            if (++q->attempts > handler->max_retries) {
+                give_up = true;
+                handler->state = PROTO_STATE_ERROR;
+            } else {
+                delay = proto_tx_backoff_ms(handler, q->attempts);
+                q->backoff = true;
+            }
+        }
+        q->busy = false;
+        closing = q->closing;
+        exit_critical();
+        
+        for (uint32_t i = 0; i < sent; i++) {
+            if (done[i].callback) {
+                done[i].callback(done[i].frame, true, done[i].context);
+            }
+        }
+        
+        if (give_up && handler->error_handler) {
+            handler->error_handler(PROTO_ERR_TIMEOUT);
+        }
+        /* proto_tx_close() may have run while we held busy, leaving the
+         * queue for us to drain
+         */
+        if (give_up || closing) {
+            proto_tx_fail_all(q);
+            return;
+        }
+        if (delay) {
+            timer_start(q->retry_timer, get_system_ticks() + ms_to_ticks(delay), 0,
+                        proto_tx_retry, (void*)(uintptr_t)type);
+            return;
+        }
+    }
+}
+
+/* Queue a frame whose checksum is already set */
+static bool proto_tx_enqueue(protocol_type_t type, proto_frame_t *frame,
+                             proto_tx_callback_t callback, void *context) {
+    proto_handler_t *handler = proto_get_handler(type);
+    if (!handler || !frame || type >= PROTO_MAX_TYPES ||
+        handler->state == PROTO_STATE_ERROR) {
         return false;
     }
     
+    proto_txq_t *q = &proto_txq[type];
+    
+    /* Chained frames go out as a gather list when the handler takes one */
+    if (frame->segs && (!handler->send_gather || frame->seg_count + 1 > PROTO_MAX_IOV)) {
+        if (!proto_frame_linearize(frame)) return false;
+    }
+    
     enter_critical();
+    if (q->closing) {
+        exit_critical();
+        return false;
+    }
+    if (q->tail - q->head == PROTO_TXQ_DEPTH) {
+        q->stats.queue_full++;
+        exit_critical();
+        return false;
+    }
+    proto_tx_entry_t *entry = &q->ring[q->tail & PROTO_TXQ_MASK];
+    entry->frame = frame;
+    entry->callback = callback;
+    entry->context = context;
+    q->tail++;
+    exit_critical();
     
-    bool success = false;
-    handler->state = PROTO_STATE_BUSY;
+    proto_tx_kick(type);
+    return true;
+}
+
+/* Queue a frame for transmission. The frame must stay valid until its
+ * callback reports completion.
+ */
+bool proto_send_async(protocol_type_t type, proto_frame_t *frame,
+                      proto_tx_callback_t callback, void *context) {
+    if (!frame) return false;
     
     /* Calculate checksum before sending */
     frame->checksum = proto_frame_calculate_checksum(frame);
     
-    /* Attempt to send with retries */
-    uint32_t retries = 0;
-    while (retries <= handler->max_retries) {
-        if (handler->send(frame)) {
-            success = true;
-            break;
+    return proto_tx_enqueue(type, frame, callback, context);
+}
+
+static void proto_send_done(proto_frame_t *frame, bool success, void *context) {
+    (void)success;
+    (void)context;
+    proto_frame_destroy(frame);
+}
+
+/* Move the linear part into a shared segment at the head of the chain
+ * and give the frame an empty linear part on fresh storage of the same
+ * size. The wire image is unchanged and no payload is copied.
+ */
+static bool proto_frame_share_linear(proto_frame_t *frame) {
+    uint8_t *storage = frame->buffer ? frame->buffer : frame->data;
+    uint32_t offset = (uint32_t)(frame->data - storage);
+    uint32_t capacity = offset + frame->max_size;
+    uint32_t headroom = MIN(frame->headroom, capacity);
+    
+    proto_seg_t *seg = malloc(sizeof(proto_seg_t));
+    uint8_t *fresh = malloc(capacity);
+    proto_buf_t *buf = proto_buf_wrap(storage, capacity, NULL, NULL);
+    if (!seg || !fresh || !buf) {
+        free(seg);
+        free(fresh);
+        free(buf);      /* Just the wrapper; storage stays with the frame */
+        return false;
+    }
+    
+    /* buf owns storage from here and frees it with the last reference */
+    seg->buf = buf;
+    seg->offset = offset;
+    seg->length = frame->length;
+    seg->next = frame->segs;
+    frame->segs = seg;
+    if (!frame->segs_tail) frame->segs_tail = seg;
+    frame->seg_count++;
+    frame->seg_length += frame->length;
+    
+    frame->buffer = fresh;
+    frame->data = fresh + headroom;
+    frame->max_size = capacity - headroom;
+    frame->length = 0;
+    
+    return true;
+}
+
+/* Send Protocol Frame
+ *
+ * Without a completion callback the caller may reuse the frame as soon
+ * as this returns. Rather than copying the payload, the linear part is
+ * turned into a shared segment and a frame referencing the same segments
+ * is queued. The caller's frame keeps its wire image but should be reset
+ * before the next one is built in it.
+ *
+ * Only queueing is reported: a frame the handler later fails to send is
+ * counted in frames_failed and otherwise dropped. Use proto_send_async()
+ * to learn the outcome of each frame.
+ */
+bool proto_send(protocol_type_t type, proto_frame_t *frame) {
+    if (!frame) return false;
+    
+    frame->checksum = proto_frame_calculate_checksum(frame);
+    
+    if (frame->length && !proto_frame_share_linear(frame)) return false;
+    
+    /* Headroom only, so lower layers can still push headers */
+    proto_frame_t *tx = proto_frame_create_headroom(0, frame->headroom);
+    if (!tx) return false;
+    
+    tx->position = frame->position;
+    tx->checksum = frame->checksum;
+    for (proto_seg_t *seg = frame->segs; seg; seg = seg->next) {
+        if (!proto_frame_append_buf(tx, seg->buf, seg->offset, seg->length)) {
+            proto_frame_destroy(tx);
+            return false;
         }
-        retries++;
     }
     
-    handler->state = success ? PROTO_STATE_IDLE : PROTO_STATE_ERROR;
-    if (!success) {
-        handler->error_handler(PROTO_ERR_TIMEOUT);
+    if (!proto_tx_enqueue(type, tx, proto_send_done, NULL)) {
+        proto_frame_destroy(tx);
+        return false;
     }
+    return true;
+}
+
+uint32_t proto_tx_pending(protocol_type_t type) {
+    if (type >= PROTO_MAX_TYPES) return 0;
+    return proto_txq[type].tail - proto_txq[type].head;
+}
+
+bool proto_tx_get_stats(protocol_type_t type, proto_tx_stats_t *stats) {
+    if (type >= PROTO_MAX_TYPES || !stats) return false;
     
+    enter_critical();
+    *stats = proto_txq[type].stats;
     exit_critical();
-    return success;
+    return true;
 }
 
 /* Receive Protocol Frame */
@@ -148,6 +509,100 @@ bool proto_receive(protocol_type_t type, proto_frame_t *frame) {
     return success;
 }
 
+/* Burst Receive */
+static uint32_t proto_rx_fill(proto_handler_t *handler, proto_frame_t **frames, uint32_t max) {
+    if (handler->receive_burst) {
+        uint32_t count = handler->receive_burst(frames, max);
+        return count < max ? count : max;
+    }
+    
+    uint32_t count = 0;
+    while (count < max && handler->receive(frames[count])) {
+        count++;
+    }
+    return count;
+}
+
+uint32_t proto_receive_burst(protocol_type_t type, proto_frame_t **frames, uint32_t max) {
+    proto_handler_t *handler = proto_get_handler(type);
+    if (!handler || !frames || !max || type >= PROTO_MAX_TYPES ||
+        handler->state == PROTO_STATE_ERROR) {
+        return 0;
+    }
+    
+    proto_rxq_t *q = &proto_rxq[type];
+    if (max > PROTO_RX_BURST_MAX) max = PROTO_RX_BURST_MAX;
+    
+    enter_critical();
+    if (q->busy) {
+        exit_critical();
+        return 0;
+    }
+    q->busy = true;
+    exit_critical();
+    
+    uint32_t count = proto_rx_fill(handler, frames, max);
+    
+    /* Validate in one pass, compacting good frames to the front. The
+     * next frame's header and payload are fetched while this one is
+     * checksummed. */
+    uint32_t valid = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        proto_frame_t *frame = frames[i];
+        
+        if (i + 1 < count) {
+            __builtin_prefetch(frames[i + 1]);
+            __builtin_prefetch(frames[i + 1]->data);
+        }
+        
+        if (proto_frame_validate(frame)) {
+            frames[i] = frames[valid];
+            frames[valid++] = frame;
+        }
+    }
+    
+    enter_critical();
+    q->stats.frames_received += valid;
+    q->stats.checksum_errors += count - valid;
+    if (count) {
+        q->stats.bursts++;
+    } else {
+        q->stats.empty_polls++;
+    }
+    proto_rx_handler_t rx = q->handler;
+    void *context = q->context;
+    q->busy = false;
+    exit_critical();
+    
+    if (count != valid && handler->error_handler) {
+        handler->error_handler(PROTO_ERR_CHECKSUM);
+    }
+    if (valid && rx) {
+        rx(type, frames, valid, context);
+    }
+    
+    return valid;
+}
+
+bool proto_set_rx_handler(protocol_type_t type, proto_rx_handler_t handler, void *context) {
+    if (type >= PROTO_MAX_TYPES) return false;
+    
+    enter_critical();
+    proto_rxq[type].handler = handler;
+    proto_rxq[type].context = context;
+    exit_critical();
+    return true;
+}
+
+bool proto_rx_get_stats(protocol_type_t type, proto_rx_stats_t *stats) {
+    if (type >= PROTO_MAX_TYPES || !stats) return false;
+    
+    enter_critical();
+    *stats = proto_rxq[type].stats;
+    exit_critical();
+    return true;
+}
+
 /* Process Protocol Errors */
 void proto_process_errors(protocol_type_t type, uint32_t error_code) {
     proto_handler_t *handler = proto_get_handler(type);
@@ -165,15 +620,21 @@ void proto_process_errors(protocol_type_t type, uint32_t error_code) {
 
 /* Frame Management Functions */
 proto_frame_t *proto_frame_create(uint32_t max_size) {
-    proto_frame_t *frame = malloc(sizeof(proto_frame_t));
+    return proto_frame_create_headroom(max_size, 0);
+}
+
+proto_frame_t *proto_frame_create_headroom(uint32_t max_size, uint32_t headroom) {
+    proto_frame_t *frame = calloc(1, sizeof(proto_frame_t));
     if (!frame) return NULL;
     
-    frame->data = malloc(max_size);
-    if (!frame->data) {
+    frame->buffer = malloc(headroom + max_size);
+    if (!frame->buffer) {
         free(frame);
         return NULL;
     }
     
+    frame->data = frame->buffer + headroom;
+    frame->headroom = headroom;
     frame->length = 0;
     frame->max_size = max_size;
     frame->position = 0;
@@ -184,13 +645,26 @@ proto_frame_t *proto_frame_create(uint32_t max_size) {
 
 void proto_frame_destroy(proto_frame_t *frame) {
     if (!frame) return;
-    if (frame->data) free(frame->data);
+    proto_frame_free_segs(frame);
+    if (frame->buffer) {
+        free(frame->buffer);
+    } else if (frame->data) {
+        free(frame->data);
+    }
     free(frame);
 }
 
 bool proto_frame_reset(proto_frame_t *frame) {
     if (!frame) return false;
     
+    /* Give back headroom consumed by pushed headers */
+    if (frame->buffer) {
+        uint32_t capacity = proto_frame_headroom(frame) + frame->max_size;
+        frame->data = frame->buffer + frame->headroom;
+        frame->max_size = capacity - frame->headroom;
+    }
+    
+    proto_frame_free_segs(frame);
     frame->length = 0;
     frame->position = 0;
     frame->checksum = 0;
@@ -212,9 +686,9 @@ bool proto_frame_append(proto_frame_t *frame, const uint8_t *data, uint32_t leng
 uint32_t proto_frame_calculate_checksum(const proto_frame_t *frame) {
     if (!frame || !frame->data) return 0;
     
-    uint32_t crc = 0xFFFFFFFF;
-    for (uint32_t i = 0; i < frame->length; i++) {
-        crc = (crc >> 8) ^ crc32_table[(crc & 0xFF) ^ frame->data[i]];
+    uint32_t crc = crc32c_update(CRC32C_INIT, frame->data, frame->length);
+    for (proto_seg_t *seg = frame->segs; seg; seg = seg->next) {
+        crc = crc32c_update(crc, seg->buf->data + seg->offset, seg->length);
     }
     
     return ~crc;
@@ -226,3 +700,176 @@ bool proto_frame_validate(const proto_frame_t *frame) {
     uint32_t calculated_checksum = proto_frame_calculate_checksum(frame);
     return calculated_checksum == frame->checksum;
 }
+
+/* Scatter-Gather Frames */
+bool proto_frame_push(proto_frame_t *frame, const uint8_t *header, uint32_t length) {
+    if (!frame || !header || length > proto_frame_headroom(frame)) {
+        return false;
+    }
+    
+    frame->data -= length;
+    frame->length += length;
+    frame->max_size += length;
+    memcpy(frame->data, header, length);
+    
+    return true;
+}
+
+/* Chain a range of buf after the frame's current contents, taking a reference */
+bool proto_frame_append_buf(proto_frame_t *frame, proto_buf_t *buf,
+                            uint32_t offset, uint32_t length) {
+    if (!frame || !buf || offset > buf->size || length > buf->size - offset) {
+        return false;
+    }
+    if (!length) return true;
+    
+    proto_seg_t *seg = malloc(sizeof(proto_seg_t));
+    if (!seg) return false;
+    
+    proto_buf_get(buf);
+    seg->buf = buf;
+    seg->offset = offset;
+    seg->length = length;
+    seg->next = NULL;
+    
+    if (frame->segs_tail) {
+        frame->segs_tail->next = seg;
+    } else {
+        frame->segs = seg;
+    }
+    frame->segs_tail = seg;
+    frame->seg_count++;
+    frame->seg_length += length;
+    
+    return true;
+}
+
+/* Copy the linear part, share the segments */
+proto_frame_t *proto_frame_clone(const proto_frame_t *frame) {
+    if (!frame) return NULL;
+    
+    proto_frame_t *clone = proto_frame_create_headroom(frame->max_size,
+                                                       proto_frame_headroom(frame));
+    if (!clone) return NULL;
+    
+    clone->headroom = frame->headroom;
+    memcpy(clone->data, frame->data, frame->length);
+    clone->length = frame->length;
+    clone->position = frame->position;
+    clone->checksum = frame->checksum;
+    
+    for (proto_seg_t *seg = frame->segs; seg; seg = seg->next) {
+        if (!proto_frame_append_buf(clone, seg->buf, seg->offset, seg->length)) {
+            proto_frame_destroy(clone);
+            return NULL;
+        }
+    }
+    
+    return clone;
+}
+
+/* Copy the segments into data, growing the buffer if needed */
+bool proto_frame_linearize(proto_frame_t *frame) {
+    if (!frame) return false;
+    if (!frame->segs) return true;
+    
+    uint32_t total = frame->length + frame->seg_length;
+    if (total > frame->max_size) {
+        if (!frame->buffer) return false;
+        
+        uint32_t headroom = proto_frame_headroom(frame);
+        uint8_t *buffer = realloc(frame->buffer, headroom + total);
+        if (!buffer) return false;
+        
+        frame->buffer = buffer;
+        frame->data = buffer + headroom;
+        frame->max_size = total;
+    }
+    
+    for (proto_seg_t *seg = frame->segs; seg; seg = seg->next) {
+        memcpy(frame->data + frame->length, seg->buf->data + seg->offset, seg->length);
+        frame->length += seg->length;
+    }
+    proto_frame_free_segs(frame);
+    
+    return true;
+}
+
+uint32_t proto_frame_total_length(const proto_frame_t *frame) {
+    return frame ? frame->length + frame->seg_length : 0;
+}
+
+/* Fill iov with the wire image; 0 if it needs more than max_iov elements */
+uint32_t proto_frame_to_iovec(const proto_frame_t *frame, proto_iovec_t *iov, uint32_t max_iov) {
+    if (!frame || !iov) return 0;
+    
+    uint32_t count = 0;
+    if (frame->length) {
+        if (max_iov == 0) return 0;
+        iov[count].base = frame->data;
+        iov[count].length = frame->length;
+        count++;
+    }
+    for (proto_seg_t *seg = frame->segs; seg; seg = seg->next) {
+        if (count == max_iov) return 0;
+        iov[count].base = seg->buf->data + seg->offset;
+        iov[count].length = seg->length;
+        count++;
+    }
+    
+    return count;
+}
+
+/* Shared Buffers */
+/* Buffer with its storage in the same allocation */
+proto_buf_t *proto_buf_alloc(uint32_t size) {
+    proto_buf_t *buf = malloc(sizeof(proto_buf_t) + size);
+    if (!buf) return NULL;
+    
+    buf->data = (uint8_t *)(buf + 1);
+    buf->size = size;
+    buf->refcount.value = 1;
+    buf->release = NULL;
+    buf->context = NULL;
+    
+    return buf;
+}
+
+/* Reference caller-owned storage; release runs when the last user is
+ * done, after which the wrapper itself is freed
+ */
+proto_buf_t *proto_buf_wrap(uint8_t *data, uint32_t size,
+                            void (*release)(proto_buf_t *buf), void *context) {
+    if (!data) return NULL;
+    
+    proto_buf_t *buf = malloc(sizeof(proto_buf_t));
+    if (!buf) return NULL;
+    
+    buf->data = data;
+    buf->size = size;
+    buf->refcount.value = 1;
+    buf->release = release;
+    buf->context = context;
+    
+    return buf;
+}
+
+void proto_buf_get(proto_buf_t *buf) {
+    if (!buf) return;
+    atomic_fetch_add_explicit_u32(&buf->refcount, 1, MEMORY_ORDER_RELAXED);
+}
+
+void proto_buf_put(proto_buf_t *buf) {
+    if (!buf) return;
+    if (atomic_fetch_sub_explicit_u32(&buf->refcount, 1, MEMORY_ORDER_ACQ_REL) != 1) {
+        return;
+    }
+    
+    /* release only disposes of data; the wrapper is always ours */
+    if (buf->release) {
+        buf->release(buf);
+    } else if (buf->data != (uint8_t *)(buf + 1)) {
+        free(buf->data);
+    }
+    free(buf);
+}
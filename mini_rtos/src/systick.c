@@ -32,11 +32,12 @@ void SysTick_Handler(void) {
     /* Get current CPU */
     uint8_t current_cpu = get_current_cpu();
     
-    /* Advance timer base for current CPU */
-    timer_base_advance(&timer_bases[current_cpu]);
+    /* Advance timer base for current CPU (also drains its remote inbox) */
+    timer_base_t *base = timer_get_base(current_cpu);
+    timer_base_advance(base);
     
     /* Handle any expired timers */
-    timer_base_process_events(&timer_bases[current_cpu]);
+    timer_base_process_events(base);
     
     /* Check if task switch is needed */
     if (system_ticks % TASK_SWITCH_TICKS == 0) {
@@ -5,26 +5,244 @@
 /* Global Variables */
 static timer_base_t timer_bases[MAX_CPU];
 static timer_stats_t global_stats;
+static hrtimer_program_t hrtimer_program;
+
+/* Per-Base Locking
+ *
+ * Each base is protected by its own spinlock instead of the global
+ * enter_critical(). Local interrupts stay off while it is held so the
+ * tick handler can't deadlock against task-level arm/cancel on the
+ * same CPU.
+ */
+static uint32_t wheel_lock(timer_wheel_t *wheel) {
+    uint32_t primask = __get_PRIMASK();
+    
+    __disable_irq();
+    while (atomic_exchange_explicit_u32(&wheel->lock, 1, MEMORY_ORDER_ACQUIRE)) {
+        /* Spin */
+    }
+    
+    return primask;
+}
+
+static void wheel_unlock(timer_wheel_t *wheel, uint32_t primask) {
+    atomic_store_explicit_u32(&wheel->lock, 0, MEMORY_ORDER_RELEASE);
+    __set_PRIMASK(primask);
+}
+
+static bool timer_state_cas(timer_t *timer, timer_state_t from, timer_state_t to) {
+    uint32_t expected = from;
+    return atomic_compare_exchange_strong_explicit_u32(
+        (atomic_uint32_t*)&timer->state, &expected, to,
+        MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_ACQUIRE);
+}
+
+/* Remote Inbox Helpers */
+static void timer_base_post(timer_base_t *base, timer_t *timer) {
+    void *head;
+    
+    timer->state = TIMER_REMOTE_PENDING;
+    
+    do {
+        head = atomic_load_explicit_ptr(&base->inbox, MEMORY_ORDER_ACQUIRE);
+        timer->inbox_next = head;
+    } while (!atomic_compare_exchange_strong_explicit_ptr(
+                 &base->inbox, &head, timer,
+                 MEMORY_ORDER_RELEASE, MEMORY_ORDER_RELAXED));
+}
+
+/* Move remotely armed timers onto the wheel (caller holds the base lock) */
+static void timer_base_drain_inbox(timer_base_t *base) {
+    timer_t *list = atomic_exchange_explicit_ptr(&base->inbox, NULL, MEMORY_ORDER_ACQUIRE);
+    timer_t *fifo = NULL;
+    
+    /* Reverse so timers are queued in the order they were armed */
+    while (list) {
+        timer_t *next = list->inbox_next;
+        list->inbox_next = fifo;
+        fifo = list;
+        list = next;
+    }
+    
+    while (fifo) {
+        timer_t *timer = fifo;
+        fifo = timer->inbox_next;
+        timer->inbox_next = NULL;
+        
+        /* A parked timer is either pending or cancelled; a concurrent
+         * re-arm may flip it back to pending, so settle it by CAS */
+        for (;;) {
+            if (timer_state_cas(timer, TIMER_REMOTE_PENDING, TIMER_ENQUEUED)) {
+                timer_wheel_add(&base->wheel, timer);
+                break;
+            }
+            if (timer_state_cas(timer, TIMER_CANCELLED, TIMER_INACTIVE)) {
+                break;
+            }
+        }
+    }
+}
+
+/* Pick the base to arm on; never post work to a CPU that has gone idle */
+static timer_base_t *timer_select_base(timer_t *timer) {
+    timer_base_t *base = &timer_bases[timer->cpu];
+    
+    if (base->idle && !(timer->flags & TIMER_FLAG_NO_IDLE_MIGRATE)) {
+        return &timer_bases[get_current_cpu()];
+    }
+    
+    return base;
+}
+
+/* Take a timer off its base. Returns true if it was left parked
+ * (TIMER_CANCELLED) in a remote inbox, where it can be revived. */
+static bool timer_detach(timer_t *timer) {
+    for (;;) {
+        if (timer_state_cas(timer, TIMER_REMOTE_PENDING, TIMER_CANCELLED) ||
+            timer->state == TIMER_CANCELLED) {
+            return true;
+        }
+        
+        uint8_t cpu = timer->cpu;
+        timer_base_t *base = &timer_bases[cpu];
+        uint32_t primask = wheel_lock(&base->wheel);
+        
+        /* Migrated or re-posted while we were waiting for the lock */
+        if (timer->cpu != cpu || timer->state == TIMER_REMOTE_PENDING) {
+            wheel_unlock(&base->wheel, primask);
+            continue;
+        }
+        
+        if (timer->state == TIMER_ENQUEUED) {
+            timer_wheel_remove(&base->wheel, timer);
+        } else if (timer->state == TIMER_EXPIRED) {
+            /* Sitting in an expiry batch, which skips non-expired timers */
+            timer->state = TIMER_INACTIVE;
+        }
+        
+        wheel_unlock(&base->wheel, primask);
+        return false;
+    }
+}
+
+/* Histogram Helpers */
+static uint32_t timer_hist_bucket(uint64_t value) {
+    uint32_t bucket = 0;
+    
+    while (value && bucket < TIMER_HIST_BUCKETS - 1) {
+        value >>= 1;
+        bucket++;
+    }
+    
+    return bucket;
+}
+
+static void timer_hist_record(timer_hist_t *hist, uint32_t duration, uint64_t lateness) {
+    hist->duration[timer_hist_bucket(duration)]++;
+    hist->lateness[timer_hist_bucket(lateness)]++;
+}
+
+static void timer_hist_accumulate(const timer_hist_t *hist, timer_latency_hist_t *out) {
+    uint32_t b;
+    
+    for (b = 0; b < TIMER_HIST_BUCKETS; b++) {
+        out->duration[b] += hist->duration[b] - hist->duration_mark[b];
+        out->lateness[b] += hist->lateness[b] - hist->lateness_mark[b];
+    }
+}
+
+/* Execute a timer callback and account its latency; due_ns is when the
+ * timer should have fired */
+static void timer_run_callback(timer_base_t *base, timer_t *timer, uint64_t due_ns) {
+    if (timer->callback) {
+        uint64_t start = timer_get_time_ns();
+        timer->callback(timer->callback_arg);
+        uint32_t latency = timer_get_time_ns() - start;
+        uint64_t lateness = start > due_ns ? start - due_ns : 0;
+        
+        timer_hist_record(&base->hist, latency, lateness);
+        if (timer->hist) {
+            timer_hist_record(timer->hist, latency, lateness);
+        }
+        
+        /* Update statistics */
+        global_stats.total_latency += latency;
+        if (latency > global_stats.max_latency) {
+            global_stats.max_latency = latency;
+        }
+        if (latency < global_stats.min_latency) {
+            global_stats.min_latency = latency;
+        }
+        global_stats.expired_timers++;
+    }
+}
+
+/* Timer Slack Helpers */
+static uint32_t timer_apply_slack(timer_t *timer, uint32_t now) {
+    uint32_t expires = timer->soft_expires;
+    uint32_t slack = timer->slack;
+    uint32_t limit, mask;
+    
+    if (timer->flags & TIMER_FLAG_HARD_DEADLINE) {
+        return expires;
+    }
+    
+    if (slack == TIMER_SLACK_DEFAULT) {
+        uint32_t delta = expires - now;
+        
+        if ((int32_t)delta <= 0 || (timer->flags & TIMER_FLAG_HIGH_RES)) {
+            return expires;
+        }
+        slack = delta >> TIMER_DEFAULT_SLACK_SHIFT;
+    }
+    
+    /* Pick the tick in [expires, expires + slack] with the most trailing
+     * zero bits: clear every bit below the highest one that differs */
+    limit = expires + slack;
+    mask = expires ^ limit;
+    if (!slack || !mask || limit < expires) {
+        return expires;
+    }
+    
+    mask = (1UL << (31 - __builtin_clz(mask))) - 1;
+    if ((limit & ~mask) != expires) {
+        global_stats.slack_adjusted++;
+    }
+    
+    return limit & ~mask;
+}
 
 /* Timer Wheel Helper Functions */
 static uint32_t get_wheel_index(uint32_t expires, uint8_t level) {
-    return (expires >> (TIMER_WHEEL_SIZE * level)) & TIMER_WHEEL_MASK;
+    return (expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+}
+
+/* Distance from slot 'from' to the next occupied slot, TIMER_WHEEL_SIZE if none */
+static uint32_t find_pending_slot(uint32_t map, uint32_t from) {
+    if (from) {
+        map = (map >> from) | (map << (TIMER_WHEEL_SIZE - from));
+    }
+    return map ? (uint32_t)__builtin_ctz(map) : TIMER_WHEEL_SIZE;
 }
 
+/* Re-file one upper-level slot; empty slots are skipped via the bitmap */
 static void cascade_timers(timer_wheel_t *wheel, uint8_t level) {
     uint32_t index = get_wheel_index(wheel->current_tick, level);
     timer_t *timer, *next;
     
+    if (!(wheel->pending[level] & (1UL << index))) {
+        return;
+    }
+    
     timer = wheel->wheel[level][index];
     wheel->wheel[level][index] = NULL;
+    wheel->pending[level] &= ~(1UL << index);
     
     while (timer) {
         next = timer->next;
         
         /* Re-add timer to appropriate level */
-        if (level > 0) {
-            timer_wheel_add(wheel, timer);
-        }
+        timer_wheel_add(wheel, timer);
         
         timer = next;
     }
@@ -33,122 +251,131 @@ static void cascade_timers(timer_wheel_t *wheel, uint8_t level) {
 /* Timer Wheel Implementation */
 void timer_wheel_add(timer_wheel_t *wheel, timer_t *timer) {
     uint32_t expires = timer->expires;
-    uint32_t idx = get_wheel_index(expires, 0);
+    uint32_t delta = expires - wheel->current_tick;
     uint8_t level = 0;
+    uint32_t idx;
+    
+    if ((int32_t)delta < 0) {
+        /* Already due, fire on the next tick processed */
+        expires = wheel->current_tick;
+        delta = 0;
+    } else if (delta > TIMER_WHEEL_MAX_DELTA) {
+        /* Park at the far edge; cascading re-files it later */
+        expires = wheel->current_tick + TIMER_WHEEL_MAX_DELTA;
+        delta = TIMER_WHEEL_MAX_DELTA;
+    }
     
     /* Find appropriate wheel level */
-    while (expires >> (TIMER_WHEEL_SIZE * (level + 1))) {
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           delta >= (1UL << (TIMER_WHEEL_BITS * (level + 1)))) {
         level++;
-        if (level >= TIMER_WHEEL_LEVELS) {
-            level = TIMER_WHEEL_LEVELS - 1;
-            break;
-        }
     }
     
     idx = get_wheel_index(expires, level);
     
     /* Add to wheel */
-    enter_critical();
-    
+    timer->level = level;
+    timer->slot = idx;
+    timer->prev = NULL;
     timer->next = wheel->wheel[level][idx];
     if (wheel->wheel[level][idx]) {
         wheel->wheel[level][idx]->prev = timer;
     }
     wheel->wheel[level][idx] = timer;
+    wheel->pending[level] |= 1UL << idx;
     timer->state = TIMER_ENQUEUED;
-    
-    exit_critical();
 }
 
 void timer_wheel_remove(timer_wheel_t *wheel, timer_t *timer) {
-    enter_critical();
-    
+    /* The recorded level and slot make this O(1) */
     if (timer->prev) {
         timer->prev->next = timer->next;
     } else {
-        uint32_t idx = get_wheel_index(timer->expires, 0);
-        uint8_t level;
-        
-        /* Find the wheel level */
-        for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
-            if (wheel->wheel[level][idx] == timer) {
-                wheel->wheel[level][idx] = timer->next;
-                break;
-            }
-            idx = get_wheel_index(timer->expires, level + 1);
-        }
+        wheel->wheel[timer->level][timer->slot] = timer->next;
     }
     
     if (timer->next) {
         timer->next->prev = timer->prev;
     }
     
+    if (!wheel->wheel[timer->level][timer->slot]) {
+        wheel->pending[timer->level] &= ~(1UL << timer->slot);
+    }
+    
     timer->state = TIMER_INACTIVE;
     timer->next = timer->prev = NULL;
-    
-    exit_critical();
 }
 
 void timer_wheel_advance(timer_wheel_t *wheel) {
+    timer_base_t *base = (timer_base_t *)((char *)wheel - offsetof(timer_base_t, wheel));
     uint32_t index = wheel->current_tick & TIMER_WHEEL_MASK;
+    uint32_t tick = wheel->current_tick;
+    uint64_t tick_ns = timer_get_time_ns();
+    timer_t *expired = NULL;
+    timer_t **expired_tail = &expired;
+    uint8_t level;
+    uint32_t primask = wheel_lock(wheel);
+    
+    /* Cascade timers from upper levels when the level below wraps */
+    if (index == 0) {
+        for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            cascade_timers(wheel, level);
+            if (get_wheel_index(wheel->current_tick, level) != 0) {
+                break;
+            }
+        }
+    }
     
-    /* Process expired timers */
+    /* Every timer in the current level-0 slot is due: splice the whole
+     * slot onto the expiry batch */
     timer_t *timer = wheel->wheel[0][index];
     wheel->wheel[0][index] = NULL;
+    wheel->pending[0] &= ~(1UL << index);
     
     while (timer) {
         timer_t *next = timer->next;
+        timer->next = timer->prev = NULL;
+        timer->state = TIMER_EXPIRED;
+        timer->expired_next = NULL;
+        *expired_tail = timer;
+        expired_tail = &timer->expired_next;
+        timer = next;
+    }
+    
+    wheel->current_tick++;
+    wheel_unlock(wheel, primask);
+    
+    /* Run callbacks without the base lock so they can re-arm timers */
+    while (expired) {
+        timer = expired;
+        expired = timer->expired_next;
         
-        if (timer->expires <= wheel->current_tick) {
-            /* Timer expired */
-            timer->state = TIMER_EXPIRED;
-            
-            /* Execute callback */
-            if (timer->callback) {
-                uint32_t start = timer_get_time_ns();
-                timer->callback(timer->callback_arg);
-                uint32_t latency = timer_get_time_ns() - start;
-                
-                /* Update statistics */
-                global_stats.total_latency += latency;
-                if (latency > global_stats.max_latency) {
-                    global_stats.max_latency = latency;
-                }
-                if (latency < global_stats.min_latency) {
-                    global_stats.min_latency = latency;
-                }
-                global_stats.expired_timers++;
-            }
-            
-            /* Handle periodic timers */
+        /* Stopped or re-armed by an earlier callback */
+        if (timer->state != TIMER_EXPIRED) {
+            continue;
+        }
+        
+        /* Late by whole ticks if it was armed in the past, plus its wait
+         * behind earlier callbacks in this batch */
+        uint32_t ticks_late = (int32_t)(tick - timer->expires) > 0 ? tick - timer->expires : 0;
+        timer_run_callback(base, timer, tick_ns - (uint64_t)ticks_late * TIMER_TICK_NS);
+        
+        primask = wheel_lock(wheel);
+        
+        /* Handle periodic timers */
+        if (timer->state == TIMER_EXPIRED) {
             if (timer->type == TIMER_PERIODIC) {
-                timer->expires += timer->period;
+                /* Advance from the requested expiry so slack never drifts */
+                timer->soft_expires += timer->period;
+                timer->expires = timer_apply_slack(timer, wheel->current_tick);
                 timer_wheel_add(wheel, timer);
             } else {
                 timer->state = TIMER_INACTIVE;
             }
-        } else {
-            /* Timer not expired, re-add to wheel */
-            timer_wheel_add(wheel, timer);
         }
         
-        timer = next;
-    }
-    
-    /* Cascade timers from upper levels if needed */
-    if ((wheel->current_tick & ((1 << TIMER_WHEEL_SIZE) - 1)) == 0) {
-        cascade_timers(wheel, 1);
-        
-        if ((wheel->current_tick & ((1 << (2 * TIMER_WHEEL_SIZE)) - 1)) == 0) {
-            cascade_timers(wheel, 2);
-            
-            if ((wheel->current_tick & ((1 << (3 * TIMER_WHEEL_SIZE)) - 1)) == 0) {
-                cascade_timers(wheel, 3);
-            }
-        }
+        wheel_unlock(wheel, primask);
     }
-    
-    wheel->current_tick++;
 }
 
 /* Timer Base Functions */
@@ -157,29 +384,150 @@ void timer_base_advance(timer_base_t *base) {
         return;
     }
     
+    /* Pick up timers armed from other CPUs since the last tick */
+    uint32_t primask = wheel_lock(&base->wheel);
+    timer_base_drain_inbox(base);
+    wheel_unlock(&base->wheel, primask);
+    
     timer_wheel_advance(&base->wheel);
     
+    /* Catch anything the one-shot event hasn't already run */
+    if (base->hrq.count) {
+        hrtimer_run_queues(base, timer_get_time_ns());
+    }
+    
     /* Update next expiry */
     base->next_expiry = timer_base_get_next_expiry(base);
 }
 
+/* Earliest tick at which the wheel needs servicing: the exact expiry for
+ * level 0, the cascade point for upper levels. UINT32_MAX if empty. */
+uint32_t timer_wheel_next_expiry(timer_wheel_t *wheel) {
+    uint32_t now = wheel->current_tick;
+    uint32_t best_delta = UINT32_MAX;
+    uint8_t level;
+    
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint32_t shift = TIMER_WHEEL_BITS * level;
+        uint32_t cur = get_wheel_index(now, level);
+        uint32_t first = 0;
+        
+        if (!wheel->pending[level]) {
+            continue;
+        }
+        
+        /* The current upper slot was already cascaded this period */
+        if (level > 0 && (now & ((1UL << shift) - 1))) {
+            first = 1;
+        }
+        
+        uint32_t k = find_pending_slot(wheel->pending[level], (cur + first) & TIMER_WHEEL_MASK);
+        if (k == TIMER_WHEEL_SIZE) {
+            continue;
+        }
+        
+        uint32_t when = level ? ((now >> shift) + first + k) << shift : now + k;
+        if (when - now < best_delta) {
+            best_delta = when - now;
+        }
+    }
+    
+    return best_delta == UINT32_MAX ? UINT32_MAX : now + best_delta;
+}
+
 uint32_t timer_base_get_next_expiry(timer_base_t *base) {
-    uint32_t next_expiry = UINT32_MAX;
+    uint32_t primask = wheel_lock(&base->wheel);
+    uint32_t next_expiry = timer_wheel_next_expiry(&base->wheel);
+    wheel_unlock(&base->wheel, primask);
+    
+    return next_expiry;
+}
+
+timer_base_t *timer_get_base(uint8_t cpu) {
+    if (cpu >= MAX_CPU) {
+        return NULL;
+    }
+    return &timer_bases[cpu];
+}
+
+static uint32_t hrtimer_migrate(timer_base_t *from, timer_base_t *to);
+
+/* Timer Migration */
+uint32_t timer_migrate(uint8_t from_cpu, uint8_t to_cpu) {
+    uint32_t migrated = 0;
     uint8_t level, idx;
     
+    if (from_cpu == to_cpu || from_cpu >= MAX_CPU || to_cpu >= MAX_CPU) {
+        return 0;
+    }
+    
+    timer_base_t *from = &timer_bases[from_cpu];
+    timer_base_t *to = &timer_bases[to_cpu];
+    uint32_t primask = wheel_lock(&from->wheel);
+    
+    /* Pending remote arms migrate along with queued timers */
+    timer_base_drain_inbox(from);
+    
     for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
         for (idx = 0; idx < TIMER_WHEEL_SIZE; idx++) {
-            timer_t *timer = base->wheel.wheel[level][idx];
+            if (!(from->wheel.pending[level] & (1UL << idx))) {
+                continue;
+            }
+            
+            timer_t *timer = from->wheel.wheel[level][idx];
+            
             while (timer) {
-                if (timer->expires < next_expiry) {
-                    next_expiry = timer->expires;
+                timer_t *next = timer->next;
+                
+                if (!(timer->flags & TIMER_FLAG_NO_IDLE_MIGRATE)) {
+                    timer_wheel_remove(&from->wheel, timer);
+                    timer->cpu = to_cpu;
+                    
+                    /* Hand over through the inbox so only one base lock is held */
+                    timer_base_post(to, timer);
+                    migrated++;
                 }
-                timer = timer->next;
+                
+                timer = next;
             }
         }
     }
     
-    return next_expiry;
+    wheel_unlock(&from->wheel, primask);
+    
+    return migrated + hrtimer_migrate(from, to);
+}
+
+void timer_cpu_idle_enter(uint8_t cpu) {
+    uint8_t target;
+    
+    if (cpu >= MAX_CPU) {
+        return;
+    }
+    
+    /* Stop new remote arms from landing here before we drain */
+    timer_bases[cpu].idle = 1;
+    
+    for (target = 0; target < MAX_CPU; target++) {
+        if (target != cpu && timer_bases[target].active && !timer_bases[target].idle) {
+            timer_migrate(cpu, target);
+            break;
+        }
+    }
+}
+
+void timer_cpu_idle_exit(uint8_t cpu) {
+    if (cpu >= MAX_CPU) {
+        return;
+    }
+    
+    timer_base_t *base = &timer_bases[cpu];
+    base->idle = 0;
+    
+    /* Anything posted while we were going idle */
+    uint32_t primask = wheel_lock(&base->wheel);
+    timer_base_drain_inbox(base);
+    wheel_unlock(&base->wheel, primask);
 }
 
 /* Timer Management Functions */
@@ -193,6 +541,11 @@ timer_t *timer_create(timer_type_t type, uint32_t flags) {
     timer->flags = flags;
     timer->state = TIMER_INACTIVE;
     timer->next = timer->prev = NULL;
+    timer->inbox_next = timer->expired_next = NULL;
+    timer->slack = TIMER_SLACK_DEFAULT;
+    timer->slack_ns = 0;
+    timer->heap_index = HRTIMER_NOT_QUEUED;
+    timer->hist = NULL;
     timer->cpu = get_current_cpu();
     
     global_stats.total_timers++;
@@ -212,13 +565,31 @@ int timer_start(timer_t *timer, uint32_t expires, uint32_t period,
         return -1;
     }
     
-    timer->expires = expires;
+    bool parked = timer_detach(timer);
+    
+    timer->soft_expires = expires;
+    timer->expires = timer_apply_slack(timer, timer_bases[timer->cpu].wheel.current_tick);
     timer->period = period;
     timer->callback = callback;
     timer->callback_arg = arg;
     
-    timer_base_t *base = &timer_bases[timer->cpu];
-    timer_wheel_add(&base->wheel, timer);
+    /* Still in a remote inbox: revive it there unless the owner beat us */
+    if (parked && timer_state_cas(timer, TIMER_CANCELLED, TIMER_REMOTE_PENDING)) {
+        global_stats.active_timers++;
+        return 0;
+    }
+    
+    timer_base_t *base = timer_select_base(timer);
+    timer->cpu = base->cpu;
+    
+    if (base->cpu == get_current_cpu()) {
+        uint32_t primask = wheel_lock(&base->wheel);
+        timer_wheel_add(&base->wheel, timer);
+        wheel_unlock(&base->wheel, primask);
+    } else {
+        /* Remote arm: lock-free, the owner queues it on its next tick */
+        timer_base_post(base, timer);
+    }
     
     global_stats.active_timers++;
     
@@ -230,24 +601,461 @@ int timer_stop(timer_t *timer) {
         return -1;
     }
     
-    timer_base_t *base = &timer_bases[timer->cpu];
-    timer_wheel_remove(&base->wheel, timer);
+    if (timer->flags & TIMER_FLAG_HIGH_RES) {
+        return hrtimer_cancel(timer);
+    }
+    
+    timer_detach(timer);
     
     global_stats.active_timers--;
     
     return 0;
 }
 
+int timer_set_slack(timer_t *timer, uint32_t slack_ticks) {
+    if (!timer) {
+        return -1;
+    }
+    
+    /* Takes effect on the next timer_start() or periodic re-arm */
+    timer->slack = slack_ticks;
+    
+    return 0;
+}
+
+/* Round up to a power-of-two multiple so unrelated periodic work lines up,
+ * in the spirit of Linux round_jiffies() */
+uint32_t timer_round_ticks(uint32_t ticks, uint32_t granularity) {
+    if (granularity <= 1) {
+        return ticks;
+    }
+    
+    if (granularity & (granularity - 1)) {
+        granularity = 1UL << (32 - __builtin_clz(granularity));
+    }
+    
+    return (ticks + granularity - 1) & ~(granularity - 1);
+}
+
 /* High Resolution Timer Functions */
 timer_t *hrtimer_create(uint32_t flags) {
     return timer_create(TIMER_HIGH_RES, flags | TIMER_FLAG_HIGH_RES);
 }
 
+/* hrtimer heap helpers (caller holds the base lock) */
+static void hrtimer_heap_set(hrtimer_queue_t *q, uint32_t idx, timer_t *timer) {
+    q->heap[idx] = timer;
+    timer->heap_index = idx;
+}
+
+static void hrtimer_sift_up(hrtimer_queue_t *q, uint32_t idx) {
+    timer_t *timer = q->heap[idx];
+    
+    while (idx > 0) {
+        uint32_t parent = (idx - 1) / HRTIMER_HEAP_ARITY;
+        if (q->heap[parent]->expires_ns <= timer->expires_ns) {
+            break;
+        }
+        hrtimer_heap_set(q, idx, q->heap[parent]);
+        idx = parent;
+    }
+    
+    hrtimer_heap_set(q, idx, timer);
+}
+
+static void hrtimer_sift_down(hrtimer_queue_t *q, uint32_t idx) {
+    timer_t *timer = q->heap[idx];
+    
+    for (;;) {
+        uint32_t first = idx * HRTIMER_HEAP_ARITY + 1;
+        uint32_t last = first + HRTIMER_HEAP_ARITY;
+        uint32_t best = idx;
+        uint64_t best_expiry = timer->expires_ns;
+        uint32_t child;
+        
+        if (last > q->count) {
+            last = q->count;
+        }
+        
+        for (child = first; child < last; child++) {
+            if (q->heap[child]->expires_ns < best_expiry) {
+                best = child;
+                best_expiry = q->heap[child]->expires_ns;
+            }
+        }
+        
+        if (best == idx) {
+            break;
+        }
+        
+        hrtimer_heap_set(q, idx, q->heap[best]);
+        idx = best;
+    }
+    
+    hrtimer_heap_set(q, idx, timer);
+}
+
+/* Caller has made room with hrtimer_grow() */
+static void hrtimer_enqueue(hrtimer_queue_t *q, timer_t *timer) {
+    q->heap[q->count] = timer;
+    timer->heap_index = q->count++;
+    hrtimer_sift_up(q, timer->heap_index);
+    timer->state = TIMER_ENQUEUED;
+    
+    if (timer->slack_ns > q->max_slack_ns) {
+        q->max_slack_ns = timer->slack_ns;
+    }
+}
+
+static void hrtimer_dequeue(hrtimer_queue_t *q, timer_t *timer) {
+    uint32_t idx = timer->heap_index;
+    timer_t *last = q->heap[--q->count];
+    
+    timer->heap_index = HRTIMER_NOT_QUEUED;
+    timer->state = TIMER_INACTIVE;
+    
+    if (q->count == 0) {
+        q->max_slack_ns = 0;
+    }
+    if (idx == q->count) {
+        return;
+    }
+    
+    hrtimer_heap_set(q, idx, last);
+    if (idx > 0 && q->heap[(idx - 1) / HRTIMER_HEAP_ARITY]->expires_ns > last->expires_ns) {
+        hrtimer_sift_up(q, idx);
+    } else {
+        hrtimer_sift_down(q, idx);
+    }
+}
+
+/* Make room for at least need entries on base's heap. Called without the
+ * base lock: the array can't be allocated with interrupts off, so a new
+ * one is built outside and swapped in under the lock. */
+static bool hrtimer_grow(timer_base_t *base, uint32_t need) {
+    hrtimer_queue_t *q = &base->hrq;
+    uint32_t capacity = q->capacity ? q->capacity : HRTIMER_HEAP_INITIAL;
+    timer_t **heap;
+    
+    while (capacity < need) {
+        capacity *= 2;
+    }
+    
+    heap = rtos_malloc(capacity * sizeof(timer_t *));
+    if (!heap) {
+        return false;
+    }
+    
+    uint32_t primask = wheel_lock(&base->wheel);
+    
+    /* Someone else may have grown it meanwhile; keep the larger array */
+    if (capacity > q->capacity) {
+        timer_t **old = q->heap;
+        
+        if (q->count) {
+            memcpy(heap, old, q->count * sizeof(timer_t *));
+        }
+        q->heap = heap;
+        q->capacity = capacity;
+        heap = old;
+    }
+    
+    wheel_unlock(&base->wheel, primask);
+    
+    if (heap) {
+        rtos_free(heap);
+    }
+    
+    return true;
+}
+
+/* Lock the base a high-res timer belongs to; timer->cpu only changes with
+ * both bases locked, so recheck it once we hold ours */
+static timer_base_t *hrtimer_lock_base(timer_t *timer, uint32_t *primask) {
+    for (;;) {
+        uint8_t cpu = timer->cpu;
+        timer_base_t *base = &timer_bases[cpu];
+        
+        *primask = wheel_lock(&base->wheel);
+        if (timer->cpu == cpu) {
+            return base;
+        }
+        wheel_unlock(&base->wheel, *primask);
+    }
+}
+
+/* Tell the platform about a new earliest expiry */
+static void hrtimer_reprogram(timer_base_t *base) {
+    hrtimer_queue_t *q = &base->hrq;
+    uint64_t next = q->count ? q->heap[0]->expires_ns : UINT64_MAX;
+    
+    if (next != q->next_event_ns) {
+        q->next_event_ns = next;
+        if (hrtimer_program && next != UINT64_MAX) {
+            hrtimer_program(base->cpu, next);
+        }
+    }
+}
+
+/* Move from's migratable high-res timers onto to's heap. Unlike the wheel
+ * there's no inbox to hand them over through, so both bases are locked,
+ * in CPU order so opposing migrations can't deadlock. */
+static uint32_t hrtimer_migrate(timer_base_t *from, timer_base_t *to) {
+    timer_base_t *first = from->cpu < to->cpu ? from : to;
+    timer_base_t *second = first == from ? to : from;
+    uint32_t primask_first, primask_second;
+    uint32_t migrated = 0;
+    uint32_t kept = 0;
+    uint32_t idx;
+    
+    for (;;) {
+        primask_first = wheel_lock(&first->wheel);
+        primask_second = wheel_lock(&second->wheel);
+        
+        uint32_t need = to->hrq.count + from->hrq.count;
+        if (need <= to->hrq.capacity) {
+            break;
+        }
+        
+        wheel_unlock(&second->wheel, primask_second);
+        wheel_unlock(&first->wheel, primask_first);
+        if (!hrtimer_grow(to, need)) {
+            return 0;
+        }
+    }
+    
+    for (idx = 0; idx < from->hrq.count; idx++) {
+        timer_t *timer = from->hrq.heap[idx];
+        
+        if (timer->flags & TIMER_FLAG_NO_IDLE_MIGRATE) {
+            from->hrq.heap[kept++] = timer;
+            continue;
+        }
+        
+        timer->cpu = to->cpu;
+        hrtimer_enqueue(&to->hrq, timer);
+        migrated++;
+    }
+    
+    /* Re-heapify whatever had to stay behind */
+    from->hrq.count = kept;
+    if (kept == 0) {
+        from->hrq.max_slack_ns = 0;
+    }
+    for (idx = kept; idx-- > 0;) {
+        hrtimer_sift_down(&from->hrq, idx);
+    }
+    
+    if (migrated) {
+        hrtimer_reprogram(from);
+        hrtimer_reprogram(to);
+    }
+    
+    wheel_unlock(&second->wheel, primask_second);
+    wheel_unlock(&first->wheel, primask_first);
+    
+    return migrated;
+}
+
 int hrtimer_start(timer_t *timer, uint64_t expires_ns,
                   timer_callback_t callback, void *arg) {
-    /* Convert nanoseconds to timer ticks */
-    uint32_t expires = (uint32_t)(expires_ns / timer_bases[timer->cpu].resolution);
-    return timer_start(timer, expires, 0, callback, arg);
+    if (!timer || !callback) {
+        return -1;
+    }
+    
+    uint32_t primask;
+    timer_base_t *base = hrtimer_lock_base(timer, &primask);
+    
+    if (timer->heap_index != HRTIMER_NOT_QUEUED) {
+        hrtimer_dequeue(&base->hrq, timer);
+    } else {
+        while (base->hrq.count >= base->hrq.capacity) {
+            uint32_t need = base->hrq.count + 1;
+            
+            wheel_unlock(&base->wheel, primask);
+            if (!hrtimer_grow(base, need)) {
+                return -1;
+            }
+            base = hrtimer_lock_base(timer, &primask);
+            
+            /* Armed by someone else while the lock was dropped */
+            if (timer->heap_index != HRTIMER_NOT_QUEUED) {
+                hrtimer_dequeue(&base->hrq, timer);
+                global_stats.active_timers--;
+                break;
+            }
+        }
+        global_stats.active_timers++;
+    }
+    
+    /* Queue on the hard expiry; the soft one lets it ride an earlier event */
+    timer->soft_expires_ns = expires_ns;
+    timer->expires_ns = expires_ns + timer->slack_ns;
+    if (timer->expires_ns < expires_ns) {
+        timer->expires_ns = UINT64_MAX;
+    }
+    timer->callback = callback;
+    timer->callback_arg = arg;
+    
+    hrtimer_enqueue(&base->hrq, timer);
+    
+    hrtimer_reprogram(base);
+    wheel_unlock(&base->wheel, primask);
+    
+    return 0;
+}
+
+int hrtimer_cancel(timer_t *timer) {
+    if (!timer) {
+        return -1;
+    }
+    
+    uint32_t primask;
+    timer_base_t *base = hrtimer_lock_base(timer, &primask);
+    
+    if (timer->heap_index != HRTIMER_NOT_QUEUED) {
+        hrtimer_dequeue(&base->hrq, timer);
+        hrtimer_reprogram(base);
+        global_stats.active_timers--;
+    } else if (timer->state == TIMER_EXPIRED) {
+        /* Sitting in an expiry batch, which skips non-expired timers */
+        timer->state = TIMER_INACTIVE;
+    }
+    
+    wheel_unlock(&base->wheel, primask);
+    
+    return 0;
+}
+
+int hrtimer_set_slack(timer_t *timer, uint64_t slack_ns) {
+    if (!timer) {
+        return -1;
+    }
+    
+    /* Takes effect on the next hrtimer_start() */
+    timer->slack_ns = slack_ns;
+    
+    return 0;
+}
+
+/* O(1): the heap root is the earliest expiry. UINT64_MAX if none. */
+uint64_t hrtimer_get_next_expiry(uint8_t cpu) {
+    if (cpu >= MAX_CPU) {
+        return UINT64_MAX;
+    }
+    
+    timer_base_t *base = &timer_bases[cpu];
+    uint32_t primask = wheel_lock(&base->wheel);
+    uint64_t next = base->hrq.count ? base->hrq.heap[0]->expires_ns : UINT64_MAX;
+    wheel_unlock(&base->wheel, primask);
+    
+    return next;
+}
+
+/* A 32-bit count is at most 32 levels deep, and each level of the walk
+ * leaves at most ARITY - 1 siblings on the stack */
+#define HRTIMER_WALK_DEPTH  (32 * (HRTIMER_HEAP_ARITY - 1) + 1)
+
+/* Pull a timer off the heap onto an expiry batch (caller holds the lock) */
+static timer_t **hrtimer_expire(hrtimer_queue_t *q, timer_t *timer, timer_t **tail) {
+    hrtimer_dequeue(q, timer);
+    global_stats.active_timers--;
+    timer->state = TIMER_EXPIRED;
+    timer->expired_next = NULL;
+    *tail = timer;
+    
+    return &timer->expired_next;
+}
+
+void hrtimer_run_queues(timer_base_t *base, uint64_t now_ns) {
+    hrtimer_queue_t *q = &base->hrq;
+    timer_t *expired = NULL;
+    timer_t **expired_tail = &expired;
+    uint32_t primask = wheel_lock(&base->wheel);
+    
+    /* Hard-expired timers first */
+    while (q->count && q->heap[0]->expires_ns <= now_ns) {
+        expired_tail = hrtimer_expire(q, q->heap[0], expired_tail);
+    }
+    
+    /* Then any whose slack window has opened so they share this event
+     * rather than causing their own. Children expire no earlier than their
+     * parent, so once a node's hard expiry is more than the largest queued
+     * slack away, nothing below it can be soft-expired either. */
+    if (q->count && q->max_slack_ns) {
+        uint64_t horizon = now_ns + q->max_slack_ns;
+        uint32_t stack[HRTIMER_WALK_DEPTH];
+        uint32_t depth = 0;
+        timer_t *soft = NULL;
+        
+        if (horizon < now_ns) {
+            horizon = UINT64_MAX;
+        }
+        
+        stack[depth++] = 0;
+        while (depth) {
+            uint32_t idx = stack[--depth];
+            uint32_t child = idx * HRTIMER_HEAP_ARITY + 1;
+            uint32_t last = child + HRTIMER_HEAP_ARITY;
+            timer_t *timer = q->heap[idx];
+            
+            if (timer->expires_ns > horizon) {
+                continue;
+            }
+            if (timer->soft_expires_ns <= now_ns) {
+                /* Collect first; dequeueing reshuffles the heap */
+                timer->expired_next = soft;
+                soft = timer;
+            }
+            
+            if (last > q->count) {
+                last = q->count;
+            }
+            for (; child < last; child++) {
+                stack[depth++] = child;
+            }
+        }
+        
+        while (soft) {
+            timer_t *timer = soft;
+            soft = timer->expired_next;
+            expired_tail = hrtimer_expire(q, timer, expired_tail);
+        }
+    }
+    
+    hrtimer_reprogram(base);
+    wheel_unlock(&base->wheel, primask);
+    
+    while (expired) {
+        timer_t *timer = expired;
+        expired = timer->expired_next;
+        
+        /* Cancelled or re-armed by an earlier callback */
+        if (timer->state != TIMER_EXPIRED) {
+            continue;
+        }
+        
+        timer_run_callback(base, timer, timer->expires_ns);
+        
+        primask = wheel_lock(&base->wheel);
+        if (timer->state == TIMER_EXPIRED) {
+            timer->state = TIMER_INACTIVE;
+        }
+        wheel_unlock(&base->wheel, primask);
+    }
+}
+
+/* Entry point for the per-CPU one-shot event interrupt */
+void hrtimer_interrupt(uint8_t cpu) {
+    if (cpu >= MAX_CPU) {
+        return;
+    }
+    
+    hrtimer_run_queues(&timer_bases[cpu], timer_get_time_ns());
+}
+
+void hrtimer_set_program_handler(hrtimer_program_t program) {
+    hrtimer_program = program;
 }
 
 /* Timer Subsystem Initialization */
@@ -260,11 +1068,19 @@ void timer_subsystem_init(void) {
         base->cpu = cpu;
         base->resolution = 1000; /* 1 microsecond resolution */
         base->active = 1;
+        base->idle = 0;
+        base->hrq.heap = NULL;
+        base->hrq.capacity = 0;
+        base->hrq.count = 0;
+        base->hrq.max_slack_ns = 0;
+        base->hrq.next_event_ns = UINT64_MAX;
+        memset(&base->hist, 0, sizeof(timer_hist_t));
+        atomic_store_explicit_ptr(&base->inbox, NULL, MEMORY_ORDER_RELEASE);
         
         /* Initialize wheel */
         memset(&base->wheel, 0, sizeof(timer_wheel_t));
         base->wheel.resolution = base->resolution;
-        base->wheel.lock = mutex_create();
+        atomic_store_explicit_u32(&base->wheel.lock, 0, MEMORY_ORDER_RELEASE);
     }
     
     /* Initialize statistics */
@@ -274,12 +1090,72 @@ void timer_subsystem_init(void) {
 
 /* Timer Statistics Functions */
 void get_timer_stats(timer_stats_t *stats) {
+    uint8_t cpu;
+    
     if (stats) {
         memcpy(stats, &global_stats, sizeof(timer_stats_t));
+        memset(&stats->hist, 0, sizeof(timer_latency_hist_t));
+        
+        for (cpu = 0; cpu < MAX_CPU; cpu++) {
+            timer_hist_accumulate(&timer_bases[cpu].hist, &stats->hist);
+        }
     }
 }
 
 void reset_timer_stats(void) {
+    uint8_t cpu;
+    
     memset(&global_stats, 0, sizeof(timer_stats_t));
     global_stats.min_latency = UINT32_MAX;
+    
+    for (cpu = 0; cpu < MAX_CPU; cpu++) {
+        timer_reset_histogram(&timer_bases[cpu].hist);
+    }
+}
+
+int get_timer_base_stats(uint8_t cpu, timer_latency_hist_t *hist) {
+    if (cpu >= MAX_CPU || !hist) {
+        return -1;
+    }
+    
+    timer_get_histogram(&timer_bases[cpu].hist, hist);
+    
+    return 0;
+}
+
+/* Attach caller-owned histogram storage to a timer; NULL detaches */
+int timer_enable_histogram(timer_t *timer, timer_hist_t *hist) {
+    if (!timer) {
+        return -1;
+    }
+    
+    if (hist) {
+        memset(hist, 0, sizeof(timer_hist_t));
+    }
+    timer->hist = hist;
+    
+    return 0;
+}
+
+void timer_get_histogram(const timer_hist_t *hist, timer_latency_hist_t *out) {
+    if (!hist || !out) {
+        return;
+    }
+    
+    memset(out, 0, sizeof(timer_latency_hist_t));
+    timer_hist_accumulate(hist, out);
+}
+
+/* Lock-free: writers keep counting, readers subtract the new mark */
+void timer_reset_histogram(timer_hist_t *hist) {
+    uint32_t b;
+    
+    if (!hist) {
+        return;
+    }
+    
+    for (b = 0; b < TIMER_HIST_BUCKETS; b++) {
+        hist->duration_mark[b] = hist->duration[b];
+        hist->lateness_mark[b] = hist->lateness[b];
+    }
 }
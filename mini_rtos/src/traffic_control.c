@@ -4,6 +4,33 @@
 #include "scheduler.h"
 #include "timer.h"
 #include "rbtree.h"
+#include "memory_order.h"
+
+/* CoDel state for one class */
+typedef struct tc_codel {
+    uint8_t mode;                      /* tc_aqm_mode_t */
+    bool dropping;                     /* In a drop episode */
+    bool above_target;                 /* first_above is armed */
+    uint32_t interval;                 /* ms */
+    uint32_t first_above;              /* When a standing queue turns droppable */
+    uint32_t drop_next;                /* Next drop while dropping */
+    uint32_t count;                    /* Drops in this episode */
+    uint32_t lastcount;                /* count when the last episode began */
+    uint32_t drops;
+    uint32_t marks;
+    uint32_t episodes;
+    uint32_t sojourn_max;
+    uint32_t hist[TC_AQM_HIST_BUCKETS];
+} tc_codel_t;
+
+/* Class shaper: a global bucket plus a token cache per CPU */
+typedef struct tc_pcpu_shaper {
+    atomic_uint64_t bucket;            /* Tokens << 32 | last refill (ms) */
+    uint32_t token_rate;               /* Tokens per second, UINT32_MAX unlimited */
+    uint32_t bucket_size;
+    uint32_t chunk;                    /* Tokens a CPU pulls beyond its need */
+    atomic_uint32_t cache[MAX_CPU];    /* Cache-line aligned, written by owner only */
+} tc_pcpu_shaper_t;
 
 /* Traffic class queues */
 typedef struct tc_queue {
@@ -11,15 +38,84 @@ typedef struct tc_queue {
     tcb_t *tail;
     uint32_t count;
     uint32_t total_weight;
-    tc_shaper_t shaper;
+    tc_pcpu_shaper_t shaper;
     tc_stats_t stats;
     tc_class_config_t config;
+    tc_codel_t codel;
 } tc_queue_t;
 
+/* HTB tree node. Node sets (row, feed, wait queue) are bitmasks of node
+ * ids; leaves sit at level 0, the root at TC_HTB_MAX_LEVELS - 1, and every
+ * interior node one level below its parent.
+ */
+typedef struct htb_node {
+    bool used;
+    int8_t parent;
+    uint8_t level;
+    uint8_t prio;
+    uint8_t prio_activity;             /* Prios with backlog below this node */
+    uint8_t mode;                      /* tc_htb_mode_t */
+    uint16_t children;
+    uint32_t rate;                     /* Guaranteed, units/sec */
+    uint32_t ceil;                     /* Ceiling, units/sec */
+    int64_t buffer;                    /* Bucket depths, milli-units */
+    int64_t cbuffer;
+    int64_t tokens;
+    int64_t ctokens;
+    uint32_t checkpoint;               /* Last refill (ms) */
+    uint32_t wait_until;               /* Next mode change while waiting (ms) */
+    uint32_t quantum;
+    int32_t deficit[TC_HTB_MAX_LEVELS];
+    uint32_t feed[TC_HTB_PRIOS];       /* Children borrowing from us, per prio */
+    uint8_t feed_next[TC_HTB_PRIOS];   /* Round-robin cursor into feed */
+    uint32_t lends;
+    uint32_t borrows;
+} htb_node_t;
+
+#define HTB_FIRST_INNER (TC_MAX_CLASSES + 1)
+#define HTB_SCALE 1000                 /* Tokens in milli-units so ms refills are exact */
+#define HTB_MAX_ELAPSED (1u << 20)     /* Caps refill arithmetic; far beyond any bucket */
+#define HTB_DEFAULT_QUANTUM 1
+
+/* WF2Q+ per-class state. Virtual times are service divided by weight,
+ * scaled so small weights keep precision.
+ */
+typedef struct wfq_class {
+    uint64_t start;                    /* Virtual start of the head task */
+    uint64_t finish;                   /* Virtual finish of the head task */
+    uint32_t weight;                   /* Weight counted in wfq_active_weight */
+    int8_t heap_index;                 /* Slot in its heap, WFQ_NOT_QUEUED if idle */
+    bool eligible;                     /* In wfq_eligible rather than wfq_pending */
+} wfq_class_t;
+
+/* Min-heap of class ids keyed by start or finish time */
+typedef struct wfq_heap {
+    uint8_t ids[TC_MAX_CLASSES];
+    uint32_t count;
+    bool by_finish;
+} wfq_heap_t;
+
+#define WFQ_SCALE (1u << 16)
+#define WFQ_DEFAULT_WEIGHT 1
+#define WFQ_NOT_QUEUED (-1)
+
 /* Global traffic control state */
 static tc_queue_t tc_queues[TC_MAX_CLASSES];
 static bool tc_initialized = false;
 static uint32_t tc_current_time = 0;
+static tc_drop_handler_t tc_drop_handler;
+static bool tc_aqm_emptied;                                  /* A dequeue drained a class by dropping */
+
+static htb_node_t htb_nodes[TC_HTB_MAX_NODES];
+static uint32_t htb_row[TC_HTB_MAX_LEVELS][TC_HTB_PRIOS];    /* CAN_SEND nodes with backlog */
+static uint8_t htb_row_next[TC_HTB_MAX_LEVELS][TC_HTB_PRIOS];
+static uint32_t htb_waitq;                                    /* Nodes waiting for tokens */
+
+static wfq_class_t wfq_classes[TC_MAX_CLASSES];
+static wfq_heap_t wfq_eligible = { .by_finish = true };       /* start <= vtime, by finish */
+static wfq_heap_t wfq_pending = { .by_finish = false };       /* start > vtime, by start */
+static uint64_t wfq_vtime;
+static uint32_t wfq_active_weight;
 
 /* Helper functions */
 static void update_shaper(tc_shaper_t *shaper) {
@@ -32,16 +128,705 @@ static void update_shaper(tc_shaper_t *shaper) {
     shaper->last_update = now;
 }
 
-static bool consume_tokens(tc_shaper_t *shaper, uint32_t tokens) {
-    update_shaper(shaper);
+/* Per-CPU token caches
+ *
+ * A class's tokens live in one global bucket, packed with its refill
+ * timestamp into a single word so refills and takes are one CAS. Each CPU
+ * pulls tokens from it a chunk at a time into a local cache, and checks
+ * against that cache alone until it runs dry.
+ */
+
+static uint64_t shaper_pack(uint32_t tokens, uint32_t stamp) {
+    return (uint64_t)tokens << 32 | stamp;
+}
+
+/* Take between min and want tokens from the global bucket; 0 if fewer
+ * than min are available
+ */
+static uint32_t shaper_take(tc_pcpu_shaper_t *shaper, uint32_t min, uint32_t want, uint32_t now) {
+    uint64_t old = atomic_load_explicit_u64(&shaper->bucket, MEMORY_ORDER_ACQUIRE);
+    
+    for (;;) {
+        uint32_t tokens = (uint32_t)(old >> 32);
+        uint32_t stamp = (uint32_t)old;
+        int32_t elapsed = (int32_t)(now - stamp);
+        uint64_t added = elapsed > 0 ? (uint64_t)elapsed * shaper->token_rate / 1000 : 0;
+        
+        /* A racing CPU may already have refilled past our now. Leave the
+         * stamp alone until a whole token has accrued, so slow rates still
+         * refill.
+         */
+        if (added) {
+            tokens = (uint32_t)MIN((uint64_t)shaper->bucket_size, tokens + added);
+            stamp = now;
+        }
+        if (tokens < min) return 0;
+        
+        uint32_t take = MIN(tokens, want);
+        if (atomic_compare_exchange_strong_explicit_u64(&shaper->bucket, &old,
+                shaper_pack(tokens - take, stamp),
+                MEMORY_ORDER_ACQ_REL, MEMORY_ORDER_ACQUIRE)) {
+            return take;
+        }
+    }
+}
+
+/* Consume from this CPU's cache. The cache line is only ever written by
+ * its own CPU; the CAS guards against preemption by another sender there.
+ */
+static bool shaper_consume_local(atomic_uint32_t *cache, uint32_t size, uint32_t *left) {
+    uint32_t tokens = atomic_load_explicit_u32(cache, MEMORY_ORDER_RELAXED);
     
-    if (shaper->current_tokens >= tokens) {
-        shaper->current_tokens -= tokens;
-        return true;
+    while (tokens >= size) {
+        if (atomic_compare_exchange_strong_explicit_u32(cache, &tokens, tokens - size,
+                MEMORY_ORDER_RELAXED, MEMORY_ORDER_RELAXED)) {
+            return true;
+        }
     }
+    *left = tokens;
     return false;
 }
 
+static bool shaper_consume(tc_pcpu_shaper_t *shaper, uint32_t size) {
+    if (shaper->token_rate == UINT32_MAX) return true;      /* Unlimited */
+    
+    atomic_uint32_t *cache = &shaper->cache[get_current_cpu()];
+    uint32_t left;
+    
+    if (shaper_consume_local(cache, size, &left)) return true;
+    
+    /* Refill: the shortfall plus a chunk to serve the next few checks */
+    uint32_t need = size - left;
+    uint32_t got = shaper_take(shaper, need, need + shaper->chunk, get_system_time());
+    if (!got) return false;
+    
+    atomic_fetch_add_explicit_u32(cache, got, MEMORY_ORDER_RELAXED);
+    return shaper_consume_local(cache, size, &left);
+}
+
+static void shaper_configure(tc_pcpu_shaper_t *shaper, uint32_t rate, uint32_t bucket_size) {
+    shaper->token_rate = rate;
+    shaper->bucket_size = bucket_size;
+    shaper->chunk = bucket_size / (MAX_CPU * TC_SHAPER_CHUNK_DIV);
+}
+
+/* Fill the global bucket and empty every cache */
+static void shaper_reset(tc_pcpu_shaper_t *shaper) {
+    atomic_store_explicit_u64(&shaper->bucket,
+        shaper_pack(shaper->bucket_size, get_system_time()), MEMORY_ORDER_RELEASE);
+    for (int cpu = 0; cpu < MAX_CPU; cpu++) {
+        atomic_store_explicit_u32(&shaper->cache[cpu], 0, MEMORY_ORDER_RELAXED);
+    }
+}
+
+/* Dequeue cost in shaper units: the task's time slice, so class rates
+ * bound the CPU time handed out
+ */
+static uint32_t task_cost(tcb_t *task) {
+    return task->time_slice ? task->time_slice : 1;
+}
+
+/* CoDel active queue management */
+
+static uint32_t codel_target(tc_queue_t *queue) {
+    uint32_t latency = queue->config.bandwidth.latency;
+    return latency ? (latency + 999) / 1000 : 1;   /* us to ms, at least a tick */
+}
+
+static uint64_t codel_isqrt(uint64_t value) {
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+    
+    while (bit > value) bit >>= 2;
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/* Next drop time: interval / sqrt(count) after t */
+static uint32_t codel_control_law(tc_codel_t *cd, uint32_t t) {
+    uint64_t root = codel_isqrt((uint64_t)cd->count << 20);   /* sqrt(count) << 10 */
+    return t + (uint32_t)(((uint64_t)cd->interval << 10) / (root ? root : 1));
+}
+
+static uint32_t codel_hist_bucket(uint32_t value) {
+    uint32_t bucket = 0;
+    
+    while (value && bucket < TC_AQM_HIST_BUCKETS - 1) {
+        value >>= 1;
+        bucket++;
+    }
+    
+    return bucket;
+}
+
+/* Pop the head task, account its sojourn time, and report whether it has
+ * stayed above target for a full interval
+ */
+static bool codel_pop(tc_queue_t *queue, uint32_t now, tcb_t **out) {
+    tc_codel_t *cd = &queue->codel;
+    tcb_t *task = queue->head;
+    
+    *out = task;
+    if (!task) {
+        cd->above_target = false;
+        return false;
+    }
+    
+    queue->head = task->next;
+    if (!queue->head) queue->tail = NULL;
+    task->next = NULL;
+    queue->count--;
+    
+    uint32_t sojourn = now - task->arrival_time;
+    cd->hist[codel_hist_bucket(sojourn)]++;
+    if (sojourn > cd->sojourn_max) cd->sojourn_max = sojourn;
+    queue->stats.latency_sum += (uint64_t)sojourn * 1000;
+    queue->stats.latency_samples++;
+    
+    /* Never drop the last task: an empty queue has no standing delay */
+    if (sojourn < codel_target(queue) || !queue->count) {
+        cd->above_target = false;
+        return false;
+    }
+    if (!cd->above_target) {
+        cd->above_target = true;
+        cd->first_above = now + cd->interval;
+        return false;
+    }
+    return (int32_t)(now - cd->first_above) >= 0;
+}
+
+static void codel_drop(traffic_class_t class, tcb_t *task) {
+    tc_queue_t *queue = &tc_queues[class];
+    
+    queue->stats.drops++;
+    queue->codel.drops++;
+    if (tc_drop_handler) tc_drop_handler(task, class);
+}
+
+static bool codel_mark(tc_queue_t *queue, tcb_t *task) {
+    if (queue->codel.mode != TC_AQM_MARK) return false;
+    
+    task->flags |= TC_TASK_FLAG_CE;
+    queue->codel.marks++;
+    return true;
+}
+
+/* Take the next task to serve from a class, applying CoDel. NULL when the
+ * class is empty; tc_aqm_emptied is set if drops are what emptied it.
+ */
+static tcb_t *tc_queue_pop(traffic_class_t class, uint32_t now) {
+    tc_queue_t *queue = &tc_queues[class];
+    tc_codel_t *cd = &queue->codel;
+    tcb_t *task;
+    bool drop = codel_pop(queue, now, &task);
+    
+    if (!task) {
+        cd->dropping = false;
+        return NULL;
+    }
+    if (cd->mode == TC_AQM_NONE) return task;
+    
+    if (cd->dropping) {
+        if (!drop) {
+            cd->dropping = false;
+        }
+        while (cd->dropping && (int32_t)(now - cd->drop_next) >= 0) {
+            cd->count++;
+            if (codel_mark(queue, task)) {
+                cd->drop_next = codel_control_law(cd, cd->drop_next);
+                return task;
+            }
+            codel_drop(class, task);
+            drop = codel_pop(queue, now, &task);
+            if (!drop) {
+                cd->dropping = false;
+            } else {
+                cd->drop_next = codel_control_law(cd, cd->drop_next);
+            }
+        }
+    } else if (drop) {
+        if (!codel_mark(queue, task)) {
+            codel_drop(class, task);
+            codel_pop(queue, now, &task);
+        }
+        cd->dropping = true;
+        cd->episodes++;
+        
+        /* Resume near the old drop rate if we only just left dropping */
+        uint32_t delta = cd->count - cd->lastcount;
+        if (delta > 1 && (int32_t)(now - cd->drop_next) < 16 * (int32_t)cd->interval) {
+            cd->count = delta;
+        } else {
+            cd->count = 1;
+        }
+        cd->lastcount = cd->count;
+        cd->drop_next = codel_control_law(cd, now);
+    }
+    
+    if (!task) {
+        cd->dropping = false;
+        tc_aqm_emptied = true;
+    }
+    return task;
+}
+
+/* Hierarchical Token Bucket */
+
+/* First node in set at or after cursor, wrapping */
+static int htb_pick(uint32_t set, uint8_t cursor) {
+    uint32_t upper = set & ~((1u << cursor) - 1);
+    return __builtin_ctz(upper ? upper : set);
+}
+
+static void htb_refill(htb_node_t *node, uint32_t now) {
+    uint32_t elapsed = now - node->checkpoint;
+    
+    if (!elapsed) return;
+    if (elapsed > HTB_MAX_ELAPSED) elapsed = HTB_MAX_ELAPSED;
+    
+    node->tokens += (int64_t)elapsed * node->rate;
+    if (node->tokens > node->buffer) node->tokens = node->buffer;
+    node->ctokens += (int64_t)elapsed * node->ceil;
+    if (node->ctokens > node->cbuffer) node->ctokens = node->cbuffer;
+    node->checkpoint = now;
+}
+
+static uint32_t htb_wait_ms(int64_t debt, uint32_t rate) {
+    return (uint32_t)((debt + rate - 1) / rate);
+}
+
+/* Mode from current tokens; *wait is the time until it can improve, or 0
+ * if only a configuration change can improve it
+ */
+static tc_htb_mode_t htb_class_mode(htb_node_t *node, uint32_t *wait) {
+    *wait = 0;
+    if (!node->ceil || node->ctokens < 0) {
+        if (node->ceil) *wait = htb_wait_ms(-node->ctokens, node->ceil);
+        return TC_HTB_CANT_SEND;
+    }
+    if (node->rate && node->tokens >= 0) {
+        return TC_HTB_CAN_SEND;
+    }
+    if (node->rate) *wait = htb_wait_ms(-node->tokens, node->rate);
+    return TC_HTB_MAY_BORROW;
+}
+
+/* Publish a node's backlog: borrowing nodes join their parent's feed and
+ * the climb stops at the first node that can send on its own rate, which
+ * joins the row for its level
+ */
+static void htb_activate_prios(int id) {
+    htb_node_t *node = &htb_nodes[id];
+    uint32_t mask = node->prio_activity;
+    
+    while (node->mode == TC_HTB_MAY_BORROW && node->parent >= 0 && mask) {
+        htb_node_t *parent = &htb_nodes[node->parent];
+        uint32_t added = 0;
+        
+        for (uint32_t m = mask; m; m &= m - 1) {
+            uint32_t prio = __builtin_ctz(m);
+            if (!parent->feed[prio]) added |= 1u << prio;
+            parent->feed[prio] |= 1u << id;
+        }
+        
+        /* Only prios new to the parent need to travel further up */
+        parent->prio_activity |= added;
+        mask = added;
+        id = node->parent;
+        node = parent;
+    }
+    
+    if (node->mode == TC_HTB_CAN_SEND) {
+        for (uint32_t m = mask; m; m &= m - 1) {
+            htb_row[node->level][__builtin_ctz(m)] |= 1u << id;
+        }
+    }
+}
+
+static void htb_deactivate_prios(int id) {
+    htb_node_t *node = &htb_nodes[id];
+    uint32_t mask = node->prio_activity;
+    
+    while (node->mode == TC_HTB_MAY_BORROW && node->parent >= 0 && mask) {
+        htb_node_t *parent = &htb_nodes[node->parent];
+        uint32_t emptied = 0;
+        
+        for (uint32_t m = mask; m; m &= m - 1) {
+            uint32_t prio = __builtin_ctz(m);
+            parent->feed[prio] &= ~(1u << id);
+            if (!parent->feed[prio]) emptied |= 1u << prio;
+        }
+        
+        parent->prio_activity &= ~emptied;
+        mask = emptied;
+        id = node->parent;
+        node = parent;
+    }
+    
+    if (node->mode == TC_HTB_CAN_SEND) {
+        for (uint32_t m = mask; m; m &= m - 1) {
+            htb_row[node->level][__builtin_ctz(m)] &= ~(1u << id);
+        }
+    }
+}
+
+static void htb_update_mode(int id, uint32_t now) {
+    htb_node_t *node = &htb_nodes[id];
+    uint32_t wait;
+    tc_htb_mode_t mode = htb_class_mode(node, &wait);
+    
+    if (mode != node->mode) {
+        if (node->prio_activity && node->mode != TC_HTB_CANT_SEND) {
+            htb_deactivate_prios(id);
+        }
+        node->mode = mode;
+        if (node->prio_activity && mode != TC_HTB_CANT_SEND) {
+            htb_activate_prios(id);
+        }
+    }
+    
+    if (wait) {
+        node->wait_until = now + wait;
+        htb_waitq |= 1u << id;
+    } else {
+        htb_waitq &= ~(1u << id);
+    }
+}
+
+/* Promote nodes whose tokens have recovered */
+static void htb_do_events(uint32_t now) {
+    for (uint32_t m = htb_waitq; m; m &= m - 1) {
+        int id = __builtin_ctz(m);
+        htb_node_t *node = &htb_nodes[id];
+        
+        if ((int32_t)(now - node->wait_until) >= 0) {
+            htb_refill(node, now);
+            htb_update_mode(id, now);
+        }
+    }
+}
+
+/* Charge a dequeue along the leaf's path. Nodes at or above the lending
+ * level pay rate tokens; the borrowers below it only pay ceiling tokens.
+ */
+static void htb_charge(int id, uint32_t level, uint32_t cost, uint32_t now) {
+    int64_t amount = (int64_t)cost * HTB_SCALE;
+    
+    while (id >= 0) {
+        htb_node_t *node = &htb_nodes[id];
+        
+        htb_refill(node, now);
+        if (node->level >= level) {
+            if (node->level == level) node->lends++;
+            node->tokens -= amount;
+            if (node->tokens < -node->buffer) node->tokens = -node->buffer;
+        } else {
+            node->borrows++;
+        }
+        node->ctokens -= amount;
+        if (node->ctokens < -node->cbuffer) node->ctokens = -node->cbuffer;
+        
+        htb_update_mode(id, now);
+        id = node->parent;
+    }
+}
+
+static void htb_leaf_activate(traffic_class_t class) {
+    int id = TC_HTB_CLASS_NODE(class);
+    
+    htb_nodes[id].prio_activity = 1u << htb_nodes[id].prio;
+    if (htb_nodes[id].mode != TC_HTB_CANT_SEND) {
+        htb_activate_prios(id);
+    }
+}
+
+static void htb_leaf_deactivate(traffic_class_t class) {
+    int id = TC_HTB_CLASS_NODE(class);
+    
+    if (htb_nodes[id].prio_activity && htb_nodes[id].mode != TC_HTB_CANT_SEND) {
+        htb_deactivate_prios(id);
+    }
+    htb_nodes[id].prio_activity = 0;
+}
+
+static void htb_set_rates(int id, tc_bandwidth_t *bandwidth, uint32_t now) {
+    htb_node_t *node = &htb_nodes[id];
+    
+    htb_refill(node, now);
+    node->rate = bandwidth->min_rate;
+    node->ceil = bandwidth->max_rate;
+    node->buffer = node->cbuffer = (int64_t)bandwidth->burst_size * HTB_SCALE;
+    if (node->tokens > node->buffer) node->tokens = node->buffer;
+    if (node->ctokens > node->cbuffer) node->ctokens = node->cbuffer;
+    htb_update_mode(id, now);
+}
+
+/* Mirror a class configuration into its leaf. Higher config priority
+ * means a lower (earlier) HTB prio.
+ */
+static void htb_configure_leaf(traffic_class_t class) {
+    tc_queue_t *queue = &tc_queues[class];
+    htb_node_t *node = &htb_nodes[TC_HTB_CLASS_NODE(class)];
+    uint32_t priority = queue->config.priority;
+    uint8_t prio = priority >= TC_HTB_PRIOS ? 0 : TC_HTB_PRIOS - 1 - priority;
+    bool active = node->prio_activity != 0;
+    
+    if (active) htb_leaf_deactivate(class);
+    node->prio = prio;
+    node->quantum = queue->config.quantum ? queue->config.quantum : HTB_DEFAULT_QUANTUM;
+    htb_set_rates(TC_HTB_CLASS_NODE(class), &queue->config.bandwidth, get_system_time());
+    if (active) htb_leaf_activate(class);
+}
+
+static void htb_init_node(int id, int parent, uint8_t level, tc_bandwidth_t *bandwidth) {
+    htb_node_t *node = &htb_nodes[id];
+    
+    memset(node, 0, sizeof(htb_node_t));
+    node->used = true;
+    node->parent = parent;
+    node->level = level;
+    node->quantum = HTB_DEFAULT_QUANTUM;
+    node->rate = bandwidth->min_rate;
+    node->ceil = bandwidth->max_rate;
+    node->buffer = node->cbuffer = (int64_t)bandwidth->burst_size * HTB_SCALE;
+    node->tokens = node->buffer;
+    node->ctokens = node->cbuffer;
+    node->checkpoint = get_system_time();
+    node->mode = TC_HTB_CAN_SEND;
+    if (parent >= 0) htb_nodes[parent].children++;
+    htb_update_mode(id, node->checkpoint);
+}
+
+/* Serve one task from the best node in row[level][prio], descending
+ * through each interior node's feed to a leaf
+ */
+static tcb_t *htb_dequeue_tree(uint32_t level, uint32_t prio, uint32_t now) {
+    uint32_t *set = &htb_row[level][prio];
+    uint8_t *cursor = &htb_row_next[level][prio];
+    int id = htb_pick(*set, *cursor);
+    
+    while (htb_nodes[id].level > 0) {
+        htb_node_t *node = &htb_nodes[id];
+        if (!node->feed[prio]) return NULL;
+        set = &node->feed[prio];
+        cursor = &node->feed_next[prio];
+        id = htb_pick(*set, *cursor);
+    }
+    
+    traffic_class_t class = id - 1;
+    tc_queue_t *queue = &tc_queues[class];
+    htb_node_t *leaf = &htb_nodes[id];
+    tcb_t *task = tc_queue_pop(class, now);
+    if (!task) {
+        htb_leaf_deactivate(class);
+        return NULL;
+    }
+    
+    /* Deficit round robin among siblings at the same prio. A task may
+     * cost many quanta (the default quantum is 1, costs are whole time
+     * slices), so refill by as many as it overdrew; the deficit then stays
+     * in [0, quantum) instead of sinking further every round until it
+     * wraps.
+     */
+    uint32_t cost = task_cost(task);
+    int64_t deficit = (int64_t)leaf->deficit[level] - cost;
+    if (deficit < 0) {
+        deficit += (-deficit + leaf->quantum - 1) / leaf->quantum * leaf->quantum;
+        *cursor = (id + 1) % TC_HTB_MAX_NODES;
+    }
+    leaf->deficit[level] = deficit > INT32_MAX ? INT32_MAX : (int32_t)deficit;
+    
+    if (!queue->head) htb_leaf_deactivate(class);
+    htb_charge(id, level, cost, now);
+    
+    /* Update statistics */
+    queue->stats.packets_sent++;
+    
+    return task;
+}
+
+/* Weighted fair queueing (WF2Q+)
+ *
+ * Classes with TC_POLICY_FAIR_QUEUE bypass the HTB tree. Each backlogged
+ * class carries the virtual start and finish time of its head task; a
+ * class is eligible once its start is not ahead of the system virtual
+ * time, and the eligible class with the earliest finish is served next.
+ */
+
+static uint32_t wfq_weight(traffic_class_t class) {
+    uint32_t weight = tc_queues[class].config.weight;
+    return weight ? weight : WFQ_DEFAULT_WEIGHT;
+}
+
+static uint64_t wfq_key(wfq_heap_t *heap, uint8_t class) {
+    return heap->by_finish ? wfq_classes[class].finish : wfq_classes[class].start;
+}
+
+static void wfq_heap_set(wfq_heap_t *heap, uint32_t idx, uint8_t class) {
+    heap->ids[idx] = class;
+    wfq_classes[class].heap_index = idx;
+}
+
+static void wfq_sift_up(wfq_heap_t *heap, uint32_t idx) {
+    uint8_t class = heap->ids[idx];
+    uint64_t key = wfq_key(heap, class);
+    
+    while (idx > 0) {
+        uint32_t parent = (idx - 1) / 2;
+        if (wfq_key(heap, heap->ids[parent]) <= key) break;
+        wfq_heap_set(heap, idx, heap->ids[parent]);
+        idx = parent;
+    }
+    wfq_heap_set(heap, idx, class);
+}
+
+static void wfq_sift_down(wfq_heap_t *heap, uint32_t idx) {
+    uint8_t class = heap->ids[idx];
+    uint64_t key = wfq_key(heap, class);
+    
+    for (;;) {
+        uint32_t child = 2 * idx + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count &&
+            wfq_key(heap, heap->ids[child + 1]) < wfq_key(heap, heap->ids[child])) {
+            child++;
+        }
+        if (key <= wfq_key(heap, heap->ids[child])) break;
+        wfq_heap_set(heap, idx, heap->ids[child]);
+        idx = child;
+    }
+    wfq_heap_set(heap, idx, class);
+}
+
+static void wfq_heap_remove(wfq_heap_t *heap, uint8_t class) {
+    uint32_t idx = wfq_classes[class].heap_index;
+    uint8_t last = heap->ids[--heap->count];
+    
+    wfq_classes[class].heap_index = WFQ_NOT_QUEUED;
+    if (idx == heap->count) return;
+    
+    wfq_heap_set(heap, idx, last);
+    if (idx > 0 && wfq_key(heap, heap->ids[(idx - 1) / 2]) > wfq_key(heap, last)) {
+        wfq_sift_up(heap, idx);
+    } else {
+        wfq_sift_down(heap, idx);
+    }
+}
+
+/* File a backlogged class by eligibility */
+static void wfq_queue(traffic_class_t class) {
+    wfq_class_t *wc = &wfq_classes[class];
+    wfq_heap_t *heap;
+    
+    wc->eligible = wc->start <= wfq_vtime;
+    heap = wc->eligible ? &wfq_eligible : &wfq_pending;
+    heap->ids[heap->count] = class;
+    wc->heap_index = heap->count++;
+    wfq_sift_up(heap, wc->heap_index);
+}
+
+/* Stamp the head task: start no earlier than the previous finish */
+static void wfq_stamp(traffic_class_t class, uint64_t start) {
+    wfq_class_t *wc = &wfq_classes[class];
+    uint64_t cost = task_cost(tc_queues[class].head);
+    
+    wc->start = start;
+    wc->finish = start + cost * WFQ_SCALE / wc->weight;
+}
+
+static void wfq_activate(traffic_class_t class) {
+    wfq_class_t *wc = &wfq_classes[class];
+    
+    wc->weight = wfq_weight(class);
+    wfq_active_weight += wc->weight;
+    wfq_stamp(class, wc->finish > wfq_vtime ? wc->finish : wfq_vtime);
+    wfq_queue(class);
+}
+
+static void wfq_deactivate(traffic_class_t class) {
+    wfq_class_t *wc = &wfq_classes[class];
+    
+    if (wc->heap_index == WFQ_NOT_QUEUED) return;
+    wfq_heap_remove(wc->eligible ? &wfq_eligible : &wfq_pending, class);
+    wfq_active_weight -= wc->weight;
+}
+
+/* Move classes whose start time has been reached into the eligible heap */
+static void wfq_promote(void) {
+    while (wfq_pending.count &&
+           wfq_classes[wfq_pending.ids[0]].start <= wfq_vtime) {
+        uint8_t class = wfq_pending.ids[0];
+        wfq_heap_remove(&wfq_pending, class);
+        wfq_queue(class);
+    }
+}
+
+static tcb_t *wfq_dequeue(uint32_t now) {
+    if (!wfq_eligible.count && !wfq_pending.count) return NULL;
+    
+    /* Never idle while backlogged: jump to the earliest start */
+    if (!wfq_eligible.count) {
+        wfq_vtime = wfq_classes[wfq_pending.ids[0]].start;
+    }
+    wfq_promote();
+    
+    traffic_class_t class = wfq_eligible.ids[0];
+    wfq_class_t *wc = &wfq_classes[class];
+    tc_queue_t *queue = &tc_queues[class];
+    tcb_t *task = tc_queue_pop(class, now);
+    if (!task) {
+        wfq_deactivate(class);
+        return NULL;
+    }
+    
+    wfq_vtime += (uint64_t)task_cost(task) * WFQ_SCALE / wfq_active_weight;
+    wfq_heap_remove(&wfq_eligible, class);
+    if (queue->head) {
+        wfq_stamp(class, wc->finish);
+        wfq_queue(class);
+    } else {
+        wfq_active_weight -= wc->weight;
+    }
+    
+    /* V = max(V + L/W, min start): catch up if nothing is eligible */
+    if (!wfq_eligible.count && wfq_pending.count &&
+        wfq_classes[wfq_pending.ids[0]].start > wfq_vtime) {
+        wfq_vtime = wfq_classes[wfq_pending.ids[0]].start;
+    }
+    wfq_promote();
+    
+    /* Update statistics */
+    queue->stats.packets_sent++;
+    
+    return task;
+}
+
+/* Publish or withdraw a backlogged class under its current policy */
+static void tc_class_activate(traffic_class_t class) {
+    if (tc_queues[class].config.policy == TC_POLICY_FAIR_QUEUE) {
+        wfq_activate(class);
+    } else {
+        htb_leaf_activate(class);
+    }
+}
+
+static void tc_class_deactivate(traffic_class_t class) {
+    if (tc_queues[class].config.policy == TC_POLICY_FAIR_QUEUE) {
+        wfq_deactivate(class);
+    } else {
+        htb_leaf_deactivate(class);
+    }
+}
+
 /* Traffic control initialization */
 void tc_init(void) {
     if (tc_initialized) return;
@@ -60,10 +845,27 @@ void tc_init(void) {
         tc_queues[i].config.bandwidth.latency = 1000;
         
         /* Initialize shaper */
-        tc_queues[i].shaper.token_rate = UINT32_MAX;
-        tc_queues[i].shaper.bucket_size = 16384;
-        tc_queues[i].shaper.current_tokens = 16384;
-        tc_queues[i].shaper.last_update = get_system_time();
+        shaper_configure(&tc_queues[i].shaper, UINT32_MAX, 16384);
+        shaper_reset(&tc_queues[i].shaper);
+    }
+    
+    /* Every class starts as a leaf borrowing from an unlimited root */
+    tc_bandwidth_t unlimited = { UINT32_MAX, UINT32_MAX, 16384, 0 };
+    memset(htb_nodes, 0, sizeof(htb_nodes));
+    memset(htb_row, 0, sizeof(htb_row));
+    memset(htb_row_next, 0, sizeof(htb_row_next));
+    htb_waitq = 0;
+    memset(wfq_classes, 0, sizeof(wfq_classes));
+    for (int i = 0; i < TC_MAX_CLASSES; i++) {
+        wfq_classes[i].heap_index = WFQ_NOT_QUEUED;
+    }
+    wfq_eligible.count = wfq_pending.count = 0;
+    wfq_vtime = 0;
+    wfq_active_weight = 0;
+    htb_init_node(TC_HTB_ROOT, -1, TC_HTB_MAX_LEVELS - 1, &unlimited);
+    for (int i = 0; i < TC_MAX_CLASSES; i++) {
+        htb_init_node(TC_HTB_CLASS_NODE(i), TC_HTB_ROOT, 0, &tc_queues[i].config.bandwidth);
+        htb_configure_leaf(i);
     }
     
     tc_initialized = true;
@@ -85,14 +887,18 @@ int tc_create_class(tc_class_config_t *config) {
     if (!config || config->class >= TC_MAX_CLASSES) return -1;
     
     tc_queue_t *queue = &tc_queues[config->class];
+    bool backlogged = queue->head != NULL;
+    
+    /* The policy may change, so withdraw any backlog under the old one */
+    if (backlogged) tc_class_deactivate(config->class);
     memcpy(&queue->config, config, sizeof(tc_class_config_t));
     
     /* Initialize shaper based on bandwidth settings */
-    queue->shaper.token_rate = config->bandwidth.max_rate;
-    queue->shaper.bucket_size = config->bandwidth.burst_size;
-    queue->shaper.current_tokens = config->bandwidth.burst_size;
-    queue->shaper.last_update = get_system_time();
+    shaper_configure(&queue->shaper, config->bandwidth.max_rate, config->bandwidth.burst_size);
+    shaper_reset(&queue->shaper);
     
+    htb_configure_leaf(config->class);
+    if (backlogged) tc_class_activate(config->class);
     return 0;
 }
 
@@ -100,12 +906,16 @@ int tc_modify_class(traffic_class_t class, tc_class_config_t *config) {
     if (!config || class >= TC_MAX_CLASSES) return -1;
     
     tc_queue_t *queue = &tc_queues[class];
+    bool backlogged = queue->head != NULL;
+    
+    if (backlogged) tc_class_deactivate(class);
     memcpy(&queue->config, config, sizeof(tc_class_config_t));
     
     /* Update shaper */
-    queue->shaper.token_rate = config->bandwidth.max_rate;
-    queue->shaper.bucket_size = config->bandwidth.burst_size;
+    shaper_configure(&queue->shaper, config->bandwidth.max_rate, config->bandwidth.burst_size);
     
+    htb_configure_leaf(class);
+    if (backlogged) tc_class_activate(class);
     return 0;
 }
 
@@ -114,7 +924,68 @@ int tc_delete_class(traffic_class_t class) {
     
     tc_flush_queue(class);
     memset(&tc_queues[class], 0, sizeof(tc_queue_t));
+    htb_configure_leaf(class);
+    
+    return 0;
+}
+
+/* Class hierarchy */
+int tc_htb_create_node(int parent, tc_bandwidth_t *bandwidth) {
+    if (!bandwidth || parent < 0 || parent >= TC_HTB_MAX_NODES) return -1;
+    
+    htb_node_t *p = &htb_nodes[parent];
+    if (!p->used || p->level <= 1 || (parent > TC_HTB_ROOT && parent < HTB_FIRST_INNER)) {
+        return -1;
+    }
+    
+    for (int id = HTB_FIRST_INNER; id < TC_HTB_MAX_NODES; id++) {
+        if (!htb_nodes[id].used) {
+            htb_init_node(id, parent, p->level - 1, bandwidth);
+            return id;
+        }
+    }
+    return -1;
+}
+
+int tc_htb_delete_node(int node) {
+    if (node < HTB_FIRST_INNER || node >= TC_HTB_MAX_NODES) return -1;
+    if (!htb_nodes[node].used || htb_nodes[node].children) return -1;
     
+    htb_nodes[htb_nodes[node].parent].children--;
+    htb_waitq &= ~(1u << node);
+    memset(&htb_nodes[node], 0, sizeof(htb_node_t));
+    return 0;
+}
+
+/* Move a class under another node, keeping any backlog published */
+int tc_htb_attach_class(traffic_class_t class, int parent) {
+    if (class >= TC_MAX_CLASSES || parent < 0 || parent >= TC_HTB_MAX_NODES) return -1;
+    if (!htb_nodes[parent].used || (parent > TC_HTB_ROOT && parent < HTB_FIRST_INNER)) {
+        return -1;
+    }
+    
+    htb_node_t *leaf = &htb_nodes[TC_HTB_CLASS_NODE(class)];
+    bool active = leaf->prio_activity != 0;
+    
+    if (active) htb_leaf_deactivate(class);
+    htb_nodes[leaf->parent].children--;
+    leaf->parent = parent;
+    htb_nodes[parent].children++;
+    if (active) htb_leaf_activate(class);
+    
+    return 0;
+}
+
+int tc_htb_get_stats(int node, tc_htb_stats_t *stats) {
+    if (!stats || node < 0 || node >= TC_HTB_MAX_NODES || !htb_nodes[node].used) return -1;
+    
+    htb_node_t *n = &htb_nodes[node];
+    htb_refill(n, get_system_time());
+    stats->mode = n->mode;
+    stats->tokens = (int32_t)(n->tokens / HTB_SCALE);
+    stats->ctokens = (int32_t)(n->ctokens / HTB_SCALE);
+    stats->lends = n->lends;
+    stats->borrows = n->borrows;
     return 0;
 }
 
@@ -145,9 +1016,14 @@ int tc_enqueue_task(tcb_t *task) {
         return -1;
     }
     
-    /* Add to queue */
+    /* Timestamp for sojourn time; a mark only applies to one trip */
+    task->arrival_time = get_system_time();
+    task->flags &= ~TC_TASK_FLAG_CE;
+    
+    /* Add to queue, publishing the class to its scheduler on first backlog */
     if (!queue->head) {
         queue->head = queue->tail = task;
+        tc_class_activate(class);
     } else {
         queue->tail->next = task;
         queue->tail = task;
@@ -158,42 +1034,70 @@ int tc_enqueue_task(tcb_t *task) {
     return 0;
 }
 
-tcb_t *tc_dequeue_task(void) {
-    /* Start from highest priority class */
-    for (int i = 0; i < TC_MAX_CLASSES; i++) {
-        tc_queue_t *queue = &tc_queues[i];
-        
-        if (queue->head) {
-            tcb_t *task = queue->head;
-            queue->head = task->next;
-            if (!queue->head) queue->tail = NULL;
-            task->next = NULL;
-            queue->count--;
-            
-            /* Update statistics */
-            queue->stats.packets_sent++;
-            
-            return task;
+static tcb_t *tc_dequeue_once(uint32_t now) {
+    /* Classes within their own rate first, then borrowers, each by prio */
+    for (uint32_t level = 0; level < TC_HTB_MAX_LEVELS; level++) {
+        for (uint32_t prio = 0; prio < TC_HTB_PRIOS; prio++) {
+            if (htb_row[level][prio]) {
+                tcb_t *task = htb_dequeue_tree(level, prio, now);
+                if (task) return task;
+            }
         }
     }
     
-    return NULL;
+    /* Fair-queued classes share what the tree leaves over */
+    return wfq_dequeue(now);
+}
+
+tcb_t *tc_dequeue_task(void) {
+    uint32_t now = get_system_time();
+    tcb_t *task;
+    
+    htb_do_events(now);
+    
+    /* AQM may drop a class empty; every retry has removed a task */
+    do {
+        tc_aqm_emptied = false;
+        task = tc_dequeue_once(now);
+    } while (!task && tc_aqm_emptied);
+    
+    return task;
 }
 
 void tc_flush_queue(traffic_class_t class) {
     if (class >= TC_MAX_CLASSES) return;
     
     tc_queue_t *queue = &tc_queues[class];
+    if (queue->head) tc_class_deactivate(class);
     queue->head = queue->tail = NULL;
     queue->count = 0;
 }
 
+/* Bandwidth control */
+int tc_set_bandwidth(traffic_class_t class, tc_bandwidth_t *bandwidth) {
+    if (class >= TC_MAX_CLASSES || !bandwidth) return -1;
+    
+    tc_queue_t *queue = &tc_queues[class];
+    queue->config.bandwidth = *bandwidth;
+    shaper_configure(&queue->shaper, bandwidth->max_rate, bandwidth->burst_size);
+    
+    htb_configure_leaf(class);
+    return 0;
+}
+
+int tc_get_bandwidth(traffic_class_t class, tc_bandwidth_t *bandwidth) {
+    if (class >= TC_MAX_CLASSES || !bandwidth) return -1;
+    
+    *bandwidth = tc_queues[class].config.bandwidth;
+    return 0;
+}
+
 /* Traffic shaping */
 bool tc_check_rate(traffic_class_t class, uint32_t size) {
     if (class >= TC_MAX_CLASSES) return false;
     
     tc_queue_t *queue = &tc_queues[class];
-    return consume_tokens(&queue->shaper, size);
+    return shaper_consume(&queue->shaper, size);
 }
 
 void tc_update_tokens(tc_shaper_t *shaper) {
@@ -223,7 +1127,10 @@ void tc_get_stats(traffic_class_t class, tc_stats_t *stats) {
 void tc_reset_stats(traffic_class_t class) {
     if (class >= TC_MAX_CLASSES) return;
     
+    tc_codel_t *cd = &tc_queues[class].codel;
     memset(&tc_queues[class].stats, 0, sizeof(tc_stats_t));
+    cd->drops = cd->marks = cd->episodes = cd->sojourn_max = 0;
+    memset(cd->hist, 0, sizeof(cd->hist));
 }
 
 float tc_get_average_latency(traffic_class_t class) {
@@ -245,11 +1152,69 @@ uint32_t tc_get_drop_rate(traffic_class_t class) {
     return (stats->drops * 100) / total;
 }
 
+/* Active queue management */
+int tc_set_aqm(traffic_class_t class, tc_aqm_mode_t mode, uint32_t interval_ms) {
+    if (class >= TC_MAX_CLASSES || mode > TC_AQM_MARK) return -1;
+    
+    tc_codel_t *cd = &tc_queues[class].codel;
+    cd->mode = mode;
+    cd->interval = interval_ms ? interval_ms : TC_AQM_DEFAULT_INTERVAL;
+    cd->dropping = false;
+    cd->above_target = false;
+    cd->count = cd->lastcount = 0;
+    return 0;
+}
+
+/* Upper bound of the bucket holding the pct-th percentile */
+static uint32_t codel_percentile(const uint32_t *hist, uint32_t total, uint32_t pct) {
+    uint32_t rank = (uint32_t)(((uint64_t)total * pct + 99) / 100);
+    uint32_t seen = 0;
+    
+    for (uint32_t b = 0; b < TC_AQM_HIST_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen >= rank) return b ? (1u << b) - 1 : 0;
+    }
+    return UINT32_MAX;
+}
+
+int tc_get_aqm_stats(traffic_class_t class, tc_aqm_stats_t *stats) {
+    if (class >= TC_MAX_CLASSES || !stats) return -1;
+    
+    tc_codel_t *cd = &tc_queues[class].codel;
+    uint32_t total = 0;
+    
+    memset(stats, 0, sizeof(tc_aqm_stats_t));
+    stats->drops = cd->drops;
+    stats->marks = cd->marks;
+    stats->episodes = cd->episodes;
+    stats->sojourn_max = cd->sojourn_max;
+    memcpy(stats->hist, cd->hist, sizeof(stats->hist));
+    for (uint32_t b = 0; b < TC_AQM_HIST_BUCKETS; b++) {
+        total += cd->hist[b];
+    }
+    if (total) {
+        stats->sojourn_p50 = MIN(codel_percentile(cd->hist, total, 50), cd->sojourn_max);
+        stats->sojourn_p90 = MIN(codel_percentile(cd->hist, total, 90), cd->sojourn_max);
+        stats->sojourn_p99 = MIN(codel_percentile(cd->hist, total, 99), cd->sojourn_max);
+    }
+    return 0;
+}
+
+void tc_set_drop_handler(tc_drop_handler_t handler) {
+    tc_drop_handler = handler;
+}
+
 /* Policy management */
 int tc_set_policy(traffic_class_t class, tc_policy_t policy) {
-    if (class >= TC_MAX_CLASSES) return -1;
+    if (class >= TC_MAX_CLASSES || policy > TC_POLICY_FAIR_QUEUE) return -1;
     
-    tc_queues[class].config.policy = policy;
+    tc_queue_t *queue = &tc_queues[class];
+    if (queue->config.policy == policy) return 0;
+    
+    /* Move any backlog between the HTB tree and the WFQ heaps */
+    if (queue->head) tc_class_deactivate(class);
+    queue->config.policy = policy;
+    if (queue->head) tc_class_activate(class);
     return 0;
 }
 
@@ -265,6 +1230,13 @@ void tc_set_cpu_share(traffic_class_t class, uint8_t percentage) {
     
     tc_queue_t *queue = &tc_queues[class];
     queue->config.weight = percentage;
+    
+    /* The share is the WFQ weight; finish times pick it up on the next stamp */
+    wfq_class_t *wc = &wfq_classes[class];
+    if (wc->heap_index != WFQ_NOT_QUEUED) {
+        wfq_active_weight += wfq_weight(class) - wc->weight;
+        wc->weight = wfq_weight(class);
+    }
 }
 
 void tc_set_memory_limit(traffic_class_t class, uint32_t bytes) {
@@ -272,6 +1244,7 @@ void tc_set_memory_limit(traffic_class_t class, uint32_t bytes) {
     
     tc_queue_t *queue = &tc_queues[class];
     queue->config.bandwidth.max_rate = bytes;
+    htb_configure_leaf(class);
 }
 
 void tc_set_io_priority(traffic_class_t class, uint8_t priority) {
@@ -279,6 +1252,7 @@ void tc_set_io_priority(traffic_class_t class, uint8_t priority) {
     
     tc_queue_t *queue = &tc_queues[class];
     queue->config.priority = priority;
+    htb_configure_leaf(class);
 }
 
 /* Debugging and maintenance */
@@ -294,6 +1268,8 @@ void tc_dump_class_info(traffic_class_t class) {
            queue->config.bandwidth.max_rate);
     printf("  Drops: %d\n", queue->stats.drops);
     printf("  Average Latency: %.2f us\n", tc_get_average_latency(class));
+    printf("  AQM: mode %d, drops %d, marks %d\n",
+           queue->codel.mode, queue->codel.drops, queue->codel.marks);
 }
 
 void tc_verify_configuration(void) {